@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define MCP_CHECKSUM_X86 1
+#endif
+
+// ============================================================================
+// Checksums
+// ============================================================================
+
+/**
+ * @brief CRC-32C and XXH64 of byte buffers
+ *
+ * CRC-32C (Castagnoli) is the checksum of iSCSI, ext4 and most storage
+ * logs. On x86-64 it uses the SSE4.2 crc32 instruction, 8 bytes per step,
+ * when the CPU supports it (compiled through a target attribute, so the
+ * binary does not need -msse4.2), and a table otherwise. XXH64 is a fast
+ * non-cryptographic 64-bit hash whose four independent lanes keep the
+ * multipliers of a core busy.
+ *
+ * Both can be computed over data given in several pieces.
+ */
+namespace checksum {
+
+inline const std::array<uint32_t, 256> &crc32cTable() {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> entries{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+      }
+      entries[i] = crc;
+    }
+    return entries;
+  }();
+  return table;
+}
+
+/// Portable CRC-32C on the inverted register
+inline uint32_t crc32cTableUpdate(uint32_t crc, const unsigned char *bytes, std::size_t size) {
+  const std::array<uint32_t, 256> &table = crc32cTable();
+  for (std::size_t i = 0; i < size; ++i) {
+    crc = (crc >> 8) ^ table[(crc ^ bytes[i]) & 0xFF];
+  }
+  return crc;
+}
+
+#if defined(MCP_CHECKSUM_X86)
+__attribute__((target("sse4.2"))) inline uint32_t crc32cSse42Update(uint32_t crc, const unsigned char *bytes,
+                                                                   std::size_t size) {
+  uint64_t wide = crc;
+  for (; size >= 8; size -= 8, bytes += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    wide = _mm_crc32_u64(wide, word);
+  }
+  crc = static_cast<uint32_t>(wide);
+  for (; size > 0; --size, ++bytes) {
+    crc = _mm_crc32_u8(crc, *bytes);
+  }
+  return crc;
+}
+#endif
+
+/// Name of the CRC-32C implementation used on this CPU
+inline const char *crc32cKernel() {
+#if defined(MCP_CHECKSUM_X86)
+  static const bool sse42 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+  }();
+  return sse42 ? "sse4.2" : "table";
+#else
+  return "table";
+#endif
+}
+
+/**
+ * @brief CRC-32C of a buffer
+ * @param crc Result for the preceding data, to checksum data in pieces
+ */
+inline uint32_t crc32c(const void *data, std::size_t size, uint32_t crc = 0) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+#if defined(MCP_CHECKSUM_X86)
+  static const bool sse42 = crc32cKernel()[0] == 's';
+  if (sse42) {
+    return ~crc32cSse42Update(~crc, bytes, size);
+  }
+#endif
+  return ~crc32cTableUpdate(~crc, bytes, size);
+}
+
+/**
+ * @brief Streaming XXH64
+ */
+class Xxh64 {
+private:
+  static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+  static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+  static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+  static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+  static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+  uint64_t fLanes[4];
+  unsigned char fBuffer[32];   ///< Input not yet consumed by the lanes
+  std::size_t fBuffered = 0;
+  uint64_t fLength = 0;
+  uint64_t fSeed;
+
+  static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+  static uint64_t read64(const unsigned char *p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  }
+
+  static uint32_t read32(const unsigned char *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  }
+
+  static uint64_t round(uint64_t lane, uint64_t input) {
+    lane += input * kPrime2;
+    return rotl(lane, 31) * kPrime1;
+  }
+
+  static uint64_t merge(uint64_t hash, uint64_t lane) {
+    hash ^= round(0, lane);
+    return hash * kPrime1 + kPrime4;
+  }
+
+  // Consume whole 32-byte stripes; returns the bytes consumed
+  std::size_t stripes(const unsigned char *p, std::size_t size) {
+    uint64_t v0 = fLanes[0], v1 = fLanes[1], v2 = fLanes[2], v3 = fLanes[3];
+    std::size_t consumed = 0;
+    for (; size - consumed >= 32; consumed += 32) {
+      v0 = round(v0, read64(p + consumed));
+      v1 = round(v1, read64(p + consumed + 8));
+      v2 = round(v2, read64(p + consumed + 16));
+      v3 = round(v3, read64(p + consumed + 24));
+    }
+    fLanes[0] = v0, fLanes[1] = v1, fLanes[2] = v2, fLanes[3] = v3;
+    return consumed;
+  }
+
+public:
+  explicit Xxh64(uint64_t seed = 0) : fSeed(seed) {
+    fLanes[0] = seed + kPrime1 + kPrime2;
+    fLanes[1] = seed + kPrime2;
+    fLanes[2] = seed;
+    fLanes[3] = seed - kPrime1;
+  }
+
+  void update(const void *data, std::size_t size) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    fLength += size;
+    if (fBuffered > 0) {
+      std::size_t take = std::min(size, sizeof(fBuffer) - fBuffered);
+      std::memcpy(fBuffer + fBuffered, p, take);
+      fBuffered += take;
+      p += take;
+      size -= take;
+      if (fBuffered < sizeof(fBuffer)) {
+        return;
+      }
+      stripes(fBuffer, sizeof(fBuffer));
+      fBuffered = 0;
+    }
+    std::size_t consumed = stripes(p, size);
+    std::memcpy(fBuffer, p + consumed, size - consumed);
+    fBuffered = size - consumed;
+  }
+
+  uint64_t digest() const {
+    uint64_t hash;
+    if (fLength >= 32) {
+      hash = rotl(fLanes[0], 1) + rotl(fLanes[1], 7) + rotl(fLanes[2], 12) + rotl(fLanes[3], 18);
+      for (uint64_t lane : fLanes) {
+        hash = merge(hash, lane);
+      }
+    } else {
+      hash = fSeed + kPrime5;
+    }
+    hash += fLength;
+
+    const unsigned char *p = fBuffer;
+    std::size_t size = fBuffered;
+    for (; size >= 8; size -= 8, p += 8) {
+      hash ^= round(0, read64(p));
+      hash = rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (size >= 4) {
+      hash ^= uint64_t(read32(p)) * kPrime1;
+      hash = rotl(hash, 23) * kPrime2 + kPrime3;
+      size -= 4;
+      p += 4;
+    }
+    for (; size > 0; --size, ++p) {
+      hash ^= *p * kPrime5;
+      hash = rotl(hash, 11) * kPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+};
+
+} // namespace checksum
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+extern char **environ;
+
+// posix_spawn extensions of glibc: addchdir_np since 2.29, addclosefrom_np since 2.34
+#if defined(__GLIBC__)
+#define MCP_GLIBC_PREREQ(major, minor) __GLIBC_PREREQ(major, minor)
+#else
+#define MCP_GLIBC_PREREQ(major, minor) 0
+#endif
+
+/**
+ * @brief Built-in tool running allowlisted commands
+ *
+ * Processes are started with posix_spawnp(), which glibc implements with
+ * clone(CLONE_VM | CLONE_VFORK): the cost of a spawn does not grow with the
+ * size of the server, unlike fork(). The child gets /dev/null as stdin,
+ * its own process group and no other descriptor of the server. Its stdout
+ * and stderr pipes and a pidfd signalling its exit are multiplexed with
+ * poll(), until it exits, the time limit expires, the output limit is
+ * reached or the call is cancelled; the last three kill the whole process
+ * group.
+ *
+ * When the client passes a progressToken, output is streamed as it arrives
+ * in notifications/progress messages, whose progress is the number of
+ * bytes read so far.
+ */
+class CommandTool : public McpTool {
+private:
+  static constexpr int64_t kDefaultTimeoutMs = 30000;
+  static constexpr int64_t kMaxTimeoutMs = 600000;
+  static constexpr std::size_t kDefaultMaxOutput = 1 << 20;
+  static constexpr std::size_t kMaxOutput = 16 << 20;
+  static constexpr std::size_t kReadSize = 64 * 1024;
+  static constexpr std::size_t kProgressMessageBytes = 4096; ///< Output sent per progress message
+  static constexpr std::chrono::milliseconds kPollInterval{100};    ///< Cancellation check period
+  static constexpr std::chrono::milliseconds kProgressInterval{100}; ///< Minimum delay between messages
+  static constexpr std::chrono::milliseconds kKillGrace{500};       ///< SIGTERM to SIGKILL delay
+  static constexpr std::chrono::milliseconds kDrainDelay{100};      ///< Wait for orphaned pipes after exit
+
+  using Clock = std::chrono::steady_clock;
+
+  enum class Stop { None, TimedOut, OutputLimit, Cancelled };
+
+  std::set<std::string> fAllowed; ///< Commands the tool may run
+  SandboxRoot fRoot;              ///< Working directories are confined to this directory
+
+  /// Closes a descriptor when going out of scope
+  struct Descriptor {
+    int fd = -1;
+
+    explicit Descriptor(int descriptor = -1) : fd(descriptor) {}
+    Descriptor(Descriptor &&other) noexcept : fd(other.fd) { other.fd = -1; }
+    Descriptor(const Descriptor &) = delete;
+    Descriptor &operator=(const Descriptor &) = delete;
+    ~Descriptor() { reset(); }
+
+    void reset() {
+      if (fd >= 0) {
+        close(fd);
+        fd = -1;
+      }
+    }
+  };
+
+  /// Spawned process with its output pipes
+  struct Process {
+    pid_t pid = -1;
+    Descriptor out;
+    Descriptor err;
+    Descriptor exit;    ///< pidfd, readable once the process exited (-1: not supported)
+  };
+
+  /// Kills and reaps a process still running when a call unwinds
+  struct Reaper {
+    pid_t pid;
+    bool reaped = false;
+
+    explicit Reaper(pid_t process) : pid(process) {}
+    Reaper(const Reaper &) = delete;
+    Reaper &operator=(const Reaper &) = delete;
+    ~Reaper() {
+      if (!reaped) {
+        terminate(pid);
+      }
+    }
+  };
+
+  Process spawn(const std::string &command, const std::vector<std::string> &arguments,
+                const std::string &directory) const {
+    int outPipe[2];
+    int errPipe[2];
+    if (pipe2(outPipe, O_CLOEXEC) != 0) {
+      throw std::runtime_error("Cannot create pipe: " + std::string(strerror(errno)));
+    }
+    Descriptor outWrite{outPipe[1]};
+    Process process;
+    process.out.fd = outPipe[0];
+    if (pipe2(errPipe, O_CLOEXEC) != 0) {
+      throw std::runtime_error("Cannot create pipe: " + std::string(strerror(errno)));
+    }
+    Descriptor errWrite{errPipe[1]};
+    process.err.fd = errPipe[0];
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, outWrite.fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, errWrite.fd, STDERR_FILENO);
+#if MCP_GLIBC_PREREQ(2, 29)
+    posix_spawn_file_actions_addchdir_np(&actions, directory.c_str());
+#else
+    char current[PATH_MAX];
+    if (getcwd(current, sizeof(current)) == nullptr || directory != current) {
+      posix_spawn_file_actions_destroy(&actions);
+      throw std::runtime_error("cwd is not supported by this C library");
+    }
+#endif
+#if MCP_GLIBC_PREREQ(2, 34)
+    // Descriptors opened without O_CLOEXEC (e.g. the upgrade handoff) stay in the server
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+
+    // Own process group, so a timeout kills the children of the command too;
+    // default dispositions and an empty mask whatever the server changed
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                              POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    sigfillset(&signals);
+    posix_spawnattr_setsigdefault(&attributes, &signals);
+
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(command.c_str()));
+    for (const std::string &argument : arguments) {
+      argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    int error = posix_spawnp(&process.pid, command.c_str(), &actions, &attributes, argv.data(), environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+      throw std::runtime_error("Cannot run " + command + ": " + strerror(error));
+    }
+    fcntl(process.out.fd, F_SETFL, O_NONBLOCK);
+    fcntl(process.err.fd, F_SETFL, O_NONBLOCK);
+#if defined(SYS_pidfd_open)
+    process.exit.fd = static_cast<int>(syscall(SYS_pidfd_open, process.pid, 0));
+#endif
+    return process;
+  }
+
+  // SIGTERM to the process group, then SIGKILL if it is still running
+  static int terminate(pid_t pid) {
+    kill(-pid, SIGTERM);
+    int status = 0;
+    auto deadline = Clock::now() + kKillGrace;
+    while (Clock::now() < deadline) {
+      if (waitpid(pid, &status, WNOHANG) == pid) {
+        kill(-pid, SIGKILL); // children that ignored SIGTERM
+        return status;
+      }
+      usleep(10000);
+    }
+    kill(-pid, SIGKILL);
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    return status;
+  }
+
+  static std::string describeStatus(int status) {
+    if (WIFEXITED(status)) {
+      return "Exit code " + std::to_string(WEXITSTATUS(status));
+    }
+    if (WIFSIGNALED(status)) {
+      return "Killed by signal " + std::to_string(WTERMSIG(status)) + " (" + strsignal(WTERMSIG(status)) + ")";
+    }
+    return "Unknown status " + std::to_string(status);
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param allowed Comma-separated names (looked up in PATH) or paths of the allowed commands
+   * @param root Directory holding the working directories of the commands
+   * @throws std::runtime_error if the root is not a directory
+   */
+  CommandTool(const std::string &allowed, const std::string &root) : fRoot(root) {
+    std::size_t start = 0;
+    while (start <= allowed.size()) {
+      std::size_t comma = allowed.find(',', start);
+      std::string command = allowed.substr(start, comma - start);
+      command.erase(0, command.find_first_not_of(" \t"));
+      command.erase(command.find_last_not_of(" \t") + 1);
+      if (!command.empty()) {
+        fAllowed.insert(command);
+      }
+      if (comma == std::string::npos) {
+        break;
+      }
+      start = comma + 1;
+    }
+  }
+
+  std::string name() const override { return "CommandTool"; }
+
+  std::string describe() const override {
+    std::string allowed;
+    for (const std::string &command : fAllowed) {
+      allowed += (allowed.empty() ? "" : ", ") + command;
+    }
+    json description = {
+        {"name", name()},
+        {"description", "Run a command and return its output and exit status. Allowed commands: " +
+                            (allowed.empty() ? std::string("none") : allowed)},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"command", {{"type", "string"}, {"description", "Command to run"}}},
+            {"args", {{"type", "array"}, {"items", {{"type", "string"}}}, {"description", "Command arguments (not interpreted by a shell)"}}},
+            {"cwd", {{"type", "string"}, {"description", "Working directory, relative to the tool root (default: the root)"}}},
+            {"timeoutMs", {{"type", "integer"}, {"description", "Time limit in milliseconds (default: 30000, at most 600000)"}}},
+            {"maxOutputBytes", {{"type", "integer"}, {"description", "Limit on stdout plus stderr; the command is killed when it is exceeded (default: 1048576)"}}}}},
+          {"required", json::array({"command"})}}}};
+
+    return description.dump();
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    std::string command = arguments.value("command", "");
+    if (fAllowed.count(command) == 0) {
+      throw std::invalid_argument("Command not allowed: " + command);
+    }
+    std::vector<std::string> commandArguments = arguments.value("args", std::vector<std::string>());
+    std::string directory = fRoot.resolve(arguments.value("cwd", "."));
+    auto timeout = std::chrono::milliseconds(
+        std::clamp<int64_t>(arguments.value("timeoutMs", kDefaultTimeoutMs), 1, kMaxTimeoutMs));
+    std::size_t maxOutput = std::clamp<int64_t>(arguments.value("maxOutputBytes", int64_t(kDefaultMaxOutput)),
+                                                0, kMaxOutput);
+
+    McpCancellation cancellation = currentCancellation();
+    const McpProgress &progress = currentProgress();
+    auto start = Clock::now();
+    Process process = spawn(command, commandArguments, directory);
+    Reaper reaper(process.pid);
+
+    std::string output[2];             // stdout, stderr
+    std::size_t total = 0;             // bytes read from both pipes
+    std::string pending;               // output not yet sent as progress
+    auto lastProgress = start;
+    auto flushProgress = [&](bool force) {
+      auto now = Clock::now();
+      while (!pending.empty() && (force || now - lastProgress >= kProgressInterval)) {
+        std::size_t size = std::min(pending.size(), kProgressMessageBytes);
+        progress.report(double(total - pending.size() + size), pending.substr(0, size));
+        pending.erase(0, size);
+        lastProgress = now;
+      }
+    };
+
+    Stop stop = Stop::None;
+    bool exited = false;
+    int status = 0;
+    Clock::time_point exitTime;
+    std::vector<char> buffer(kReadSize);
+    while (true) {
+      auto now = Clock::now();
+      if (cancellation.requested()) {
+        stop = Stop::Cancelled;
+        break;
+      }
+      if (now - start >= timeout) {
+        stop = Stop::TimedOut;
+        break;
+      }
+      if (!exited && waitpid(process.pid, &status, WNOHANG) == process.pid) {
+        exited = true;
+        reaper.reaped = true;
+        exitTime = now;
+        process.exit.reset();
+      }
+      bool open = process.out.fd >= 0 || process.err.fd >= 0;
+      if (exited && (!open || now - exitTime >= kDrainDelay)) {
+        break; // after the delay, a background child of the command holds the pipes
+      }
+      auto wait = std::min<Clock::duration>(kPollInterval, timeout - (now - start));
+      if (exited) {
+        wait = std::min<Clock::duration>(wait, kDrainDelay - (now - exitTime));
+      } else if (!open && process.exit.fd < 0) {
+        wait = std::min<Clock::duration>(wait, std::chrono::milliseconds(1)); // no pidfd: poll the exit
+      }
+      pollfd fds[3] = {{process.out.fd, POLLIN, 0}, {process.err.fd, POLLIN, 0}, {process.exit.fd, POLLIN, 0}};
+      int ready = poll(fds, 3, std::max<int>(1, std::chrono::ceil<std::chrono::milliseconds>(wait).count()));
+      if (ready < 0 && errno != EINTR) {
+        throw std::runtime_error("poll failed: " + std::string(strerror(errno)));
+      }
+      Descriptor *pipes[2] = {&process.out, &process.err};
+      for (int i = 0; i < 2 && ready > 0; ++i) {
+        if (fds[i].fd < 0 || fds[i].revents == 0) {
+          continue;
+        }
+        ssize_t count = read(pipes[i]->fd, buffer.data(), buffer.size());
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+          pipes[i]->reset();
+          continue;
+        }
+        if (count < 0) {
+          continue;
+        }
+        std::size_t kept = std::min<std::size_t>(count, maxOutput - std::min(maxOutput, total));
+        output[i].append(buffer.data(), kept);
+        total += kept;
+        if (progress.enabled()) {
+          pending.append(buffer.data(), kept);
+        }
+        if (kept < std::size_t(count)) {
+          stop = Stop::OutputLimit;
+        }
+      }
+      if (stop != Stop::None) {
+        break;
+      }
+      if (progress.enabled()) {
+        flushProgress(false);
+      }
+    }
+    if (progress.enabled()) {
+      flushProgress(true);
+    }
+
+    bool killed = stop != Stop::None && !exited;
+    if (killed) {
+      reaper.reaped = true;
+      status = terminate(process.pid);
+    }
+    if (stop == Stop::Cancelled) {
+      throw std::runtime_error("Cancelled");
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+
+    json content = json::array();
+    if (!output[0].empty()) {
+      content.push_back(textItem(output[0]));
+    }
+    if (!output[1].empty()) {
+      content.push_back(textItem("stderr:\n" + output[1]));
+    }
+    std::string summary;
+    if (stop == Stop::TimedOut) {
+      summary = "Timed out after " + std::to_string(timeout.count()) + " ms, process killed";
+    } else if (stop == Stop::OutputLimit) {
+      summary = "Output limit of " + std::to_string(maxOutput) + " bytes reached" +
+                (killed ? ", process killed" : ", " + describeStatus(status));
+    } else {
+      summary = describeStatus(status) + " after " + std::to_string(elapsed) + " ms";
+    }
+    content.push_back(textItem(summary));
+    return content;
+  }
+};
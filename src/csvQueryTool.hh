@@ -0,0 +1,742 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "csvTable.hh"
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool computing filters, group-by aggregates and top-k over CSV files
+ *
+ * A file is parsed once into a columnar CsvTable, kept in a small LRU keyed
+ * by device, inode, size, modification time and delimiter, so later queries
+ * on an unchanged file only scan its columns. Rows are split into ranges
+ * filtered and aggregated by several threads, each into its own group map;
+ * the maps are merged and the top rows are selected with a partial sort.
+ */
+class CsvQueryTool : public McpTool {
+private:
+  static constexpr std::size_t kTableCacheSize = 4;      ///< Files with a cached table
+  static constexpr std::size_t kMinRowsPerThread = 65536;
+  static constexpr std::size_t kCancelCheckRows = 65536;
+
+  /// Identity of one version of a file, parsed with one delimiter
+  struct FileKey {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    int64_t mtimeNs;
+    char delimiter;
+
+    bool operator==(const FileKey &other) const {
+      return dev == other.dev && ino == other.ino && size == other.size &&
+             mtimeNs == other.mtimeNs && delimiter == other.delimiter;
+    }
+  };
+
+  struct FileKeyHash {
+    std::size_t operator()(const FileKey &key) const {
+      return std::hash<uint64_t>()(key.ino * 31 + key.dev) ^ std::hash<int64_t>()(key.mtimeNs);
+    }
+  };
+
+  /// Cache slot; the mutex serializes the first load of a table
+  struct Slot {
+    std::mutex mutex;
+    std::shared_ptr<const CsvTable> table;
+  };
+
+  struct Condition {
+    enum class Op { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, Contains } op;
+    std::size_t column;
+    double number;      ///< Operand for numeric columns
+    std::string text;   ///< Operand for text columns
+    std::vector<uint8_t> accepted; ///< Text columns: result for each distinct value
+  };
+
+  struct Aggregate {
+    enum class Kind { Count, Sum, Avg, Min, Max } kind;
+    std::size_t column; ///< SIZE_MAX for count(*)
+    std::string label;  ///< e.g. "sum(price)"
+  };
+
+  /// Running state of one aggregate in one group
+  struct State {
+    double count = 0;
+    double sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+  };
+
+  struct Group {
+    std::string key;      ///< Group column values (see groupKey)
+    std::size_t firstRow; ///< Supplies the values of the group columns
+    std::size_t rows = 0;
+    std::vector<State> states;
+  };
+
+  struct Query {
+    std::vector<Condition> where;
+    std::vector<std::size_t> groupBy;
+    std::vector<Aggregate> aggregates;
+    std::vector<std::size_t> select;      ///< Columns returned in row mode
+    std::string orderBy;                  ///< Column or aggregate label (empty: none)
+    bool descending = true;
+    std::size_t limit = 20;
+  };
+
+  SandboxRoot fRoot;                 ///< Directory readable by the tool
+  std::mutex fCacheMutex;            ///< Protects the LRU
+  std::list<FileKey> fLru;           ///< Most recently used first
+  std::unordered_map<FileKey, std::pair<std::shared_ptr<Slot>, std::list<FileKey>::iterator>, FileKeyHash>
+      fTables;                       ///< Cached tables
+
+  std::shared_ptr<Slot> slotFor(const FileKey &key) {
+    std::lock_guard<std::mutex> lock(fCacheMutex);
+    auto entry = fTables.find(key);
+    if (entry != fTables.end()) {
+      fLru.splice(fLru.begin(), fLru, entry->second.second);
+      return entry->second.first;
+    }
+    if (fTables.size() >= kTableCacheSize) {
+      fTables.erase(fLru.back());
+      fLru.pop_back();
+    }
+    fLru.push_front(key);
+    auto slot = std::make_shared<Slot>();
+    fTables.emplace(key, std::make_pair(slot, fLru.begin()));
+    return slot;
+  }
+
+  std::shared_ptr<const CsvTable> tableFor(const std::string &path, char delimiter) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      throw std::invalid_argument("Not a regular file");
+    }
+    FileKey key{st.st_dev, st.st_ino, st.st_size,
+                int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec, delimiter};
+    std::shared_ptr<Slot> slot = slotFor(key);
+    std::lock_guard<std::mutex> lock(slot->mutex);
+    if (!slot->table) {
+      slot->table = std::make_shared<const CsvTable>(path, delimiter, threadCount());
+    }
+    return slot->table;
+  }
+
+  static std::size_t threadCount() { return std::clamp(std::thread::hardware_concurrency(), 1u, 8u); }
+
+  // --------------------------------------------------------------------------
+  // Query parsing
+  // --------------------------------------------------------------------------
+
+  static std::string trim(std::string_view text) {
+    std::size_t first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+      return "";
+    }
+    return std::string(text.substr(first, text.find_last_not_of(" \t") - first + 1));
+  }
+
+  static std::vector<std::string> splitList(const std::string &text) {
+    std::vector<std::string> items;
+    std::size_t start = 0;
+    while (start <= text.size()) {
+      std::size_t comma = text.find(',', start);
+      std::string item = trim(std::string_view(text).substr(start, comma - start));
+      if (!item.empty()) {
+        items.push_back(item);
+      }
+      if (comma == std::string::npos) {
+        break;
+      }
+      start = comma + 1;
+    }
+    return items;
+  }
+
+  static std::string lower(std::string text) {
+    for (char &c : text) {
+      c = std::tolower(static_cast<unsigned char>(c));
+    }
+    return text;
+  }
+
+  static std::vector<Aggregate> parseAggregates(const CsvTable &table, const std::string &text) {
+    static const std::pair<const char *, Aggregate::Kind> kKinds[] = {
+        {"count", Aggregate::Kind::Count}, {"sum", Aggregate::Kind::Sum}, {"avg", Aggregate::Kind::Avg},
+        {"min", Aggregate::Kind::Min},     {"max", Aggregate::Kind::Max}};
+    std::vector<Aggregate> aggregates;
+    for (const std::string &item : splitList(text)) {
+      std::size_t open = item.find('(');
+      std::string function = lower(trim(item.substr(0, open)));
+      std::string argument;
+      if (open != std::string::npos) {
+        if (item.back() != ')') {
+          throw std::invalid_argument("Invalid aggregate: " + item);
+        }
+        argument = trim(std::string_view(item).substr(open + 1, item.size() - open - 2));
+      }
+      auto kind = std::find_if(std::begin(kKinds), std::end(kKinds),
+                               [&](const auto &entry) { return function == entry.first; });
+      if (kind == std::end(kKinds)) {
+        throw std::invalid_argument("Unknown aggregate: " + item + " (expected count, sum, avg, min or max)");
+      }
+      Aggregate aggregate{kind->second, SIZE_MAX, function + "(" + (argument.empty() ? "*" : argument) + ")"};
+      if (argument.empty() || argument == "*") {
+        if (aggregate.kind != Aggregate::Kind::Count) {
+          throw std::invalid_argument("Aggregate needs a column: " + item);
+        }
+      } else {
+        aggregate.column = table.column(argument);
+        if (aggregate.kind != Aggregate::Kind::Count && !table.columns()[aggregate.column].numeric) {
+          throw std::invalid_argument("Not a numeric column: " + argument);
+        }
+      }
+      aggregates.push_back(aggregate);
+    }
+    return aggregates;
+  }
+
+  // Condition list "column op value [and column op value ...]"
+  static std::vector<Condition> parseWhere(const CsvTable &table, const std::string &text) {
+    std::vector<Condition> conditions;
+    if (trim(text).empty()) {
+      return conditions;
+    }
+    std::size_t p = 0;
+    auto skipSpaces = [&] {
+      while (p < text.size() && std::isspace(static_cast<unsigned char>(text[p]))) {
+        ++p;
+      }
+    };
+    auto word = [&](const char *stops) {
+      skipSpaces();
+      if (p < text.size() && (text[p] == '"' || text[p] == '\'')) {
+        char quote = text[p++];
+        std::size_t close = text.find(quote, p);
+        if (close == std::string::npos) {
+          throw std::invalid_argument("Unterminated quote in filter");
+        }
+        std::string quoted = text.substr(p, close - p);
+        p = close + 1;
+        return quoted;
+      }
+      std::size_t start = p;
+      while (p < text.size() && !std::isspace(static_cast<unsigned char>(text[p])) &&
+             std::strchr(stops, text[p]) == nullptr) {
+        ++p;
+      }
+      return text.substr(start, p - start);
+    };
+    static const std::pair<const char *, Condition::Op> kOps[] = {
+        {"==", Condition::Op::Equal},     {"!=", Condition::Op::NotEqual},
+        {"<>", Condition::Op::NotEqual},  {"<=", Condition::Op::LessEqual},
+        {">=", Condition::Op::GreaterEqual}, {"=", Condition::Op::Equal},
+        {"<", Condition::Op::Less},       {">", Condition::Op::Greater},
+        {"contains", Condition::Op::Contains}};
+
+    while (true) {
+      std::string name = word("=!<>");
+      if (name.empty()) {
+        throw std::invalid_argument("Expected a column name in filter at offset " + std::to_string(p));
+      }
+      Condition condition{Condition::Op::Equal, table.column(name), 0, "", {}};
+      skipSpaces();
+      auto op = std::find_if(std::begin(kOps), std::end(kOps), [&](const auto &entry) {
+        return text.compare(p, std::strlen(entry.first), entry.first) == 0;
+      });
+      if (op == std::end(kOps)) {
+        throw std::invalid_argument("Expected an operator after " + name + " in filter");
+      }
+      p += std::strlen(op->first);
+      condition.op = op->second;
+      condition.text = word("");
+      const CsvTable::Column &column = table.columns()[condition.column];
+      if (!column.numeric) {
+        // Evaluated once per distinct value instead of once per row
+        condition.accepted.resize(column.values.size());
+        for (std::size_t v = 0; v < column.values.size(); ++v) {
+          condition.accepted[v] = condition.op == Condition::Op::Contains
+                                      ? column.values[v].find(condition.text) != std::string_view::npos
+                                      : compare(condition.op, column.values[v], std::string_view(condition.text));
+        }
+      } else if (condition.op == Condition::Op::Contains) {
+        // The raw text of numeric cells is not kept
+        throw std::invalid_argument("'contains' needs a text column; " + name + " is numeric");
+      } else {
+        char *end = nullptr;
+        condition.number = std::strtod(condition.text.c_str(), &end);
+        if (condition.text.empty() || *end != '\0') {
+          throw std::invalid_argument("Expected a number for column " + name + ", got '" + condition.text + "'");
+        }
+      }
+      conditions.push_back(condition);
+      skipSpaces();
+      if (p == text.size()) {
+        return conditions;
+      }
+      if (lower(word("")) != "and") {
+        throw std::invalid_argument("Expected 'and' in filter at offset " + std::to_string(p));
+      }
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Evaluation
+  // --------------------------------------------------------------------------
+
+  template <typename T>
+  static bool compare(Condition::Op op, const T &value, const T &operand) {
+    switch (op) {
+    case Condition::Op::Equal:
+      return value == operand;
+    case Condition::Op::NotEqual:
+      return value != operand;
+    case Condition::Op::Less:
+      return value < operand;
+    case Condition::Op::LessEqual:
+      return value <= operand;
+    case Condition::Op::Greater:
+      return value > operand;
+    case Condition::Op::GreaterEqual:
+      return value >= operand;
+    default:
+      return false;
+    }
+  }
+
+  static bool matches(const CsvTable &table, const std::vector<Condition> &conditions, std::size_t row) {
+    for (const Condition &condition : conditions) {
+      const CsvTable::Column &column = table.columns()[condition.column];
+      if (column.numeric) {
+        double value = column.numbers[row];
+        if (std::isnan(value) ? condition.op != Condition::Op::NotEqual
+                              : !compare(condition.op, value, condition.number)) {
+          return false;
+        }
+      } else if (!condition.accepted[column.codes[row]]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Bytes identifying the values of the group columns in a row
+  static void groupKey(const CsvTable &table, const std::vector<std::size_t> &columns, std::size_t row,
+                       std::string &key) {
+    key.clear();
+    for (std::size_t c : columns) {
+      const CsvTable::Column &column = table.columns()[c];
+      if (column.numeric) {
+        double value = column.numbers[row];
+        if (std::isnan(value)) {
+          value = std::numeric_limits<double>::quiet_NaN(); // one key for all empty cells
+        } else if (value == 0) {
+          value = 0; // -0 and 0 are one group
+        }
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+      } else {
+        key.append(reinterpret_cast<const char *>(&column.codes[row]), sizeof(uint32_t));
+      }
+    }
+  }
+
+  static void accumulate(const CsvTable &table, const std::vector<Aggregate> &aggregates, std::size_t row,
+                         Group &group) {
+    ++group.rows;
+    for (std::size_t a = 0; a < aggregates.size(); ++a) {
+      const Aggregate &aggregate = aggregates[a];
+      State &state = group.states[a];
+      if (aggregate.column == SIZE_MAX) {
+        ++state.count;
+        continue;
+      }
+      const CsvTable::Column &column = table.columns()[aggregate.column];
+      if (!column.numeric) {
+        state.count += !column.text(row).empty();
+        continue;
+      }
+      double value = column.numbers[row];
+      if (!std::isnan(value)) {
+        ++state.count;
+        state.sum += value;
+        state.min = std::min(state.min, value);
+        state.max = std::max(state.max, value);
+      }
+    }
+  }
+
+  static void merge(const Group &from, Group &into) {
+    into.firstRow = std::min(into.firstRow, from.firstRow);
+    into.rows += from.rows;
+    for (std::size_t a = 0; a < into.states.size(); ++a) {
+      into.states[a].count += from.states[a].count;
+      into.states[a].sum += from.states[a].sum;
+      into.states[a].min = std::min(into.states[a].min, from.states[a].min);
+      into.states[a].max = std::max(into.states[a].max, from.states[a].max);
+    }
+  }
+
+  // Integral values are written without a fraction, as they were in the file
+  static json number(double value) {
+    if (std::isnan(value)) {
+      return json();
+    }
+    if (value == std::trunc(value) && std::fabs(value) < 9007199254740992.0) {
+      return int64_t(value);
+    }
+    return value;
+  }
+
+  // Value of an aggregate; NaN when it has no value (avg, min, max of no cells)
+  static double aggregateNumber(const Aggregate &aggregate, const State &state) {
+    switch (aggregate.kind) {
+    case Aggregate::Kind::Count:
+      return state.count;
+    case Aggregate::Kind::Sum:
+      return state.sum;
+    case Aggregate::Kind::Avg:
+      return state.count > 0 ? state.sum / state.count : std::numeric_limits<double>::quiet_NaN();
+    case Aggregate::Kind::Min:
+      return state.count > 0 ? state.min : std::numeric_limits<double>::quiet_NaN();
+    case Aggregate::Kind::Max:
+      return state.count > 0 ? state.max : std::numeric_limits<double>::quiet_NaN();
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  static json cellValue(const CsvTable::Column &column, std::size_t row) {
+    if (column.numeric) {
+      return number(column.numbers[row]);
+    }
+    return std::string(column.text(row));
+  }
+
+  // Orders rows by one column, empty cells last, ties in file order
+  static bool cellBefore(const CsvTable::Column &column, std::size_t a, std::size_t b, bool descending) {
+    if (column.numeric) {
+      double x = column.numbers[a];
+      double y = column.numbers[b];
+      if (std::isnan(x) || std::isnan(y)) {
+        return std::isnan(x) != std::isnan(y) ? std::isnan(y) : a < b;
+      }
+      return x != y ? (descending ? x > y : x < y) : a < b;
+    }
+    std::string_view x = column.text(a);
+    std::string_view y = column.text(b);
+    if (x.empty() || y.empty()) {
+      return x.empty() != y.empty() ? y.empty() : a < b;
+    }
+    return x != y ? (descending ? x > y : x < y) : a < b;
+  }
+
+  // Split [0, rows) into ranges and run work(begin, end, index) on each
+  static std::size_t rangeCount(std::size_t rows) {
+    return std::clamp<std::size_t>(rows / kMinRowsPerThread, 1, threadCount());
+  }
+
+  template <typename Work>
+  static void parallelRanges(std::size_t rows, Work work) {
+    std::size_t threads = rangeCount(rows);
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) {
+      pool.emplace_back([&, i] { work(rows * i / threads, rows * (i + 1) / threads, i); });
+    }
+    work(0, rows / threads, 0);
+    for (auto &thread : pool) {
+      thread.join();
+    }
+  }
+
+  json groupQuery(const CsvTable &table, const Query &query, const McpCancellation &cancellation) {
+    // A single text group column is grouped by its codes through a dense
+    // slot array, other group columns through a hash map of their keys
+    const CsvTable::Column *dense = nullptr;
+    if (query.groupBy.size() == 1 && !table.columns()[query.groupBy[0]].numeric) {
+      dense = &table.columns()[query.groupBy[0]];
+    }
+    std::vector<std::vector<Group>> parts(rangeCount(table.rows()));
+    std::vector<std::size_t> matched(parts.size(), 0);
+    parallelRanges(table.rows(), [&](std::size_t begin, std::size_t end, std::size_t index) {
+      std::vector<Group> &groups = parts[index];
+      std::vector<uint32_t> slots(dense ? dense->values.size() : 0, UINT32_MAX);
+      std::unordered_map<std::string, uint32_t> keys;
+      uint32_t only = UINT32_MAX;
+      std::string key;
+      for (std::size_t row = begin; row < end; ++row) {
+        if ((row - begin) % kCancelCheckRows == 0 && cancellation.requested()) {
+          return;
+        }
+        if (!matches(table, query.where, row)) {
+          continue;
+        }
+        ++matched[index];
+        uint32_t *slot = &only;
+        if (dense != nullptr) {
+          slot = &slots[dense->codes[row]];
+        } else if (!query.groupBy.empty()) {
+          groupKey(table, query.groupBy, row, key);
+          slot = &keys.try_emplace(key, UINT32_MAX).first->second;
+        }
+        if (*slot == UINT32_MAX) {
+          *slot = groups.size();
+          groupKey(table, query.groupBy, row, key);
+          groups.push_back({key, row, 0, std::vector<State>(query.aggregates.size())});
+        }
+        accumulate(table, query.aggregates, row, groups[*slot]);
+      }
+    });
+    if (cancellation.requested()) {
+      throw std::runtime_error("Cancelled");
+    }
+
+    std::vector<Group> groups = std::move(parts[0]);
+    std::unordered_map<std::string, std::size_t> positions;
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+      positions.emplace(groups[i].key, i);
+    }
+    for (std::size_t i = 1; i < parts.size(); ++i) {
+      for (Group &group : parts[i]) {
+        auto position = positions.find(group.key);
+        if (position != positions.end()) {
+          merge(group, groups[position->second]);
+        } else {
+          positions.emplace(group.key, groups.size());
+          groups.push_back(std::move(group));
+        }
+      }
+    }
+    std::size_t totalMatched = 0;
+    for (std::size_t count : matched) {
+      totalMatched += count;
+    }
+    if (query.groupBy.empty() && groups.empty()) {
+      groups.push_back({"", 0, 0, std::vector<State>(query.aggregates.size())});
+    }
+
+    std::vector<const Group *> ordered;
+    ordered.reserve(groups.size());
+    for (const Group &group : groups) {
+      ordered.push_back(&group);
+    }
+    std::size_t shown = std::min(query.limit, ordered.size());
+    auto byFirstRow = [](const Group *a, const Group *b) { return a->firstRow < b->firstRow; };
+    if (query.orderBy.empty()) {
+      std::partial_sort(ordered.begin(), ordered.begin() + shown, ordered.end(), byFirstRow);
+    } else {
+      auto aggregate = std::find_if(query.aggregates.begin(), query.aggregates.end(),
+                                    [&](const Aggregate &a) { return a.label == query.orderBy; });
+      if (aggregate != query.aggregates.end()) {
+        std::size_t a = aggregate - query.aggregates.begin();
+        auto value = [&](const Group *group) { return aggregateNumber(*aggregate, group->states[a]); };
+        std::partial_sort(ordered.begin(), ordered.begin() + shown, ordered.end(),
+                          [&](const Group *x, const Group *y) {
+                            double vx = value(x);
+                            double vy = value(y);
+                            if (std::isnan(vx) != std::isnan(vy)) {
+                              return std::isnan(vy);
+                            }
+                            if (vx != vy && !std::isnan(vx)) {
+                              return query.descending ? vx > vy : vx < vy;
+                            }
+                            return byFirstRow(x, y);
+                          });
+      } else {
+        std::size_t c = table.column(query.orderBy);
+        if (std::find(query.groupBy.begin(), query.groupBy.end(), c) == query.groupBy.end()) {
+          throw std::invalid_argument("orderBy must name a group column or an aggregate: " + query.orderBy);
+        }
+        const CsvTable::Column &column = table.columns()[c];
+        std::partial_sort(ordered.begin(), ordered.begin() + shown, ordered.end(),
+                          [&](const Group *x, const Group *y) {
+                            return cellBefore(column, x->firstRow, y->firstRow, query.descending);
+                          });
+      }
+    }
+
+    json content = json::array();
+    for (std::size_t i = 0; i < shown; ++i) {
+      const Group &group = *ordered[i];
+      json result = json::object();
+      for (std::size_t c : query.groupBy) {
+        result[table.columns()[c].name] = cellValue(table.columns()[c], group.firstRow);
+      }
+      for (std::size_t a = 0; a < query.aggregates.size(); ++a) {
+        result[query.aggregates[a].label] = number(aggregateNumber(query.aggregates[a], group.states[a]));
+      }
+      content.push_back(textItem(result.dump(-1, ' ', false, json::error_handler_t::replace)));
+    }
+    std::string summary = std::to_string(totalMatched) + " of " + std::to_string(table.rows()) + " rows matched";
+    if (!query.groupBy.empty()) {
+      summary += ", " + std::to_string(groups.size()) + " groups";
+      if (shown < groups.size()) {
+        summary += ", showing " + std::to_string(shown);
+      }
+    }
+    content.push_back(textItem(summary));
+    return content;
+  }
+
+  json rowQuery(const CsvTable &table, const Query &query, const McpCancellation &cancellation) {
+    std::size_t threads = rangeCount(table.rows());
+    std::vector<std::vector<std::size_t>> parts(threads);
+    parallelRanges(table.rows(), [&](std::size_t begin, std::size_t end, std::size_t index) {
+      for (std::size_t row = begin; row < end; ++row) {
+        if ((row - begin) % kCancelCheckRows == 0 && cancellation.requested()) {
+          return;
+        }
+        if (matches(table, query.where, row)) {
+          parts[index].push_back(row);
+        }
+      }
+    });
+    if (cancellation.requested()) {
+      throw std::runtime_error("Cancelled");
+    }
+
+    std::vector<std::size_t> rows;
+    for (auto &part : parts) {
+      rows.insert(rows.end(), part.begin(), part.end());
+      std::vector<std::size_t>().swap(part);
+    }
+    std::size_t shown = std::min(query.limit, rows.size());
+    if (!query.orderBy.empty()) {
+      const CsvTable::Column &column = table.columns()[table.column(query.orderBy)];
+      std::partial_sort(rows.begin(), rows.begin() + shown, rows.end(), [&](std::size_t a, std::size_t b) {
+        return cellBefore(column, a, b, query.descending);
+      });
+    }
+
+    json content = json::array();
+    for (std::size_t i = 0; i < shown; ++i) {
+      json result = json::object();
+      for (std::size_t c : query.select) {
+        result[table.columns()[c].name] = cellValue(table.columns()[c], rows[i]);
+      }
+      content.push_back(textItem("row " + std::to_string(rows[i] + 1) + ": " +
+                                 result.dump(-1, ' ', false, json::error_handler_t::replace)));
+    }
+    std::string summary = std::to_string(rows.size()) + " of " + std::to_string(table.rows()) + " rows matched";
+    if (shown < rows.size()) {
+      summary += ", showing " + std::to_string(shown);
+    }
+    content.push_back(textItem(summary));
+    return content;
+  }
+
+  static char delimiterFor(const json &arguments, const std::string &relative) {
+    std::string delimiter = arguments.value("delimiter", "");
+    if (delimiter == "\\t" || delimiter == "tab") {
+      return '\t';
+    }
+    if (delimiter.size() == 1 && delimiter[0] != '"' && delimiter[0] != '\n' && delimiter[0] != '\r') {
+      return delimiter[0];
+    }
+    if (!delimiter.empty()) {
+      throw std::invalid_argument("Invalid delimiter: " + delimiter);
+    }
+    bool tsv = relative.size() >= 4 && lower(relative.substr(relative.size() - 4)) == ".tsv";
+    return tsv ? '\t' : ',';
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param root Directory the tool is allowed to read
+   */
+  explicit CsvQueryTool(const std::string &root) : fRoot(root) {}
+
+  std::string name() const override { return "CsvQueryTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Filter, aggregate and rank the rows of a CSV file with a header line. "
+                        "With 'groupBy' or 'aggregates', returns one object per group; otherwise "
+                        "returns the matching rows"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"path", {{"type", "string"}, {"description", "File path, relative to the tool root"}}},
+            {"where", {{"type", "string"}, {"description", "Conditions joined by 'and', e.g. 'country == \"FR\" and price >= 10'; operators: == != < <= > >=, and contains on text columns"}}},
+            {"groupBy", {{"type", "string"}, {"description", "Comma-separated group columns"}}},
+            {"aggregates", {{"type", "string"}, {"description", "Comma-separated aggregates: count, count(col), sum(col), avg(col), min(col), max(col) (default with groupBy: count)"}}},
+            {"select", {{"type", "string"}, {"description", "Comma-separated columns returned for each row (default: all)"}}},
+            {"orderBy", {{"type", "string"}, {"description", "Column or aggregate to rank by, optionally followed by 'asc' or 'desc' (default: desc)"}}},
+            {"limit", {{"type", "integer"}, {"description", "Maximum number of rows or groups returned (default: 20)"}}},
+            {"delimiter", {{"type", "string"}, {"description", "Field separator (default: tab for .tsv files, comma otherwise)"}}}}},
+          {"required", json::array({"path"})}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    std::string relative = arguments.value("path", "");
+    std::string path = fRoot.resolve(relative);
+    std::shared_ptr<const CsvTable> table = tableFor(path, delimiterFor(arguments, relative));
+
+    Query query;
+    query.where = parseWhere(*table, arguments.value("where", ""));
+    for (const std::string &name : splitList(arguments.value("groupBy", ""))) {
+      query.groupBy.push_back(table->column(name));
+    }
+    query.aggregates = parseAggregates(*table, arguments.value("aggregates", ""));
+    if (!query.groupBy.empty() && query.aggregates.empty()) {
+      query.aggregates = parseAggregates(*table, "count");
+    }
+    for (const std::string &name : splitList(arguments.value("select", ""))) {
+      query.select.push_back(table->column(name));
+    }
+    if (query.select.empty()) {
+      for (std::size_t c = 0; c < table->columns().size(); ++c) {
+        query.select.push_back(c);
+      }
+    }
+    std::string orderBy = trim(arguments.value("orderBy", ""));
+    std::size_t space = orderBy.find_last_of(" \t");
+    if (space != std::string::npos) {
+      std::string direction = lower(orderBy.substr(space + 1));
+      if (direction == "asc" || direction == "desc") {
+        query.descending = direction == "desc";
+        orderBy = trim(orderBy.substr(0, space));
+      }
+    }
+    // Aggregates are matched by their normalized label, e.g. "SUM( price )" -> "sum(price)"
+    if (!orderBy.empty() && orderBy.back() == ')' && !query.aggregates.empty()) {
+      orderBy = parseAggregates(*table, orderBy)[0].label;
+    }
+    query.orderBy = orderBy;
+    query.limit = std::max<int64_t>(1, arguments.value("limit", int64_t(20)));
+
+    McpCancellation cancellation = currentCancellation();
+    return query.aggregates.empty() ? rowQuery(*table, query, cancellation)
+                                    : groupQuery(*table, query, cancellation);
+  }
+};
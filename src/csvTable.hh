@@ -0,0 +1,368 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ============================================================================
+// CSV Table
+// ============================================================================
+
+/**
+ * @brief Columnar in-memory copy of a CSV file
+ *
+ * The file is memory-mapped and split into chunks parsed by several
+ * threads. Chunk boundaries are moved to the next record start outside
+ * quotes, using the parity of the quotes counted before each boundary, so
+ * quoted fields may contain newlines. Unquoted fields are delimited with
+ * an SSE2 scan for the delimiter and end-of-line bytes.
+ *
+ * A column whose non-empty cells all parse as numbers is stored as doubles
+ * (empty cells are NaN). Other columns are dictionary-encoded: each cell is
+ * the index of its text among the distinct values of the column, copied
+ * into one text arena, so the file is unmapped once parsed and a later
+ * truncation of the file cannot fault. The first record holds the column
+ * names.
+ */
+class CsvTable {
+public:
+  struct Column {
+    std::string name;
+    bool numeric = true;
+    std::vector<double> numbers;          ///< Numeric columns: cell values
+    std::vector<uint32_t> codes;          ///< Text columns: index of each cell in values
+    std::vector<std::string_view> values; ///< Text columns: distinct cell texts
+
+    std::string_view text(std::size_t row) const { return values[codes[row]]; }
+  };
+
+private:
+  static constexpr std::size_t kMinChunk = 1 << 20; ///< Smallest per-thread chunk
+
+  /// Cells parsed by one thread; text cells are kept in values until encoded
+  struct Chunk {
+    const char *begin;
+    const char *end;
+    std::vector<Column> columns;
+    std::deque<std::string> unescaped;    ///< Owned text of fields with "" escapes
+    std::size_t rows = 0;
+  };
+
+  std::vector<Column> fColumns;
+  std::unique_ptr<char[]> fText;        ///< Text of the non-numeric cells
+  std::size_t fTextSize = 0;
+  std::size_t fRows = 0;
+
+  // First delimiter, '\n' or '\r' in [p, end), or end
+  static const char *findFieldEnd(const char *p, const char *end, char delimiter) {
+#if defined(__SSE2__)
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i returns = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      unsigned mask = _mm_movemask_epi8(
+          _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, delimiters), _mm_cmpeq_epi8(block, newlines)),
+                       _mm_cmpeq_epi8(block, returns)));
+      if (mask != 0) {
+        return p + __builtin_ctz(mask);
+      }
+      p += 16;
+    }
+#endif
+    while (p < end && *p != delimiter && *p != '\n' && *p != '\r') {
+      ++p;
+    }
+    return p;
+  }
+
+  // Parse one field at p; returns its text and moves p to the byte after it
+  static std::string_view field(const char *&p, const char *end, char delimiter,
+                                std::deque<std::string> &unescaped) {
+    if (p < end && *p == '"') {
+      const char *start = ++p;
+      bool escaped = false;
+      while (true) {
+        const char *quote = static_cast<const char *>(std::memchr(p, '"', end - p));
+        if (quote == nullptr) {
+          p = end; // unterminated: the field runs to the end of the file
+          return std::string_view(start, end - start);
+        }
+        if (quote + 1 < end && quote[1] == '"') {
+          escaped = true;
+          p = quote + 2;
+          continue;
+        }
+        std::string_view text(start, quote - start);
+        p = findFieldEnd(quote + 1, end, delimiter); // ignore anything after the closing quote
+        if (!escaped) {
+          return text;
+        }
+        std::string &owned = unescaped.emplace_back();
+        owned.reserve(text.size());
+        for (std::size_t i = 0; i < text.size(); ++i) {
+          owned.push_back(text[i]);
+          if (text[i] == '"') {
+            ++i;
+          }
+        }
+        return owned;
+      }
+    }
+    const char *start = p;
+    p = findFieldEnd(p, end, delimiter);
+    return std::string_view(start, p - start);
+  }
+
+  // Parse one record; returns false on a blank line
+  static bool record(const char *&p, const char *end, char delimiter,
+                     std::deque<std::string> &unescaped, std::vector<std::string_view> &cells) {
+    cells.clear();
+    while (true) {
+      cells.push_back(field(p, end, delimiter, unescaped));
+      if (p < end && *p == delimiter) {
+        ++p;
+        continue;
+      }
+      while (p < end && (*p == '\r' || *p == '\n')) {
+        bool newline = *p++ == '\n';
+        if (newline) {
+          break;
+        }
+      }
+      return !(cells.size() == 1 && cells[0].empty());
+    }
+  }
+
+  static void parseChunk(Chunk &chunk, char delimiter, std::size_t columnCount) {
+    chunk.columns.resize(columnCount);
+    std::vector<std::string_view> cells;
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+      if (!record(p, chunk.end, delimiter, chunk.unescaped, cells)) {
+        continue;
+      }
+      for (std::size_t c = 0; c < columnCount; ++c) {
+        std::string_view cell = c < cells.size() ? cells[c] : std::string_view();
+        Column &column = chunk.columns[c];
+        double number = std::numeric_limits<double>::quiet_NaN();
+        if (!cell.empty() && column.numeric) {
+          auto [last, error] = std::from_chars(cell.data(), cell.data() + cell.size(), number);
+          if (error != std::errc() || last != cell.data() + cell.size()) {
+            column.numeric = false;
+          }
+        }
+        column.numbers.push_back(number);
+        column.values.push_back(cell);
+      }
+      ++chunk.rows;
+    }
+  }
+
+public:
+  /**
+   * @brief Load and parse a file
+   * @param path CSV file
+   * @param delimiter Field separator
+   * @param threads Maximum number of parsing threads
+   * @throws std::runtime_error if the file cannot be read
+   */
+  CsvTable(const std::string &path, char delimiter, std::size_t threads) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("Not a readable CSV file");
+    }
+    std::size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      throw std::runtime_error("Cannot map CSV file");
+    }
+    std::unique_ptr<void, std::function<void(void *)>> unmap(map, [size](void *p) { munmap(p, size); });
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char *data = static_cast<const char *>(map);
+    const char *end = data + size;
+
+    // Header
+    const char *p = data;
+    std::deque<std::string> headerPool;
+    std::vector<std::string_view> names;
+    while (p < end && !record(p, end, delimiter, headerPool, names)) {
+    }
+    for (std::string_view name : names) {
+      fColumns.emplace_back().name = name;
+    }
+
+    // Chunk boundaries: count quotes per slice in parallel, then move each
+    // boundary to the first record start outside quotes
+    threads = std::clamp<std::size_t>((end - p) / kMinChunk, 1, std::max<std::size_t>(threads, 1));
+    std::vector<const char *> bounds(threads + 1);
+    for (std::size_t i = 0; i <= threads; ++i) {
+      bounds[i] = p + (end - p) * i / threads;
+    }
+    std::vector<std::size_t> quotes(threads);
+    {
+      std::vector<std::thread> pool;
+      for (std::size_t i = 0; i < threads; ++i) {
+        pool.emplace_back([&, i] { quotes[i] = std::count(bounds[i], bounds[i + 1], '"'); });
+      }
+      for (auto &thread : pool) {
+        thread.join();
+      }
+    }
+    std::vector<Chunk> chunks(threads);
+    bool inQuotes = false;
+    const char *start = p;
+    for (std::size_t i = 0; i < threads; ++i) {
+      inQuotes ^= quotes[i] & 1;
+      const char *stop = end;
+      if (i + 1 < threads) {
+        bool quoted = inQuotes;
+        stop = bounds[i + 1];
+        while (stop < end && (quoted || *stop != '\n')) {
+          quoted ^= *stop++ == '"';
+        }
+        stop = std::min(stop + 1, end);
+        stop = std::max(stop, start);
+      }
+      chunks[i].begin = start;
+      chunks[i].end = stop;
+      start = stop;
+    }
+
+    {
+      std::vector<std::thread> pool;
+      for (std::size_t i = 1; i < threads; ++i) {
+        pool.emplace_back([&, i] { parseChunk(chunks[i], delimiter, fColumns.size()); });
+      }
+      parseChunk(chunks[0], delimiter, fColumns.size());
+      for (auto &thread : pool) {
+        thread.join();
+      }
+    }
+
+    // Concatenate the chunks, keeping one representation per column
+    for (const Chunk &chunk : chunks) {
+      fRows += chunk.rows;
+      for (std::size_t c = 0; c < fColumns.size(); ++c) {
+        fColumns[c].numeric = fColumns[c].numeric && chunk.columns[c].numeric;
+      }
+    }
+    std::vector<std::size_t> textColumns;
+    for (std::size_t c = 0; c < fColumns.size(); ++c) {
+      if (fColumns[c].numeric) {
+        Column &column = fColumns[c];
+        column.numbers.reserve(fRows);
+        for (Chunk &chunk : chunks) {
+          std::vector<double> &part = chunk.columns[c].numbers;
+          column.numbers.insert(column.numbers.end(), part.begin(), part.end());
+          chunk.columns[c] = Column();
+        }
+      } else {
+        textColumns.push_back(c);
+      }
+    }
+
+    // Dictionary-encode the text columns, one column per thread
+    std::atomic<std::size_t> next{0};
+    auto encode = [&] {
+      for (std::size_t i; (i = next++) < textColumns.size();) {
+        std::size_t c = textColumns[i];
+        Column &column = fColumns[c];
+        std::unordered_map<std::string_view, uint32_t> dictionary;
+        column.codes.reserve(fRows);
+        for (Chunk &chunk : chunks) {
+          for (std::string_view cell : chunk.columns[c].values) {
+            auto [entry, inserted] = dictionary.try_emplace(cell, uint32_t(column.values.size()));
+            if (inserted) {
+              column.values.push_back(cell);
+            }
+            column.codes.push_back(entry->second);
+          }
+          chunk.columns[c] = Column();
+        }
+      }
+    };
+    {
+      std::vector<std::thread> pool;
+      for (std::size_t i = 1; i < std::min(threads, textColumns.size()); ++i) {
+        pool.emplace_back(encode);
+      }
+      encode();
+      for (auto &thread : pool) {
+        thread.join();
+      }
+    }
+
+    // Copy the distinct texts out of the mapping and the chunk pools
+    for (std::size_t c : textColumns) {
+      for (std::string_view text : fColumns[c].values) {
+        fTextSize += text.size();
+      }
+    }
+    fText = std::make_unique<char[]>(std::max<std::size_t>(fTextSize, 1));
+    char *out = fText.get();
+    for (std::size_t c : textColumns) {
+      for (std::string_view &text : fColumns[c].values) {
+        std::memcpy(out, text.data(), text.size());
+        text = std::string_view(out, text.size());
+        out += text.size();
+      }
+    }
+  }
+
+  CsvTable(const CsvTable &) = delete;
+  CsvTable &operator=(const CsvTable &) = delete;
+
+  std::size_t rows() const { return fRows; }
+  const std::vector<Column> &columns() const { return fColumns; }
+
+  /**
+   * @brief Index of a column by name
+   * @throws std::invalid_argument if there is no such column
+   */
+  std::size_t column(const std::string &name) const {
+    for (std::size_t c = 0; c < fColumns.size(); ++c) {
+      if (fColumns[c].name == name) {
+        return c;
+      }
+    }
+    throw std::invalid_argument("Unknown column: " + name);
+  }
+
+  /// Approximate memory used by the columns
+  std::size_t memoryUsage() const {
+    std::size_t bytes = 0;
+    for (const Column &column : fColumns) {
+      bytes += column.numbers.capacity() * sizeof(double) + column.codes.capacity() * sizeof(uint32_t) +
+               column.values.capacity() * sizeof(std::string_view);
+    }
+    return bytes + fTextSize;
+  }
+};
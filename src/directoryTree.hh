@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "directoryWalker.hh"
+
+// ============================================================================
+// Directory Tree Snapshot
+// ============================================================================
+
+/**
+ * @brief In-memory snapshot of a directory tree with its file attributes
+ *
+ * Entries are fixed-size nodes in one vector, linked to their parent, first
+ * child and next sibling by index; siblings are kept in name order. Names
+ * live in a single string pool, so a tree of a million entries is two
+ * allocations. Freed nodes are reused, and the pool is rewritten when
+ * removed names make up most of it.
+ *
+ * The tree is filled by a parallel walk (build) and patched entry by entry
+ * (refresh), typically from FileWatcher events. It is not synchronized: the
+ * owner serializes updates against reads.
+ */
+class DirectoryTree {
+public:
+  static constexpr uint32_t kNone = UINT32_MAX; ///< No node
+  static constexpr uint32_t kRoot = 0;          ///< Index of the root directory
+
+  /// One entry: 40 bytes
+  struct Node {
+    uint64_t size;           ///< Size in bytes
+    int64_t mtimeNs;         ///< Modification time, in nanoseconds since the epoch
+    uint32_t name;           ///< Offset of the name in the pool
+    uint32_t parent;         ///< Parent directory (kNone for the root)
+    uint32_t firstChild;     ///< First child in name order (kNone if none)
+    uint32_t nextSibling;    ///< Next entry of the parent (kNone if last)
+    uint16_t nameLength;     ///< Name size (NAME_MAX is 255)
+    uint16_t mode;           ///< st_mode: type and permission bits
+    uint8_t type;            ///< DT_REG, DT_DIR, DT_LNK...; DT_UNKNOWN for a free node
+  };
+
+private:
+  static constexpr std::size_t kMinCompaction = 1 << 20; ///< Garbage bytes before the pool is rewritten
+
+  std::string fRoot;          ///< Absolute path of the root
+  std::vector<Node> fNodes;   ///< All nodes, free ones included
+  std::string fNames;         ///< Name pool
+  std::vector<uint32_t> fFree; ///< Free node indexes
+  std::size_t fGarbage = 0;   ///< Pool bytes of removed names
+  std::size_t fEntries = 0;   ///< Live nodes below the root
+
+  /// Attributes read by lstat
+  struct Entry {
+    std::string relative;
+    uint64_t size;
+    int64_t mtimeNs;
+    uint16_t mode;
+  };
+
+  static bool readEntry(const std::string &path, Entry &entry) {
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) {
+      return false;
+    }
+    entry.size = uint64_t(info.st_size);
+    entry.mtimeNs = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    entry.mode = static_cast<uint16_t>(info.st_mode);
+    return true;
+  }
+
+  std::string absolute(const std::string &relative) const {
+    return relative.empty() ? fRoot : fRoot == "/" ? fRoot + relative : fRoot + "/" + relative;
+  }
+
+  // Path of a walked file relative to the root (the root "/" is its own prefix)
+  std::string relativeOf(const std::string &path) const {
+    return path.substr(fRoot == "/" ? 1 : fRoot.size() + 1);
+  }
+
+  void assign(uint32_t index, const Entry &entry) {
+    Node &node = fNodes[index];
+    node.size = entry.size;
+    node.mtimeNs = entry.mtimeNs;
+    node.mode = entry.mode;
+    node.type = static_cast<uint8_t>(IFTODT(entry.mode));
+  }
+
+  uint32_t allocate(std::string_view name, uint32_t parent) {
+    uint32_t index;
+    if (!fFree.empty()) {
+      index = fFree.back();
+      fFree.pop_back();
+    } else {
+      index = static_cast<uint32_t>(fNodes.size());
+      fNodes.emplace_back();
+    }
+    Node &node = fNodes[index];
+    node.name = static_cast<uint32_t>(fNames.size());
+    node.nameLength = static_cast<uint16_t>(name.size());
+    node.parent = parent;
+    node.firstChild = kNone;
+    node.nextSibling = kNone;
+    fNames.append(name);
+    ++fEntries;
+    return index;
+  }
+
+  // Child of 'parent' called 'name', or kNone; 'previous' receives the
+  // sibling after which such a child would be inserted
+  uint32_t findChild(uint32_t parent, std::string_view name, uint32_t *previous = nullptr) const {
+    uint32_t before = kNone;
+    for (uint32_t child = fNodes[parent].firstChild; child != kNone; child = fNodes[child].nextSibling) {
+      int order = this->name(child).compare(name);
+      if (order == 0) {
+        return child;
+      }
+      if (order > 0) {
+        break;
+      }
+      before = child;
+    }
+    if (previous) {
+      *previous = before;
+    }
+    return kNone;
+  }
+
+  uint32_t insertChild(uint32_t parent, std::string_view name, const Entry &entry) {
+    uint32_t previous = kNone;
+    uint32_t child = findChild(parent, name, &previous);
+    if (child == kNone) {
+      child = allocate(name, parent);
+      uint32_t &link = previous == kNone ? fNodes[parent].firstChild : fNodes[previous].nextSibling;
+      fNodes[child].nextSibling = link;
+      link = child;
+    }
+    assign(child, entry);
+    return child;
+  }
+
+  void removeChildren(uint32_t index) {
+    std::vector<uint32_t> stack;
+    for (uint32_t child = fNodes[index].firstChild; child != kNone; child = fNodes[child].nextSibling) {
+      stack.push_back(child);
+    }
+    fNodes[index].firstChild = kNone;
+    while (!stack.empty()) {
+      uint32_t node = stack.back();
+      stack.pop_back();
+      for (uint32_t child = fNodes[node].firstChild; child != kNone; child = fNodes[child].nextSibling) {
+        stack.push_back(child);
+      }
+      fGarbage += fNodes[node].nameLength;
+      fNodes[node].type = DT_UNKNOWN;
+      fFree.push_back(node);
+      --fEntries;
+    }
+  }
+
+  void remove(uint32_t index) {
+    uint32_t parent = fNodes[index].parent;
+    uint32_t *link = &fNodes[parent].firstChild;
+    while (*link != index) {
+      link = &fNodes[*link].nextSibling;
+    }
+    *link = fNodes[index].nextSibling;
+    removeChildren(index);
+    fGarbage += fNodes[index].nameLength;
+    fNodes[index].type = DT_UNKNOWN;
+    fFree.push_back(index);
+    --fEntries;
+  }
+
+  void compactNames() {
+    std::string names;
+    names.reserve(fNames.size() - fGarbage);
+    for (Node &node : fNodes) {
+      if (node.type != DT_UNKNOWN) {
+        uint32_t offset = static_cast<uint32_t>(names.size());
+        names.append(fNames, node.name, node.nameLength);
+        node.name = offset;
+      }
+    }
+    fNames.swap(names);
+    fGarbage = 0;
+  }
+
+  // Add every entry below the directory 'index' (at 'relative'), with one walker thread
+  void addSubtree(uint32_t index, const std::string &relative) {
+    std::vector<Entry> entries;
+    DirectoryWalker walker;
+    walker.walk(absolute(relative), [&](const std::string &path, unsigned char) {
+      Entry entry;
+      if (readEntry(path, entry)) {
+        entry.relative = relativeOf(path);
+        entries.push_back(std::move(entry));
+      }
+      return true;
+    }, 1);
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.relative < b.relative; });
+    for (const Entry &entry : entries) {
+      refreshEntry(entry, index, relative.size());
+    }
+  }
+
+  // Insert or update an entry whose directories below 'base' (at 'baseLength'
+  // characters into its relative path) exist or are created on the way
+  void refreshEntry(const Entry &entry, uint32_t base, std::size_t baseLength) {
+    std::string_view path = entry.relative;
+    std::size_t start = baseLength == 0 ? 0 : baseLength + 1;
+    uint32_t parent = base;
+    for (std::size_t slash; (slash = path.find('/', start)) != std::string_view::npos; start = slash + 1) {
+      std::string_view name = path.substr(start, slash - start);
+      uint32_t child = findChild(parent, name);
+      if (child == kNone || fNodes[child].type != DT_DIR) {
+        Entry dir;
+        if (!readEntry(absolute(std::string(path.substr(0, slash))), dir)) {
+          return;
+        }
+        child = insertChild(parent, name, dir);
+      }
+      parent = child;
+    }
+    uint32_t node = insertChild(parent, path.substr(start), entry);
+    if (fNodes[node].type != DT_DIR) {
+      removeChildren(node);
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor; the tree holds the root alone until build() is called
+   * @param root Absolute path of the root directory
+   */
+  explicit DirectoryTree(const std::string &root) : fRoot(root) {
+    Entry entry{};
+    readEntry(root, entry);
+    fNodes.emplace_back();
+    fNodes[kRoot] = {0, 0, 0, kNone, kNone, kNone, 0, 0, DT_DIR};
+    assign(kRoot, entry);
+    fNodes[kRoot].type = DT_DIR;
+  }
+
+  /**
+   * @brief Fill the tree with a parallel walk of the root
+   * @param cancelled Condition polled to abandon the walk early
+   */
+  void build(std::function<bool()> cancelled = nullptr) {
+    std::mutex entriesMutex;
+    std::map<std::thread::id, std::vector<Entry>> perThread;
+    DirectoryWalker walker(std::move(cancelled));
+    walker.walk(fRoot, [&](const std::string &path, unsigned char) {
+      Entry entry;
+      if (!readEntry(path, entry)) {
+        return true;
+      }
+      entry.relative = relativeOf(path);
+      std::vector<Entry> *entries;
+      {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        entries = &perThread[std::this_thread::get_id()];
+      }
+      entries->push_back(std::move(entry));
+      return true;
+    });
+
+    std::vector<Entry> entries;
+    for (auto &[thread, list] : perThread) {
+      std::move(list.begin(), list.end(), std::back_inserter(entries));
+      list = std::vector<Entry>();
+    }
+    // A directory sorts before its content, and siblings in name order
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.relative < b.relative; });
+
+    fNodes.resize(1);
+    fNodes[kRoot].firstChild = kNone;
+    fFree.clear();
+    fNames.clear();
+    fGarbage = 0;
+    fEntries = 0;
+    fNodes.reserve(entries.size() + 1);
+    std::unordered_map<std::string_view, uint32_t> dirs;
+    std::vector<uint32_t> lastChild(entries.size() + 1, kNone);
+    for (const Entry &entry : entries) {
+      std::string_view path = entry.relative;
+      std::size_t slash = path.rfind('/');
+      uint32_t parent = kRoot;
+      if (slash != std::string_view::npos) {
+        auto dir = dirs.find(path.substr(0, slash));
+        if (dir == dirs.end()) {
+          continue; // parent vanished between readdir and lstat
+        }
+        parent = dir->second;
+      }
+      uint32_t index = allocate(slash == std::string_view::npos ? path : path.substr(slash + 1), parent);
+      assign(index, entry);
+      uint32_t &link = lastChild[parent] == kNone ? fNodes[parent].firstChild : fNodes[lastChild[parent]].nextSibling;
+      link = index;
+      lastChild[parent] = index;
+      if (fNodes[index].type == DT_DIR) {
+        dirs.emplace(path, index);
+      }
+    }
+  }
+
+  /**
+   * @brief Bring one entry up to date with the file system
+   *
+   * The entry is added or updated if it exists (with the directories
+   * leading to it), and removed with its content otherwise.
+   * @param relative Path relative to the root
+   * @param recursive Also re-read the content of a directory
+   */
+  void refresh(const std::string &relative, bool recursive) {
+    Entry entry;
+    if (relative.empty() || relative == ".") {
+      if (readEntry(fRoot, entry)) {
+        assign(kRoot, entry);
+        fNodes[kRoot].type = DT_DIR;
+      }
+      return;
+    }
+    if (!readEntry(absolute(relative), entry)) {
+      uint32_t index = find(relative);
+      if (index != kNone) {
+        remove(index);
+      }
+    } else {
+      entry.relative = relative;
+      refreshEntry(entry, kRoot, 0);
+      if (recursive && S_ISDIR(entry.mode)) {
+        // Not inserted if a directory leading to it vanished meanwhile
+        uint32_t index = find(relative);
+        if (index != kNone) {
+          removeChildren(index);
+          addSubtree(index, relative);
+        }
+      }
+    }
+    // The parent directory changed with its content
+    std::size_t slash = relative.rfind('/');
+    uint32_t parent = slash == std::string::npos ? kRoot : find(std::string_view(relative).substr(0, slash));
+    if (parent != kNone && readEntry(absolute(slash == std::string::npos ? "" : relative.substr(0, slash)), entry)) {
+      assign(parent, entry);
+    }
+    if (fGarbage > kMinCompaction && fGarbage > fNames.size() / 2) {
+      compactNames();
+    }
+  }
+
+  /**
+   * @brief Node at a path
+   * @param relative Path relative to the root ("" or "." for the root)
+   * @return Node index, or kNone
+   */
+  uint32_t find(std::string_view relative) const {
+    uint32_t index = kRoot;
+    std::size_t start = 0;
+    while (index != kNone && start < relative.size()) {
+      std::size_t slash = relative.find('/', start);
+      std::size_t end = slash == std::string_view::npos ? relative.size() : slash;
+      std::string_view name = relative.substr(start, end - start);
+      if (!name.empty() && name != ".") {
+        index = findChild(index, name);
+      }
+      start = end + 1;
+    }
+    return index;
+  }
+
+  const Node &node(uint32_t index) const { return fNodes[index]; }
+
+  std::string_view name(uint32_t index) const {
+    return std::string_view(fNames).substr(fNodes[index].name, fNodes[index].nameLength);
+  }
+
+  /// Number of entries below the root
+  std::size_t entries() const { return fEntries; }
+
+  /// Bytes used by the nodes and the name pool
+  std::size_t memoryUsage() const {
+    return fNodes.capacity() * sizeof(Node) + fNames.capacity() + fFree.capacity() * sizeof(uint32_t);
+  }
+};
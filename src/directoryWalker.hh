@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ============================================================================
+// Parallel Directory Walker
+// ============================================================================
+
+/**
+ * @brief Walks a directory tree with several threads using getdents64
+ *
+ * Directories are read in large batches with the raw getdents64 system
+ * call, which returns the entry types without a stat per file. Directories
+ * found are pushed to a shared queue served by all threads; symbolic links
+ * are not followed. The visitor runs on the walker threads, so per-file
+ * work (searching, hashing...) is parallelized along with the walk.
+ */
+class DirectoryWalker {
+public:
+  /**
+   * @brief Called for every entry found; returns false to stop the walk
+   * @param path Absolute path of the entry
+   * @param type Entry type (DT_REG, DT_DIR, DT_LNK...)
+   */
+  using Visitor = std::function<bool(const std::string &path, unsigned char type)>;
+
+private:
+  /// Layout of the records returned by getdents64
+  struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+
+  std::mutex fMutex;                    ///< Protects fQueue and fBusy
+  std::condition_variable fChanged;     ///< Signals queue or busy changes
+  std::vector<std::string> fQueue;      ///< Directories left to read
+  std::size_t fBusy = 0;                ///< Threads reading a directory
+  std::atomic<bool> fStop{false};       ///< Set when the visitor stops the walk
+  std::function<bool()> fCancelled;     ///< External stop condition (may be empty)
+
+  bool stopped() const { return fStop || (fCancelled && fCancelled()); }
+
+  void readDirectory(const std::string &dir, const Visitor &visit,
+                     std::vector<char> &buffer) {
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    std::vector<std::string> subdirs;
+    long count;
+    while (!stopped() &&
+           (count = syscall(SYS_getdents64, fd, buffer.data(), buffer.size())) > 0) {
+      for (long offset = 0; offset < count;) {
+        auto *entry = reinterpret_cast<LinuxDirent64 *>(buffer.data() + offset);
+        offset += entry->d_reclen;
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+          continue;
+        }
+        std::string path = dir == "/" ? dir + name : dir + "/" + name;
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+          struct stat st;
+          if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+          }
+          type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (!visit(path, type)) {
+          fStop = true;
+          break;
+        }
+        if (type == DT_DIR) {
+          subdirs.push_back(std::move(path));
+        }
+      }
+    }
+    close(fd);
+
+    if (!subdirs.empty()) {
+      std::lock_guard<std::mutex> lock(fMutex);
+      for (auto &subdir : subdirs) {
+        fQueue.push_back(std::move(subdir));
+      }
+      fChanged.notify_all();
+    }
+  }
+
+  void worker(const Visitor &visit) {
+    std::vector<char> buffer(kBufferSize);
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (true) {
+      fChanged.wait(lock, [this] { return !fQueue.empty() || fBusy == 0 || stopped(); });
+      if (fQueue.empty() || stopped()) {
+        // Nothing queued and nobody left to produce work: done
+        fChanged.notify_all();
+        return;
+      }
+      std::string dir = std::move(fQueue.back());
+      fQueue.pop_back();
+      ++fBusy;
+      lock.unlock();
+      readDirectory(dir, visit, buffer);
+      lock.lock();
+      --fBusy;
+      if (fBusy == 0) {
+        fChanged.notify_all();
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param cancelled Optional condition polled to abandon the walk early
+   */
+  explicit DirectoryWalker(std::function<bool()> cancelled = nullptr)
+      : fCancelled(std::move(cancelled)) {}
+
+  /**
+   * @brief Number of threads used when the caller does not choose
+   */
+  static std::size_t defaultThreads() {
+    return std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, 8);
+  }
+
+  /**
+   * @brief Walk the tree below a directory (the directory itself is not visited)
+   * @param root Absolute path of the directory
+   * @param visit Visitor called concurrently from the walker threads
+   * @param threads Number of walker threads
+   */
+  void walk(const std::string &root, const Visitor &visit,
+            std::size_t threads = defaultThreads()) {
+    fQueue.assign(1, root);
+    fBusy = 0;
+    fStop = false;
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) {
+      pool.emplace_back([this, &visit] { worker(visit); });
+    }
+    worker(visit);
+    for (auto &thread : pool) {
+      thread.join();
+    }
+  }
+};
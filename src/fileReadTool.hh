@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool reading a byte or line range of a file
+ *
+ * Files are only read with pread() around the requested range. For line
+ * ranges, a sparse index records the offset of every kLineStride-th line;
+ * it is built lazily, only as far into the file as requests have gone, and
+ * kept in a small LRU keyed by device, inode, size and modification time, so
+ * a changed file gets a fresh index.
+ */
+class FileReadTool : public McpTool {
+private:
+  static constexpr std::size_t kLineStride = 256;       ///< Lines between index entries
+  static constexpr std::size_t kChunkSize = 64 * 1024;  ///< pread() size
+  static constexpr std::size_t kDefaultMaxBytes = 256 * 1024;
+  static constexpr std::size_t kMaxMaxBytes = 16 << 20; ///< Largest maxBytes honored
+  static constexpr std::size_t kIndexCacheSize = 64;    ///< Files with a cached index
+
+  /// Identity of one version of a file
+  struct FileKey {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    int64_t mtimeNs;
+
+    bool operator==(const FileKey &other) const {
+      return dev == other.dev && ino == other.ino && size == other.size &&
+             mtimeNs == other.mtimeNs;
+    }
+  };
+
+  struct FileKeyHash {
+    std::size_t operator()(const FileKey &key) const {
+      return std::hash<uint64_t>()(key.ino * 31 + key.dev) ^ std::hash<int64_t>()(key.mtimeNs);
+    }
+  };
+
+  /// Sparse line index: checkpoints[i] is the offset of line i * kLineStride + 1
+  struct LineIndex {
+    std::mutex mutex;                  ///< Serializes extension
+    std::vector<off_t> checkpoints{0}; ///< Known checkpoint offsets
+    off_t scanned = 0;                 ///< Bytes scanned so far
+    std::size_t linesScanned = 0;      ///< Newlines seen in [0, scanned)
+    bool complete = false;             ///< Whole file scanned
+  };
+
+  SandboxRoot fRoot;                 ///< Directory readable by the tool
+  std::mutex fCacheMutex;            ///< Protects the LRU
+  std::list<FileKey> fLru;           ///< Most recently used first
+  std::unordered_map<FileKey, std::pair<std::shared_ptr<LineIndex>, std::list<FileKey>::iterator>,
+                     FileKeyHash>
+      fIndexes;                      ///< Cached indexes
+
+  std::shared_ptr<LineIndex> indexFor(const FileKey &key) {
+    std::lock_guard<std::mutex> lock(fCacheMutex);
+    auto entry = fIndexes.find(key);
+    if (entry != fIndexes.end()) {
+      fLru.splice(fLru.begin(), fLru, entry->second.second);
+      return entry->second.first;
+    }
+    if (fIndexes.size() >= kIndexCacheSize) {
+      fIndexes.erase(fLru.back());
+      fLru.pop_back();
+    }
+    fLru.push_front(key);
+    auto index = std::make_shared<LineIndex>();
+    fIndexes.emplace(key, std::make_pair(index, fLru.begin()));
+    return index;
+  }
+
+  // Extend the index until it covers the checkpoint at or before 'line'
+  static void extendIndex(int fd, off_t size, LineIndex &index, std::size_t line) {
+    std::size_t wanted = (line - 1) / kLineStride;
+    std::vector<char> buffer(kChunkSize);
+    while (!index.complete && index.checkpoints.size() <= wanted) {
+      ssize_t count = pread(fd, buffer.data(), buffer.size(), index.scanned);
+      if (count <= 0) {
+        index.complete = true;
+        break;
+      }
+      const char *p = buffer.data();
+      const char *end = p + count;
+      while ((p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr) {
+        ++p;
+        if (++index.linesScanned % kLineStride == 0) {
+          index.checkpoints.push_back(index.scanned + (p - buffer.data()));
+        }
+      }
+      index.scanned += count;
+      index.complete = index.scanned >= size;
+    }
+  }
+
+  // Read [offset, offset + length) with pread
+  static std::string readRange(int fd, off_t offset, std::size_t length) {
+    std::string data(length, '\0');
+    std::size_t done = 0;
+    while (done < length) {
+      ssize_t count = pread(fd, &data[done], length - done, offset + done);
+      if (count <= 0) {
+        break;
+      }
+      done += count;
+    }
+    data.resize(done);
+    return data;
+  }
+
+  // Offset of the start of line 'target', scanning forward from a known line
+  // start, but not past 'limit'
+  static off_t seekLine(int fd, off_t limit, off_t offset, std::size_t line, std::size_t target) {
+    std::vector<char> buffer(kChunkSize);
+    while (line < target && offset < limit) {
+      ssize_t count = pread(fd, buffer.data(), buffer.size(), offset);
+      if (count <= 0) {
+        return limit;
+      }
+      const char *p = buffer.data();
+      const char *end = p + count;
+      while (line < target &&
+             (p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr) {
+        ++p;
+        ++line;
+      }
+      offset += (line < target ? count : p - buffer.data());
+    }
+    return std::min(offset, limit);
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param root Directory the tool is allowed to read
+   */
+  explicit FileReadTool(const std::string &root) : fRoot(root) {}
+
+  std::string name() const override { return "FileReadTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Read part of a file, by byte range or by line range"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"path", {{"type", "string"}, {"description", "File path, relative to the tool root"}}},
+            {"startLine", {{"type", "integer"}, {"description", "First line to read (1-based)"}}},
+            {"endLine", {{"type", "integer"}, {"description", "Last line to read, inclusive (default: startLine)"}}},
+            {"offset", {{"type", "integer"}, {"description", "First byte to read, when no line range is given (default: 0)"}}},
+            {"length", {{"type", "integer"}, {"description", "Number of bytes to read (default and maximum: maxBytes)"}}},
+            {"maxBytes", {{"type", "integer"}, {"description", "Upper bound on the returned bytes (default: 262144, at most 16777216)"}}}}},
+          {"required", json::array({"path"})}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    std::string relative = arguments.value("path", "");
+    std::string path = fRoot.resolve(relative);
+    int64_t requested = arguments.value("maxBytes", int64_t(kDefaultMaxBytes));
+    if (requested < 1) {
+      throw std::invalid_argument("maxBytes must be positive");
+    }
+    std::size_t maxBytes = std::min<uint64_t>(requested, kMaxMaxBytes);
+    int64_t length = arguments.value("length", int64_t(maxBytes));
+    if (length < 0) {
+      throw std::invalid_argument("length must not be negative");
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::invalid_argument("Cannot open file: " + relative);
+    }
+    std::unique_ptr<int, void (*)(int *)> closer(&fd, [](int *f) { close(*f); });
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      throw std::invalid_argument("Not a regular file: " + relative);
+    }
+    off_t size = st.st_size;
+
+    off_t begin;
+    off_t end;
+    std::string range;
+    if (arguments.contains("startLine")) {
+      std::size_t first = std::max<int64_t>(1, arguments.value("startLine", int64_t(1)));
+      std::size_t last = std::max<int64_t>(first, arguments.value("endLine", int64_t(first)));
+
+      FileKey key{st.st_dev, st.st_ino, size,
+                  int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+      std::shared_ptr<LineIndex> index = indexFor(key);
+      std::size_t checkpoint;
+      off_t checkpointOffset;
+      {
+        std::lock_guard<std::mutex> lock(index->mutex);
+        extendIndex(fd, size, *index, first);
+        checkpoint = std::min((first - 1) / kLineStride, index->checkpoints.size() - 1);
+        checkpointOffset = index->checkpoints[checkpoint];
+      }
+      begin = seekLine(fd, size, checkpointOffset, checkpoint * kLineStride + 1, first);
+      // Scan at most one byte past maxBytes: enough to detect truncation
+      off_t limit = std::min<off_t>(size, begin + maxBytes + 1);
+      end = seekLine(fd, limit, begin, first, last + 1);
+      range = "lines " + std::to_string(first) + "-" + std::to_string(last) + ", ";
+    } else {
+      begin = std::clamp<off_t>(arguments.value("offset", int64_t(0)), 0, size);
+      end = begin + std::min<off_t>(length, size - begin);
+    }
+
+    bool truncated = static_cast<std::size_t>(end - begin) > maxBytes;
+    std::string text = readRange(fd, begin, truncated ? maxBytes : end - begin);
+
+    json content = json::array({textItem(text)});
+    content.push_back(textItem("[" + relative + ": " + range + "bytes " +
+                               std::to_string(begin) + "-" +
+                               std::to_string(begin + off_t(text.size())) + " of " +
+                               std::to_string(size) +
+                               (truncated ? ", truncated to maxBytes" : "") + "]"));
+    return content;
+  }
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "directoryWalker.hh"
+
+// ============================================================================
+// File Watcher
+// ============================================================================
+
+/**
+ * @brief Watches a directory tree with inotify and reports file changes
+ *
+ * Every directory of the tree gets its own watch; directories created or
+ * moved into the tree later are reported as added and watched as they
+ * appear, and the files they already contain are reported as changed. Callbacks run on the watcher
+ * thread, one at a time. Directories beyond the inotify watch limit
+ * (fs.inotify.max_user_watches) are silently left unwatched.
+ */
+class FileWatcher {
+public:
+  enum class Event {
+    Changed,  ///< A file was written or moved into the tree
+    Added,    ///< A directory was created or moved into the tree
+    Removed,  ///< A file or a directory (with its content) left the tree
+    Overflow  ///< Events were lost: the whole tree must be rescanned
+  };
+
+  /**
+   * @brief Called for every change
+   * @param path Absolute path of the file or directory
+   * @param event What happened
+   */
+  using Callback = std::function<void(const std::string &path, Event event)>;
+
+private:
+  static constexpr uint32_t kMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                    IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+  std::string fRoot;                          ///< Watched directory
+  Callback fCallback;                         ///< Change handler
+  int fInotify = -1;                          ///< inotify descriptor
+  int fWakeup = -1;                           ///< eventfd used to stop the thread
+  std::unordered_map<int, std::string> fDirs; ///< Watch descriptor -> directory
+  std::thread fThread;                        ///< Event loop
+
+  void watchTree(const std::string &dir, bool reportFiles) {
+    int wd = inotify_add_watch(fInotify, dir.c_str(), kMask);
+    if (wd < 0) {
+      return;
+    }
+    fDirs[wd] = dir;
+    DirectoryWalker walker;
+    walker.walk(dir, [&](const std::string &path, unsigned char type) {
+      if (type == DT_DIR) {
+        int sub = inotify_add_watch(fInotify, path.c_str(), kMask);
+        if (sub >= 0) {
+          fDirs[sub] = path; // an existing watch (moved directory) gets its new path
+        }
+      } else if (type == DT_REG && reportFiles) {
+        fCallback(path, Event::Changed);
+      }
+      return true;
+    }, 1);
+  }
+
+  void unwatchTree(const std::string &dir) {
+    std::string prefix = dir + "/";
+    for (auto entry = fDirs.begin(); entry != fDirs.end();) {
+      if (entry->second == dir || entry->second.compare(0, prefix.size(), prefix) == 0) {
+        inotify_rm_watch(fInotify, entry->first);
+        entry = fDirs.erase(entry);
+      } else {
+        ++entry;
+      }
+    }
+  }
+
+  void handle(const struct inotify_event &event) {
+    if (event.mask & IN_Q_OVERFLOW) {
+      fCallback(fRoot, Event::Overflow);
+      return;
+    }
+    auto dir = fDirs.find(event.wd);
+    if (dir == fDirs.end()) {
+      return;
+    }
+    if (event.mask & IN_IGNORED) {
+      fDirs.erase(dir);
+      return;
+    }
+    if (event.len == 0) {
+      return;
+    }
+    std::string path = dir->second + "/" + event.name;
+    if (event.mask & IN_ISDIR) {
+      if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+        fCallback(path, Event::Added);
+        watchTree(path, true);
+      } else if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+        unwatchTree(path);
+        fCallback(path, Event::Removed);
+      }
+    } else if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+      fCallback(path, Event::Changed);
+    } else if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+      fCallback(path, Event::Removed);
+    }
+  }
+
+  void eventLoop() {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    struct pollfd fds[2] = {{fInotify, POLLIN, 0}, {fWakeup, POLLIN, 0}};
+    while (true) {
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+      if (fds[1].revents != 0) {
+        return;
+      }
+      ssize_t count = read(fInotify, buffer, sizeof(buffer));
+      for (ssize_t offset = 0; offset < count;) {
+        auto *event = reinterpret_cast<struct inotify_event *>(buffer + offset);
+        offset += sizeof(struct inotify_event) + event->len;
+        handle(*event);
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Start watching; the watches are in place when the constructor returns
+   * @param root Directory to watch
+   * @param callback Change handler, called on the watcher thread
+   * @throws std::runtime_error if inotify is not available
+   */
+  FileWatcher(const std::string &root, Callback callback)
+      : fRoot(root), fCallback(std::move(callback)) {
+    fInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    fWakeup = eventfd(0, EFD_CLOEXEC);
+    if (fInotify < 0 || fWakeup < 0) {
+      if (fInotify >= 0) {
+        close(fInotify);
+      }
+      if (fWakeup >= 0) {
+        close(fWakeup);
+      }
+      throw std::runtime_error("Cannot watch directory: " + root);
+    }
+    watchTree(fRoot, false);
+    fThread = std::thread([this] { eventLoop(); });
+  }
+
+  ~FileWatcher() {
+    uint64_t one = 1;
+    if (write(fWakeup, &one, sizeof(one)) == sizeof(one)) {
+      fThread.join();
+    } else {
+      fThread.detach();
+    }
+    close(fInotify);
+    close(fWakeup);
+  }
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+};
@@ -0,0 +1,719 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ============================================================================
+// Full-Text Index
+// ============================================================================
+
+/**
+ * @brief In-memory inverted index over text files, ranked with BM25
+ *
+ * Each term maps to a posting list of (document, term frequency) pairs,
+ * stored as varint-encoded document deltas. Documents are only ever
+ * appended: a changed file becomes a new document and its previous version
+ * is marked dead, so posting lists stay sorted and are extended in place.
+ * Dead documents are dropped by compact().
+ *
+ * Documents are indexed in Batches, typically one per builder thread, with
+ * batch-local document numbers; merge() appends a whole batch by rewriting
+ * the first delta of each list and copying the rest verbatim.
+ *
+ * The index can be saved to a snapshot file and loaded back; posting lists
+ * of a loaded snapshot stay in the memory-mapped file.
+ *
+ * Thread safety: queries take a shared lock, updates an exclusive one.
+ */
+class FullTextIndex {
+public:
+  /// An indexed file
+  struct Document {
+    std::string path;    ///< Path relative to the indexed root
+    uint32_t length;     ///< Number of tokens
+    int64_t mtimeNs;     ///< Modification time when indexed
+    uint64_t size;       ///< Size when indexed
+    bool alive;          ///< false once replaced or removed
+  };
+
+  /// A ranked query answer
+  struct Result {
+    std::vector<std::pair<std::string, double>> hits; ///< Path and score, best first
+    std::size_t matches = 0;                          ///< Documents containing every term
+  };
+
+private:
+  static constexpr std::size_t kMinTokenLength = 2;
+  static constexpr std::size_t kMaxTokenLength = 64;
+  static constexpr uint64_t kMaxFileSize = 16 * 1024 * 1024; ///< Larger files are not indexed
+  static constexpr std::size_t kBinaryProbe = 8192;          ///< Bytes checked for NUL
+  static constexpr char kSnapshotMagic[8] = {'M', 'C', 'P', 'F', 'T', 'S', '0', '1'};
+  static constexpr double kK1 = 1.2; ///< BM25 term frequency saturation
+  static constexpr double kB = 0.75; ///< BM25 length normalization
+
+  /// Varint-delta encoded (document, frequency) pairs
+  struct PostingList {
+    std::string_view frozen;   ///< Postings inside the mapped snapshot
+    std::vector<uint8_t> tail; ///< Postings added in memory, continuing frozen
+    uint32_t lastDoc = 0;      ///< Last document of the list
+    uint32_t count = 0;        ///< Number of postings
+
+    void append(uint32_t doc, uint32_t frequency) {
+      putVarint(tail, count == 0 ? doc : doc - lastDoc);
+      putVarint(tail, frequency);
+      lastDoc = doc;
+      ++count;
+    }
+  };
+
+  mutable std::shared_mutex fMutex;
+  std::vector<Document> fDocuments;                      ///< Indexed by document number
+  std::map<std::string, uint32_t> fByPath;               ///< Live documents, sorted by path
+  std::unordered_map<std::string, PostingList> fTerms;   ///< Term dictionary
+  uint64_t fTotalLength = 0;                             ///< Tokens in live documents
+  std::size_t fDead = 0;                                 ///< Dead documents
+  std::atomic<bool> fDirty{false};                       ///< Changed since load/save
+  void *fMapping = nullptr;                              ///< Mapped snapshot
+  std::size_t fMappingSize = 0;
+
+  static void putVarint(std::vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+      out.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+  }
+
+  static uint32_t getVarint(const uint8_t *&p, const uint8_t *end) {
+    uint32_t value = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+      uint8_t byte = *p++;
+      value |= uint32_t(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        break;
+      }
+    }
+    return value;
+  }
+
+  static void decode(const PostingList &list, std::vector<uint32_t> &docs,
+                     std::vector<uint32_t> &frequencies) {
+    docs.clear();
+    frequencies.clear();
+    docs.reserve(list.count);
+    frequencies.reserve(list.count);
+    uint32_t doc = 0;
+    auto run = [&](const uint8_t *p, const uint8_t *end) {
+      while (p < end) {
+        doc += getVarint(p, end);
+        docs.push_back(doc);
+        frequencies.push_back(getVarint(p, end));
+      }
+    };
+    run(reinterpret_cast<const uint8_t *>(list.frozen.data()),
+        reinterpret_cast<const uint8_t *>(list.frozen.data() + list.frozen.size()));
+    run(list.tail.data(), list.tail.data() + list.tail.size());
+  }
+
+  // Elements of the small sorted list also present in the large one. Blocks
+  // of eight are skipped by galloping on their last element, then the
+  // candidate block is compared at once with SSE2.
+  static void intersect(const std::vector<uint32_t> &small, const std::vector<uint32_t> &large,
+                        std::vector<uint32_t> &out) {
+    out.clear();
+    const std::size_t n = large.size();
+    std::size_t j = 0;
+    for (uint32_t x : small) {
+      std::size_t step = 1;
+      while (j + step * 8 + 7 < n && large[j + step * 8 + 7] < x) {
+        j += step * 8;
+        step *= 2;
+      }
+      for (step /= 2; step > 0; step /= 2) {
+        if (j + step * 8 + 7 < n && large[j + step * 8 + 7] < x) {
+          j += step * 8;
+        }
+      }
+      while (j + 8 <= n && large[j + 7] < x) {
+        j += 8;
+      }
+      if (j + 8 <= n) {
+#if defined(__SSE2__)
+        __m128i key = _mm_set1_epi32(static_cast<int>(x));
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&large[j]));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&large[j + 4]));
+        __m128i equal = _mm_or_si128(_mm_cmpeq_epi32(low, key), _mm_cmpeq_epi32(high, key));
+        if (_mm_movemask_epi8(equal) != 0) {
+          out.push_back(x);
+        }
+#else
+        if (std::binary_search(&large[j], &large[j + 8], x)) {
+          out.push_back(x);
+        }
+#endif
+      } else {
+        while (j < n && large[j] < x) {
+          ++j;
+        }
+        if (j == n) {
+          break;
+        }
+        if (large[j] == x) {
+          out.push_back(x);
+        }
+      }
+    }
+  }
+
+  void retire(uint32_t doc) {
+    Document &document = fDocuments[doc];
+    document.alive = false;
+    fTotalLength -= document.length;
+    ++fDead;
+  }
+
+  void unmapSnapshot() {
+    if (fMapping != nullptr) {
+      munmap(fMapping, fMappingSize);
+      fMapping = nullptr;
+      fMappingSize = 0;
+    }
+  }
+
+public:
+  /**
+   * @brief Split text into lowercase terms and count them
+   * @param text Text to tokenize
+   * @param size Length of the text
+   * @param counts Receives term -> frequency (not cleared)
+   * @return Number of tokens
+   *
+   * Terms are runs of ASCII letters, digits, '_' and non-ASCII bytes, so
+   * UTF-8 words are kept whole; ASCII letters are lowercased.
+   */
+  static uint32_t tokenize(const char *text, std::size_t size,
+                           std::unordered_map<std::string, uint32_t> &counts) {
+    uint32_t tokens = 0;
+    std::string term;
+    for (std::size_t i = 0; i <= size; ++i) {
+      unsigned char c = i < size ? static_cast<unsigned char>(text[i]) : ' ';
+      if (std::isalnum(c) || c == '_' || c >= 0x80) {
+        if (term.size() <= kMaxTokenLength) {
+          term.push_back(static_cast<char>(std::tolower(c)));
+        }
+      } else if (!term.empty()) {
+        if (term.size() >= kMinTokenLength && term.size() <= kMaxTokenLength) {
+          ++counts[term];
+          ++tokens;
+        }
+        term.clear();
+      }
+    }
+    return tokens;
+  }
+
+  /**
+   * @brief Documents indexed together, with batch-local document numbers
+   */
+  class Batch {
+    friend class FullTextIndex;
+
+    std::vector<Document> fDocuments;
+    std::unordered_map<std::string, PostingList> fTerms;
+    std::unordered_map<std::string, uint32_t> fCounts; ///< Scratch, reused per file
+
+  public:
+    /**
+     * @brief Read and tokenize a file
+     * @param absolute Path to open
+     * @param relative Path recorded in the index
+     * @return false if the file is unreadable, empty, binary or too large
+     */
+    bool addFile(const std::string &absolute, const std::string &relative) {
+      int fd = open(absolute.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return false;
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+          uint64_t(st.st_size) > kMaxFileSize) {
+        close(fd);
+        return false;
+      }
+      std::size_t size = st.st_size;
+      void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED) {
+        return false;
+      }
+      madvise(map, size, MADV_SEQUENTIAL);
+      const char *data = static_cast<const char *>(map);
+      bool text = std::memchr(data, 0, std::min(size, kBinaryProbe)) == nullptr;
+      if (text) {
+        fCounts.clear();
+        uint32_t length = tokenize(data, size, fCounts);
+        uint32_t doc = fDocuments.size();
+        for (const auto &[term, frequency] : fCounts) {
+          fTerms[term].append(doc, frequency);
+        }
+        fDocuments.push_back({relative, length,
+                              int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+                              uint64_t(st.st_size), true});
+      }
+      munmap(map, size);
+      return text;
+    }
+
+    std::size_t size() const { return fDocuments.size(); }
+  };
+
+  FullTextIndex() = default;
+  ~FullTextIndex() { unmapSnapshot(); }
+
+  FullTextIndex(const FullTextIndex &) = delete;
+  FullTextIndex &operator=(const FullTextIndex &) = delete;
+
+  /**
+   * @brief Append a batch; its documents replace older versions of the same paths
+   * @param batch Batch to merge, left empty
+   *
+   * A document older than the indexed version of its path (a concurrent
+   * update won the race) is merged dead.
+   */
+  void merge(Batch &batch) {
+    std::unique_lock<std::shared_mutex> lock(fMutex);
+    const uint32_t base = fDocuments.size();
+    for (auto &[term, list] : batch.fTerms) {
+      PostingList &target = fTerms[term];
+      const uint8_t *p = list.tail.data();
+      const uint8_t *end = p + list.tail.size();
+      uint32_t first = base + getVarint(p, end);
+      putVarint(target.tail, target.count == 0 ? first : first - target.lastDoc);
+      target.tail.insert(target.tail.end(), p, end);
+      target.lastDoc = base + list.lastDoc;
+      target.count += list.count;
+    }
+    for (Document &document : batch.fDocuments) {
+      uint32_t doc = fDocuments.size();
+      auto existing = fByPath.find(document.path);
+      if (existing == fByPath.end()) {
+        fByPath.emplace(document.path, doc);
+      } else if (fDocuments[existing->second].mtimeNs > document.mtimeNs) {
+        document.alive = false;
+        ++fDead;
+      } else {
+        retire(existing->second);
+        existing->second = doc;
+      }
+      if (document.alive) {
+        fTotalLength += document.length;
+      }
+      fDocuments.push_back(std::move(document));
+    }
+    if (!batch.fDocuments.empty()) {
+      fDirty = true;
+    }
+    batch.fDocuments.clear();
+    batch.fTerms.clear();
+  }
+
+  /**
+   * @brief Remove a file, or every file below a directory
+   * @param path Relative path
+   */
+  void remove(const std::string &path) {
+    std::unique_lock<std::shared_mutex> lock(fMutex);
+    auto exact = fByPath.find(path);
+    if (exact != fByPath.end()) {
+      retire(exact->second);
+      fByPath.erase(exact);
+      fDirty = true;
+    }
+    std::string prefix = path + "/";
+    auto first = fByPath.lower_bound(prefix);
+    auto last = first;
+    while (last != fByPath.end() && last->first.compare(0, prefix.size(), prefix) == 0) {
+      retire(last->second);
+      ++last;
+    }
+    if (first != last) {
+      fByPath.erase(first, last);
+      fDirty = true;
+    }
+  }
+
+  /**
+   * @brief Remove every document whose path is not in a set
+   * @param paths Paths to keep
+   */
+  void retainOnly(const std::unordered_set<std::string> &paths) {
+    std::unique_lock<std::shared_mutex> lock(fMutex);
+    for (auto entry = fByPath.begin(); entry != fByPath.end();) {
+      if (paths.count(entry->first) == 0) {
+        retire(entry->second);
+        entry = fByPath.erase(entry);
+        fDirty = true;
+      } else {
+        ++entry;
+      }
+    }
+  }
+
+  /**
+   * @brief Whether a path is indexed with the given modification time and size
+   */
+  bool isCurrent(const std::string &path, int64_t mtimeNs, uint64_t size) const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    auto entry = fByPath.find(path);
+    if (entry == fByPath.end()) {
+      return false;
+    }
+    const Document &document = fDocuments[entry->second];
+    return document.mtimeNs == mtimeNs && document.size == size;
+  }
+
+  std::size_t documentCount() const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    return fByPath.size();
+  }
+
+  std::size_t termCount() const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    return fTerms.size();
+  }
+
+  /**
+   * @brief Whether enough documents are dead for compact() to pay off
+   */
+  bool needsCompaction() const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    return fDead > 1024 && fDead > fByPath.size() / 4;
+  }
+
+  /**
+   * @brief Drop dead documents and renumber the live ones
+   *
+   * Every posting list is decoded and re-encoded in memory, which also
+   * releases the mapped snapshot.
+   */
+  void compact() {
+    std::unique_lock<std::shared_mutex> lock(fMutex);
+    constexpr uint32_t kDropped = UINT32_MAX;
+    std::vector<uint32_t> remap(fDocuments.size(), kDropped);
+    std::vector<Document> documents;
+    documents.reserve(fByPath.size());
+    for (uint32_t doc = 0; doc < fDocuments.size(); ++doc) {
+      if (fDocuments[doc].alive) {
+        remap[doc] = documents.size();
+        documents.push_back(std::move(fDocuments[doc]));
+      }
+    }
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> frequencies;
+    for (auto entry = fTerms.begin(); entry != fTerms.end();) {
+      decode(entry->second, docs, frequencies);
+      PostingList list;
+      for (std::size_t i = 0; i < docs.size(); ++i) {
+        if (remap[docs[i]] != kDropped) {
+          list.append(remap[docs[i]], frequencies[i]);
+        }
+      }
+      if (list.count == 0) {
+        entry = fTerms.erase(entry);
+      } else {
+        entry->second = std::move(list);
+        ++entry;
+      }
+    }
+    for (auto &entry : fByPath) {
+      entry.second = remap[entry.second];
+    }
+    fDocuments = std::move(documents);
+    fDead = 0;
+    unmapSnapshot();
+  }
+
+  /**
+   * @brief Ranked conjunctive query
+   * @param text Query text, tokenized like documents
+   * @param maxResults Maximum number of hits
+   * @param prefix Only return documents below this relative directory (may be empty)
+   * @return Hits ranked by BM25 score
+   */
+  Result query(const std::string &text, std::size_t maxResults, const std::string &prefix) const {
+    std::unordered_map<std::string, uint32_t> terms;
+    tokenize(text.data(), text.size(), terms);
+
+    Result result;
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    const double live = fByPath.size();
+    if (terms.empty() || live == 0) {
+      return result;
+    }
+    const double averageLength = std::max(1.0, fTotalLength / live);
+
+    struct TermPostings {
+      std::vector<uint32_t> docs;
+      std::vector<uint32_t> frequencies;
+      double idf;
+    };
+    std::vector<TermPostings> postings;
+    for (const auto &entry : terms) {
+      auto found = fTerms.find(entry.first);
+      if (found == fTerms.end()) {
+        return result;
+      }
+      // Document frequency includes dead documents until the next compaction
+      double df = std::min<double>(found->second.count, live);
+      postings.push_back({{}, {}, std::log(1.0 + (live - df + 0.5) / (df + 0.5))});
+      decode(found->second, postings.back().docs, postings.back().frequencies);
+    }
+
+    // Intersect, shortest list first
+    std::sort(postings.begin(), postings.end(),
+              [](const TermPostings &a, const TermPostings &b) { return a.docs.size() < b.docs.size(); });
+    std::vector<uint32_t> candidates = postings[0].docs;
+    std::vector<uint32_t> next;
+    for (std::size_t i = 1; i < postings.size() && !candidates.empty(); ++i) {
+      intersect(candidates, postings[i].docs, next);
+      candidates.swap(next);
+    }
+
+    // Score, keeping the best hits in a min-heap
+    using Scored = std::pair<double, uint32_t>;
+    std::priority_queue<Scored, std::vector<Scored>, std::greater<Scored>> best;
+    std::vector<std::size_t> cursors(postings.size(), 0);
+    for (uint32_t doc : candidates) {
+      const Document &document = fDocuments[doc];
+      if (!document.alive ||
+          (!prefix.empty() && document.path.compare(0, prefix.size() + 1, prefix + "/") != 0)) {
+        continue;
+      }
+      ++result.matches;
+      double norm = kK1 * (1.0 - kB + kB * document.length / averageLength);
+      double score = 0;
+      for (std::size_t i = 0; i < postings.size(); ++i) {
+        const auto &docs = postings[i].docs;
+        cursors[i] = std::lower_bound(docs.begin() + cursors[i], docs.end(), doc) - docs.begin();
+        double tf = postings[i].frequencies[cursors[i]];
+        score += postings[i].idf * tf * (kK1 + 1.0) / (tf + norm);
+      }
+      if (best.size() < maxResults) {
+        best.emplace(score, doc);
+      } else if (maxResults > 0 && score > best.top().first) {
+        best.pop();
+        best.emplace(score, doc);
+      }
+    }
+    while (!best.empty()) {
+      result.hits.emplace_back(fDocuments[best.top().second].path, best.top().first);
+      best.pop();
+    }
+    std::reverse(result.hits.begin(), result.hits.end());
+    return result;
+  }
+
+  /**
+   * @brief Write the index to a snapshot file (atomically replaced)
+   * @param path Snapshot file
+   * @param root Indexed root, checked by load()
+   * @return false on I/O error
+   *
+   * Dead documents are compacted away first.
+   */
+  bool save(const std::string &path, const std::string &root) {
+    bool hasDead;
+    {
+      std::shared_lock<std::shared_mutex> lock(fMutex);
+      hasDead = fDead > 0;
+    }
+    if (hasDead) {
+      compact();
+    }
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    std::string temporary = path + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    auto put = [file](const void *data, std::size_t size) { std::fwrite(data, 1, size, file); };
+    auto putU32 = [&](uint32_t value) { put(&value, sizeof(value)); };
+    auto putU64 = [&](uint64_t value) { put(&value, sizeof(value)); };
+    auto putString = [&](std::string_view text) {
+      putU32(text.size());
+      put(text.data(), text.size());
+    };
+
+    put(kSnapshotMagic, sizeof(kSnapshotMagic));
+    putString(root);
+    putU32(fDocuments.size());
+    putU64(fTerms.size());
+    for (const Document &document : fDocuments) {
+      putString(document.path);
+      putU32(document.length);
+      putU64(document.mtimeNs);
+      putU64(document.size);
+    }
+    uint64_t offset = 0;
+    for (const auto &[term, list] : fTerms) {
+      uint64_t bytes = list.frozen.size() + list.tail.size();
+      putString(term);
+      putU32(list.lastDoc);
+      putU32(list.count);
+      putU64(offset);
+      putU64(bytes);
+      offset += bytes;
+    }
+    for (const auto &entry : fTerms) {
+      put(entry.second.frozen.data(), entry.second.frozen.size());
+      put(entry.second.tail.data(), entry.second.tail.size());
+    }
+    bool ok = std::ferror(file) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+    fDirty = false;
+    return true;
+  }
+
+  /**
+   * @brief Replace the index content with a snapshot file
+   * @param path Snapshot file
+   * @param root Expected indexed root
+   * @return false if the file is missing, corrupt or was built for another root
+   */
+  bool load(const std::string &path, const std::string &root) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(kSnapshotMagic))) {
+      close(fd);
+      return false;
+    }
+    std::size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      return false;
+    }
+
+    const char *p = static_cast<const char *>(map);
+    const char *end = p + size;
+    bool ok = true;
+    auto get = [&](void *out, std::size_t bytes) {
+      ok = ok && static_cast<std::size_t>(end - p) >= bytes;
+      if (ok) {
+        std::memcpy(out, p, bytes);
+        p += bytes;
+      }
+    };
+    auto getU32 = [&] { uint32_t value = 0; get(&value, sizeof(value)); return value; };
+    auto getU64 = [&] { uint64_t value = 0; get(&value, sizeof(value)); return value; };
+    auto getString = [&] {
+      uint32_t length = getU32();
+      ok = ok && static_cast<std::size_t>(end - p) >= length;
+      std::string_view text = ok ? std::string_view(p, length) : std::string_view();
+      p += text.size();
+      return text;
+    };
+
+    char magic[sizeof(kSnapshotMagic)];
+    get(magic, sizeof(magic));
+    ok = ok && std::memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0 && getString() == root;
+    uint32_t documentCount = getU32();
+    uint64_t termCount = getU64();
+
+    std::vector<Document> documents;
+    for (uint32_t i = 0; ok && i < documentCount; ++i) {
+      Document document;
+      document.path = std::string(getString());
+      document.length = getU32();
+      document.mtimeNs = getU64();
+      document.size = getU64();
+      document.alive = true;
+      documents.push_back(std::move(document));
+    }
+    struct Entry {
+      std::string_view term;
+      PostingList list;
+      uint64_t offset;
+      uint64_t bytes;
+    };
+    std::vector<Entry> entries;
+    for (uint64_t i = 0; ok && i < termCount; ++i) {
+      Entry entry;
+      entry.term = getString();
+      entry.list.lastDoc = getU32();
+      entry.list.count = getU32();
+      entry.offset = getU64();
+      entry.bytes = getU64();
+      ok = ok && entry.list.lastDoc < documentCount;
+      entries.push_back(std::move(entry));
+    }
+    const char *blob = p;
+    for (Entry &entry : entries) {
+      ok = ok && entry.offset <= static_cast<uint64_t>(end - blob) &&
+           entry.bytes <= static_cast<uint64_t>(end - blob) - entry.offset;
+      if (ok) {
+        entry.list.frozen = std::string_view(blob + entry.offset, entry.bytes);
+      }
+    }
+    if (!ok) {
+      munmap(map, size);
+      return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(fMutex);
+    unmapSnapshot();
+    fMapping = map;
+    fMappingSize = size;
+    madvise(map, size, MADV_RANDOM);
+    fDocuments = std::move(documents);
+    fByPath.clear();
+    fTotalLength = 0;
+    for (uint32_t doc = 0; doc < fDocuments.size(); ++doc) {
+      fByPath.emplace(fDocuments[doc].path, doc);
+      fTotalLength += fDocuments[doc].length;
+    }
+    fTerms.clear();
+    fTerms.reserve(entries.size());
+    for (Entry &entry : entries) {
+      fTerms.emplace(std::string(entry.term), std::move(entry.list));
+    }
+    fDead = 0;
+    fDirty = false;
+    return true;
+  }
+
+  /**
+   * @brief Whether the index changed since it was loaded or saved
+   */
+  bool dirty() const { return fDirty; }
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "directoryWalker.hh"
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool searching the files of a directory tree
+ *
+ * The tree is walked in parallel (DirectoryWalker) and every regular file
+ * is memory-mapped and searched on the walker thread that found it. Literal
+ * patterns use a SIMD prefilter on the first and last pattern bytes; regular
+ * expressions are matched line by line with std::regex. Binary files (a NUL
+ * byte in their first block) are skipped. Each matching line is returned as
+ * one text content item "path:line: text".
+ *
+ * std::regex recurses once per character matched, so lines longer than
+ * kMaxRegexLine are not given to it: they are skipped, and the number of
+ * lines skipped is reported.
+ */
+class GrepTool : public McpTool {
+private:
+  struct Match {
+    std::string path;
+    std::size_t line;
+    std::string text;
+  };
+
+  /// Search parameters shared by the walker threads
+  struct Query {
+    std::string pattern;        ///< Literal (lowercased if ignoreCase) or regex source
+    bool ignoreCase = false;
+    bool useRegex = false;
+    std::regex regex;
+    std::string glob;           ///< File name filter (empty: all files)
+    std::size_t maxResults = 100;
+  };
+
+  static constexpr std::size_t kBinaryProbe = 8192;  ///< Bytes checked for NUL
+  static constexpr std::size_t kMaxLineLength = 400; ///< Longer lines are cut
+  static constexpr std::size_t kMaxRegexLine = 2048; ///< Longer lines are not searched with a regex
+
+  SandboxRoot fRoot; ///< Directory searched by the tool
+
+  static bool equalsAt(const char *text, const std::string &needle, bool ignoreCase) {
+    if (!ignoreCase) {
+      return std::memcmp(text, needle.data(), needle.size()) == 0;
+    }
+    for (std::size_t i = 0; i < needle.size(); ++i) {
+      if (std::tolower(static_cast<unsigned char>(text[i])) != needle[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // First occurrence of needle in [begin, end), or nullptr
+  static const char *findLiteral(const char *begin, const char *end,
+                                 const std::string &needle, bool ignoreCase) {
+    const std::size_t n = needle.size();
+    const char *p = begin;
+#if defined(__SSE2__)
+    // Compare 16 candidate positions at once on the first and last needle
+    // bytes; only positions matching both are verified
+    auto upper = [](char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); };
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[n - 1]);
+    const __m128i firstAlt = _mm_set1_epi8(ignoreCase ? upper(needle[0]) : needle[0]);
+    const __m128i lastAlt = _mm_set1_epi8(ignoreCase ? upper(needle[n - 1]) : needle[n - 1]);
+    while (end - p >= static_cast<std::ptrdiff_t>(n + 15)) {
+      __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + n - 1));
+      __m128i eqFirst = _mm_or_si128(_mm_cmpeq_epi8(blockFirst, first),
+                                     _mm_cmpeq_epi8(blockFirst, firstAlt));
+      __m128i eqLast = _mm_or_si128(_mm_cmpeq_epi8(blockLast, last),
+                                    _mm_cmpeq_epi8(blockLast, lastAlt));
+      unsigned mask = _mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast));
+      while (mask != 0) {
+        unsigned bit = __builtin_ctz(mask);
+        if (equalsAt(p + bit, needle, ignoreCase)) {
+          return p + bit;
+        }
+        mask &= mask - 1;
+      }
+      p += 16;
+    }
+#endif
+    for (; end - p >= static_cast<std::ptrdiff_t>(n); ++p) {
+      if (equalsAt(p, needle, ignoreCase)) {
+        return p;
+      }
+    }
+    return nullptr;
+  }
+
+  // Search one mapped file, appending at most 'budget' matches; returns the
+  // number of lines too long for the regex search
+  static std::size_t searchBuffer(const char *data, std::size_t size, const Query &query,
+                                  const std::string &path, std::size_t budget,
+                                  std::vector<Match> &matches) {
+    std::size_t skipped = 0;
+    const char *end = data + size;
+    const char *pos = data;
+    const char *counted = data; // newlines before this pointer are counted
+    std::size_t line = 1;
+
+    auto emit = [&](const char *lineStart, const char *lineEnd) {
+      line += std::count(counted, lineStart, '\n');
+      counted = lineStart;
+      std::size_t length = std::min<std::size_t>(lineEnd - lineStart, kMaxLineLength);
+      matches.push_back({path, line, std::string(lineStart, length)});
+    };
+
+    while (pos < end && matches.size() < budget) {
+      if (query.useRegex) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+        if (lineEnd == nullptr) {
+          lineEnd = end;
+        }
+        if (static_cast<std::size_t>(lineEnd - pos) > kMaxRegexLine) {
+          ++skipped;
+        } else if (std::regex_search(pos, lineEnd, query.regex)) {
+          emit(pos, lineEnd);
+        }
+        pos = lineEnd == end ? end : lineEnd + 1;
+      } else {
+        const char *hit = findLiteral(pos, end, query.pattern, query.ignoreCase);
+        if (hit == nullptr) {
+          break;
+        }
+        const char *lineStart = hit;
+        while (lineStart > pos && lineStart[-1] != '\n') {
+          --lineStart;
+        }
+        const char *lineEnd = static_cast<const char *>(std::memchr(hit, '\n', end - hit));
+        if (lineEnd == nullptr) {
+          lineEnd = end;
+        }
+        emit(lineStart, lineEnd);
+        pos = lineEnd == end ? end : lineEnd + 1;
+      }
+    }
+    return skipped;
+  }
+
+  // Returns the number of lines too long for the regex search
+  static std::size_t searchFile(const std::string &path, const std::string &displayPath,
+                                const Query &query, std::size_t budget,
+                                std::vector<Match> &matches) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return 0;
+    }
+    std::size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      return 0;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char *data = static_cast<const char *>(map);
+    std::size_t skipped = 0;
+    if (std::memchr(data, 0, std::min(size, kBinaryProbe)) == nullptr) {
+      skipped = searchBuffer(data, size, query, displayPath, budget, matches);
+    }
+    munmap(map, size);
+    return skipped;
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param root Directory the tool is allowed to search
+   */
+  explicit GrepTool(const std::string &root) : fRoot(root) {}
+
+  std::string name() const override { return "GrepTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Search the files of a directory tree for a literal "
+                        "string or a regular expression"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"pattern", {{"type", "string"}, {"description", "Text or regular expression to find"}}},
+            {"path", {{"type", "string"}, {"description", "Directory to search, relative to the tool root (default: root)"}}},
+            {"regex", {{"type", "boolean"}, {"description", "Interpret pattern as an ECMAScript regular expression"}}},
+            {"ignoreCase", {{"type", "boolean"}, {"description", "Case-insensitive (ASCII) matching"}}},
+            {"glob", {{"type", "string"}, {"description", "Only search files whose name matches this glob, e.g. \"*.cpp\""}}},
+            {"maxResults", {{"type", "integer"}, {"description", "Maximum number of matching lines (default: 100)"}}}}},
+          {"required", json::array({"pattern"})}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+
+    Query query;
+    query.pattern = arguments.value("pattern", "");
+    if (query.pattern.empty()) {
+      throw std::invalid_argument("Missing 'pattern'");
+    }
+    query.ignoreCase = arguments.value("ignoreCase", false);
+    query.useRegex = arguments.value("regex", false);
+    query.glob = arguments.value("glob", "");
+    query.maxResults = std::max<int64_t>(1, arguments.value("maxResults", int64_t(100)));
+    if (query.useRegex) {
+      auto flags = std::regex::ECMAScript | std::regex::optimize;
+      try {
+        query.regex = std::regex(query.pattern, query.ignoreCase ? flags | std::regex::icase : flags);
+      } catch (const std::regex_error &e) {
+        throw std::invalid_argument("Invalid regular expression: " + std::string(e.what()));
+      }
+    } else if (query.ignoreCase) {
+      for (char &c : query.pattern) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      }
+    }
+
+    std::string dir = fRoot.resolve(arguments.value("path", "."));
+
+    // One match more than maxResults is looked for, to tell whether results
+    // were truncated. Walker threads do not see this thread's cancellation
+    // state: copy it
+    McpCancellation cancellation = currentCancellation();
+    std::mutex resultMutex;
+    std::vector<Match> matches;
+    std::atomic<std::size_t> found{0};
+    std::atomic<std::size_t> skipped{0};
+
+    DirectoryWalker walker([&cancellation] { return cancellation.requested(); });
+    walker.walk(dir, [&](const std::string &path, unsigned char type) {
+      if (type != DT_REG) {
+        return true;
+      }
+      if (!query.glob.empty()) {
+        const char *base = std::strrchr(path.c_str(), '/');
+        if (fnmatch(query.glob.c_str(), base ? base + 1 : path.c_str(), 0) != 0) {
+          return true;
+        }
+      }
+      std::vector<Match> local;
+      std::size_t budget = query.maxResults + 1 - std::min(query.maxResults + 1, found.load());
+      skipped += searchFile(path, fRoot.relative(path), query, budget, local);
+      if (!local.empty()) {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        found += local.size();
+        std::move(local.begin(), local.end(), std::back_inserter(matches));
+      }
+      return found <= query.maxResults;
+    });
+
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+      return a.path != b.path ? a.path < b.path : a.line < b.line;
+    });
+    bool truncated = matches.size() > query.maxResults;
+    if (truncated) {
+      matches.resize(query.maxResults);
+    }
+
+    json content = json::array();
+    for (const Match &match : matches) {
+      content.push_back(textItem(match.path + ":" + std::to_string(match.line) + ": " + match.text));
+    }
+    if (matches.empty()) {
+      content.push_back(textItem("No matches"));
+    } else if (truncated) {
+      content.push_back(textItem("Results limited to " + std::to_string(query.maxResults) + " matches"));
+    }
+    if (skipped > 0) {
+      content.push_back(textItem("Lines longer than " + std::to_string(kMaxRegexLine) +
+                                 " bytes not searched: " + std::to_string(skipped.load())));
+    }
+    return content;
+  }
+};
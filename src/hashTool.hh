@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checksum.hh"
+#include "directoryWalker.hh"
+#include "mcpJson.hh"
+#include "kvStore.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool computing the checksums of large sets of files
+ *
+ * Directories are walked in parallel (see directoryWalker.hh), then the
+ * files are hashed by a pool of threads: each thread owns a deque of files,
+ * largest first, and an idle thread steals the smallest files of another
+ * one, so a few huge files do not leave the rest of the pool waiting.
+ * Files are read sequentially in large blocks after posix_fadvise().
+ *
+ * Digests are cached per device and inode, with the size, modification and
+ * change time they were computed for, so an unchanged file is never read
+ * twice and a changed one replaces its entry. The cache lives in memory, or
+ * in a KvStore when a cache directory is given, so it survives restarts.
+ */
+class HashTool : public McpTool {
+private:
+  static constexpr std::size_t kReadSize = 1 << 20;                 ///< read() block size
+  static constexpr off_t kDropCacheSize = off_t(64) << 20;          ///< Files evicted from the page cache once read
+  static constexpr std::size_t kMemoryCacheSize = 1 << 20;          ///< Digests kept without a cache directory
+  static constexpr std::size_t kDefaultMaxResults = 1000;
+
+  enum class Algorithm : char { kXxh64 = 'x', kCrc32c = 'c' };
+
+  /// One file to hash
+  struct Job {
+    std::string path;              ///< Absolute path
+    struct stat info;              ///< stat() taken by the walker
+    std::string digest;            ///< Hex digest, or "error: ..." on failure
+    bool cached = false;
+    bool failed = false;
+  };
+
+  /// Work-stealing deque of job indexes
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::size_t> jobs;  ///< Largest first: the owner pops the front, thieves the back
+  };
+
+  SandboxRoot fRoot;                                    ///< Directory readable by the tool
+  std::unique_ptr<KvStore> fStore;                      ///< Persistent digest cache, if any
+  std::mutex fCacheMutex;                               ///< Protects fMemoryCache
+  std::unordered_map<std::string, std::string> fMemoryCache; ///< Cache entries when there is no store
+
+  static int64_t nanoseconds(const struct timespec &time) {
+    return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+  }
+
+  // Cache entry of a file for one algorithm: one key per inode, overwritten
+  // when the file changes, so the cache grows with the tree, not with its
+  // history
+  static std::string cacheKey(const struct stat &info, Algorithm algorithm) {
+    uint64_t fields[2] = {uint64_t(info.st_dev), uint64_t(info.st_ino)};
+    std::string key(1, static_cast<char>(algorithm));
+    key.append(reinterpret_cast<const char *>(fields), sizeof(fields));
+    return key;
+  }
+
+  // Cached value: the version of the file that was hashed, then its digest
+  static std::string cacheValue(const struct stat &info, uint64_t digest) {
+    uint64_t fields[4] = {uint64_t(info.st_size), uint64_t(nanoseconds(info.st_mtim)),
+                          uint64_t(nanoseconds(info.st_ctim)), digest};
+    return std::string(reinterpret_cast<const char *>(fields), sizeof(fields));
+  }
+
+  // Digest of a cached value, if it was computed for this version of the file
+  static std::optional<uint64_t> validDigest(const std::string &value, const struct stat &info) {
+    std::string current = cacheValue(info, 0);
+    if (value.size() != current.size() ||
+        std::memcmp(value.data(), current.data(), current.size() - sizeof(uint64_t)) != 0) {
+      return std::nullopt;
+    }
+    uint64_t digest;
+    std::memcpy(&digest, value.data() + current.size() - sizeof(uint64_t), sizeof(digest));
+    return digest;
+  }
+
+  std::optional<uint64_t> cachedDigest(const std::string &key, const struct stat &info) {
+    if (fStore) {
+      std::optional<std::string> value = fStore->get(key);
+      return value ? validDigest(*value, info) : std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(fCacheMutex);
+    auto entry = fMemoryCache.find(key);
+    if (entry == fMemoryCache.end()) {
+      return std::nullopt;
+    }
+    return validDigest(entry->second, info);
+  }
+
+  void storeDigest(const std::string &key, const struct stat &info, uint64_t digest) {
+    if (fStore) {
+      fStore->put(key, cacheValue(info, digest), false);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(fCacheMutex);
+    if (fMemoryCache.size() >= kMemoryCacheSize) {
+      fMemoryCache.clear();
+    }
+    fMemoryCache[key] = cacheValue(info, digest);
+  }
+
+  static std::string hex(uint64_t digest, Algorithm algorithm) {
+    char text[17];
+    if (algorithm == Algorithm::kCrc32c) {
+      std::snprintf(text, sizeof(text), "%08x", static_cast<uint32_t>(digest));
+    } else {
+      std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(digest));
+    }
+    return text;
+  }
+
+  // Read and hash a whole file; throws if it cannot be read or changes meanwhile
+  static uint64_t hashFile(const Job &job, Algorithm algorithm, std::vector<char> &buffer,
+                           const McpCancellation &cancellation, std::atomic<uint64_t> &bytesRead) {
+    int fd = open(job.path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+      fd = open(job.path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+      throw std::runtime_error(std::strerror(errno));
+    }
+    std::unique_ptr<int, void (*)(int *)> guard(&fd, [](int *descriptor) { close(*descriptor); });
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    checksum::Xxh64 xxh;
+    uint32_t crc = 0;
+    off_t offset = 0;
+    for (;;) {
+      if (cancellation.requested()) {
+        throw std::runtime_error("cancelled");
+      }
+      ssize_t count = read(fd, buffer.data(), buffer.size());
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(std::strerror(errno));
+      }
+      if (count == 0) {
+        break;
+      }
+      if (algorithm == Algorithm::kCrc32c) {
+        crc = checksum::crc32c(buffer.data(), count, crc);
+      } else {
+        xxh.update(buffer.data(), count);
+      }
+      if (job.info.st_size >= kDropCacheSize) {
+        posix_fadvise(fd, offset, count, POSIX_FADV_DONTNEED);
+      }
+      offset += count;
+      bytesRead += count;
+    }
+
+    struct stat after;
+    if (fstat(fd, &after) != 0 || after.st_size != offset || after.st_size != job.info.st_size ||
+        nanoseconds(after.st_mtim) != nanoseconds(job.info.st_mtim)) {
+      throw std::runtime_error("file changed while being read");
+    }
+    return algorithm == Algorithm::kCrc32c ? crc : xxh.digest();
+  }
+
+  // Take the next job: own queue first, then steal from the others
+  static bool nextJob(std::vector<Queue> &queues, std::size_t self, std::size_t &job) {
+    {
+      std::lock_guard<std::mutex> lock(queues[self].mutex);
+      if (!queues[self].jobs.empty()) {
+        job = queues[self].jobs.front();
+        queues[self].jobs.pop_front();
+        return true;
+      }
+    }
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+      Queue &victim = queues[(self + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.jobs.empty()) {
+        job = victim.jobs.back();
+        victim.jobs.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Collect the regular files named by the client, walking directories
+  std::vector<Job> collect(const json &paths, const McpCancellation &cancellation) {
+    std::vector<Job> jobs;
+    std::mutex jobsMutex;
+    for (const json &entry : paths) {
+      if (!entry.is_string()) {
+        throw std::invalid_argument("'paths' must be an array of strings");
+      }
+      std::string path = fRoot.resolve(entry.get<std::string>());
+      struct stat info;
+      if (stat(path.c_str(), &info) != 0) {
+        throw std::invalid_argument("Cannot access " + entry.get<std::string>());
+      }
+      if (S_ISREG(info.st_mode)) {
+        jobs.push_back({path, info, "", false, false});
+        continue;
+      }
+      if (!S_ISDIR(info.st_mode)) {
+        continue;
+      }
+      DirectoryWalker walker([&cancellation] { return cancellation.requested(); });
+      walker.walk(path, [&](const std::string &file, unsigned char type) {
+        if (type != DT_REG && type != DT_UNKNOWN) {
+          return true;
+        }
+        struct stat fileInfo;
+        if (stat(file.c_str(), &fileInfo) == 0 && S_ISREG(fileInfo.st_mode)) {
+          std::lock_guard<std::mutex> lock(jobsMutex);
+          jobs.push_back({file, fileInfo, "", false, false});
+        }
+        return true;
+      });
+    }
+    // A file named twice, or reached through two paths, is hashed once
+    std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.path < b.path; });
+    jobs.erase(std::unique(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.path == b.path; }),
+               jobs.end());
+    return jobs;
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param root Directory whose files can be hashed
+   * @param cacheDirectory Directory of the persistent digest cache (empty: cache in memory)
+   */
+  explicit HashTool(const std::string &root, const std::string &cacheDirectory = "") : fRoot(root) {
+    if (!cacheDirectory.empty()) {
+      fStore = std::make_unique<KvStore>(cacheDirectory);
+    }
+  }
+
+  std::string name() const override { return "HashTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Compute the checksum of files, or of every file below directories, in parallel; "
+                        "digests of unchanged files are cached"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"paths", {{"type", "array"}, {"items", {{"type", "string"}}}, {"description", "Files or directories, relative to the root (default: [\".\"])"}}},
+            {"algorithm", {{"type", "string"}, {"enum", {"xxh64", "crc32c"}}, {"description", "Checksum (default: xxh64)"}}},
+            {"maxResults", {{"type", "integer"}, {"description", "Maximum number of digests returned (default: 1000)"}}}}}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.idempotentHint = false; // Files change: results must not be reused by the server
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    auto start = std::chrono::steady_clock::now();
+
+    std::string algorithmName = arguments.value("algorithm", "xxh64");
+    Algorithm algorithm;
+    if (algorithmName == "xxh64") {
+      algorithm = Algorithm::kXxh64;
+    } else if (algorithmName == "crc32c") {
+      algorithm = Algorithm::kCrc32c;
+    } else {
+      throw std::invalid_argument("Unknown algorithm: " + algorithmName + " (expected xxh64 or crc32c)");
+    }
+    std::size_t maxResults = std::max<int64_t>(1, arguments.value("maxResults", int64_t(kDefaultMaxResults)));
+    json paths = arguments.value("paths", json::array({"."}));
+    if (!paths.is_array()) {
+      throw std::invalid_argument("'paths' must be an array of strings");
+    }
+
+    // Worker threads do not see this thread's cancellation state: copy it
+    McpCancellation cancellation = currentCancellation();
+    std::vector<Job> jobs = collect(paths, cancellation);
+
+    // Deal the files, largest first, round-robin over the thread queues
+    std::size_t threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 16);
+    threads = std::max<std::size_t>(1, std::min(threads, jobs.size()));
+    std::vector<std::size_t> order(jobs.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [&jobs](std::size_t a, std::size_t b) { return jobs[a].info.st_size > jobs[b].info.st_size; });
+    std::vector<Queue> queues(threads);
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      queues[i % threads].jobs.push_back(order[i]);
+    }
+
+    std::atomic<uint64_t> bytesRead{0};
+    auto worker = [&](std::size_t self) {
+      std::vector<char> buffer(kReadSize);
+      std::size_t index;
+      while (!cancellation.requested() && nextJob(queues, self, index)) {
+        Job &job = jobs[index];
+        std::string key = cacheKey(job.info, algorithm);
+        if (std::optional<uint64_t> digest = cachedDigest(key, job.info)) {
+          job.digest = hex(*digest, algorithm);
+          job.cached = true;
+          continue;
+        }
+        try {
+          uint64_t digest = hashFile(job, algorithm, buffer, cancellation, bytesRead);
+          storeDigest(key, job.info, digest);
+          job.digest = hex(digest, algorithm);
+        } catch (const std::exception &e) {
+          job.digest = std::string("error: ") + e.what();
+          job.failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) {
+      pool.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto &thread : pool) {
+      thread.join();
+    }
+    if (cancellation.requested()) {
+      throw std::runtime_error("Cancelled");
+    }
+
+    json content = json::array();
+    std::size_t cached = 0;
+    std::size_t failed = 0;
+    for (const Job &job : jobs) {
+      cached += job.cached;
+      failed += job.failed;
+      if (content.size() < maxResults) {
+        content.push_back(textItem(job.digest + "  " + fRoot.relative(job.path)));
+      }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::string summary = std::to_string(jobs.size()) + " files, " + std::to_string(cached) + " cached, " +
+                          std::to_string(bytesRead.load() >> 20) + " MB read, " + std::to_string(failed) +
+                          " errors, " + std::to_string(elapsed.count()) + " ms";
+    if (jobs.size() > maxResults) {
+      summary += ", showing the first " + std::to_string(maxResults);
+    }
+    content.push_back(textItem(summary));
+    return content;
+  }
+};
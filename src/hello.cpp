@@ -1,11 +1,57 @@
+// This translation unit defines the global operator new and delete (mcpMemoryGovernor.hh)
+#define MCP_DEFINE_ALLOCATION_FUNCTIONS
+
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
-#include "json.hpp"
+#include "commandTool.hh"
+#include "csvQueryTool.hh"
+#include "fileReadTool.hh"
+#include "grepTool.hh"
+#include "hashTool.hh"
+#include "mcpHugePages.hh"
+#include "mcpJson.hh"
+#include "mcpMemoryGovernor.hh"
+#include "jsonQueryTool.hh"
+#include "kvStoreTool.hh"
+#include "listTool.hh"
 #include "mcpServer.hh"
 #include "mcpTool.hh"
+#include "perfectHash.hh"
+#include "searchTool.hh"
+#include "vectorSearchTool.hh"
+
+/**
+ * @brief Greeting template: the user name is inserted between prefix and suffix
+ */
+struct Greeting {
+  std::string_view prefix;
+  std::string_view suffix;
+};
 
-using json = nlohmann::json;
+/**
+ * @brief Greeting templates indexed by locale, resolved at compile time
+ */
+static constexpr auto kGreetings = makePerfectHashTable<Greeting, 16>({{
+    {"en", {"Hello ", "!"}},
+    {"fr", {"Bonjour ", " !"}},
+    {"es", {"\u00a1Hola ", "!"}},
+    {"de", {"Hallo ", "!"}},
+    {"it", {"Ciao ", "!"}},
+    {"pt", {"Ol\u00e1 ", "!"}},
+    {"nl", {"Hallo ", "!"}},
+    {"sv", {"Hej ", "!"}},
+    {"pl", {"Cze\u015b\u0107 ", "!"}},
+    {"tr", {"Merhaba ", "!"}},
+    {"ru", {"\u041f\u0440\u0438\u0432\u0435\u0442, ", "!"}},
+    {"el", {"\u0393\u03b5\u03b9\u03b1 \u03c3\u03bf\u03c5 ", "!"}},
+    {"ja", {"\u3053\u3093\u306b\u3061\u306f\u3001", "\u3055\u3093\uff01"}},
+    {"zh", {"\u4f60\u597d\uff0c", "\uff01"}},
+    {"ko", {"\uc548\ub155\ud558\uc138\uc694, ", "\ub2d8!"}},
+    {"ar", {"\u0645\u0631\u062d\u0628\u0627 ", "!"}},
+}});
 
 class HelloTool : public McpTool {
 public:
@@ -24,12 +70,27 @@ public:
          {{"type", "object"},
           {"properties",
            {{"value",
-             {{"type", "string"}, {"description", "User name to greet"}}}}},
+             {{"type", "string"}, {"description", "User name to greet"}}},
+            {"locale",
+             {{"type", "string"},
+              {"description",
+               "Greeting language (e.g. \"fr\" or \"fr-CA\"), "
+               "defaults to English"},
+              {"examples", supportedLocales()}}}}},
           {"required", json::array({"value"})}}}};
 
     return description.dump();
   }
 
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.idempotentHint = true;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
   json call(const std::string &args) override {
     try {
       // Parse the JSON arguments
@@ -38,22 +99,128 @@ public:
       // Extract the 'value' field
       std::string userName = arguments.value("value", "World");
 
-      // Create the greeting message
-      std::string greeting = "Hello " + userName + "!";
+      // Create the greeting message in the requested language
+      const Greeting &templ = findGreeting(arguments.value("locale", "en"));
+      std::string greeting;
+      greeting.reserve(templ.prefix.size() + userName.size() +
+                       templ.suffix.size());
+      greeting.append(templ.prefix).append(userName).append(templ.suffix);
 
       // Return as MCP content array
-      return json::array({{{"type", "text"}, {"text", greeting}}});
+      return json::array({textItem(std::move(greeting))});
 
     } catch (const json::parse_error &e) {
       // Handle parse error
-      return json::array({{{"type", "text"}, {"text", "Error: Invalid arguments"}}});
+      return json::array({textItem("Error: Invalid arguments")});
+    }
+  }
+
+private:
+  /**
+   * @brief Resolve a locale tag to its greeting template
+   *
+   * Tries the full tag first, then its language subtag ("fr-CA" -> "fr"),
+   * and falls back to English.
+   */
+  static const Greeting &findGreeting(std::string_view locale) {
+    if (const Greeting *greeting = kGreetings.find(locale)) {
+      return *greeting;
+    }
+    std::size_t sep = locale.find_first_of("-_");
+    if (sep != std::string_view::npos) {
+      if (const Greeting *greeting = kGreetings.find(locale.substr(0, sep))) {
+        return *greeting;
+      }
     }
+    return *kGreetings.find("en");
+  }
+
+  static json supportedLocales() {
+    json locales = json::array();
+    kGreetings.forEach([&](std::string_view key, const Greeting &) {
+      locales.push_back(std::string(key));
+    });
+    return locales;
   }
 };
 
-int main() {
+int main(int argc, char *argv[]) {
   SimpleMCPServer server("GreetingServer");
+
+  // SIGUSR2 re-executes the (possibly replaced) binary without closing stdio
+  server.setUpgradeCommand(std::vector<std::string>(argv, argv + argc));
+
+  // Optional per-session call rate limit, e.g. MCP_RATE_LIMIT=5 MCP_RATE_BURST=10
+  if (const char *rate = std::getenv("MCP_RATE_LIMIT")) {
+    const char *burst = std::getenv("MCP_RATE_BURST");
+    server.setRateLimit(std::atof(rate), burst ? std::atof(burst) : std::min(std::atof(rate), McpRateLimiter::kMaxBurst));
+  }
+
+  // Worker threads running read-only tools, optionally one pinned per core
+  if (const char *workers = std::getenv("MCP_WORKERS")) {
+    const char *pin = std::getenv("MCP_PIN_WORKERS");
+    server.setWorkerThreads(std::atol(workers), pin != nullptr && std::string(pin) == "1");
+  }
+
+  // Huge pages for large message buffers: off (default), transparent or explicit
+  if (const char *hugePages = std::getenv("MCP_HUGE_PAGES")) {
+    McpHugePages::setMode(McpHugePages::parseMode(hugePages));
+  }
+
+  // Memory budgets in MB, for the whole process and for each request
+  const char *memoryBudget = std::getenv("MCP_MEMORY_BUDGET_MB");
+  const char *requestBudget = std::getenv("MCP_REQUEST_MEMORY_MB");
+  if (memoryBudget != nullptr || requestBudget != nullptr) {
+    McpMemoryGovernor::configure(std::size_t(std::atol(memoryBudget ? memoryBudget : "0")) << 20,
+                                 std::size_t(std::atol(requestBudget ? requestBudget : "0")) << 20);
+  }
+
+  // Time given to in-flight calls on end of input or SIGTERM
+  if (const char *grace = std::getenv("MCP_DRAIN_GRACE_MS")) {
+    server.setDrainGracePeriod(std::chrono::milliseconds(std::atol(grace)));
+  }
+
   server.registerTool(std::make_unique<HelloTool>());
+
+  // Built-in file system tools, confined to MCP_ROOT
+  if (const char *root = std::getenv("MCP_ROOT")) {
+    server.registerTool(std::make_unique<GrepTool>(root));
+    server.registerTool(std::make_unique<FileReadTool>(root));
+    server.registerTool(std::make_unique<ListTool>(root));
+    server.registerTool(std::make_unique<JsonQueryTool>(root));
+    server.registerTool(std::make_unique<CsvQueryTool>(root));
+
+    // File checksums, cached across restarts in MCP_HASH_CACHE if set
+    const char *hashCache = std::getenv("MCP_HASH_CACHE");
+    server.registerTool(std::make_unique<HashTool>(root, hashCache ? hashCache : ""));
+
+    // Full-text index of MCP_ROOT, saved to the MCP_SEARCH_INDEX file if not empty
+    if (const char *snapshot = std::getenv("MCP_SEARCH_INDEX")) {
+      server.registerTool(std::make_unique<SearchTool>(root, snapshot));
+    }
+  }
+
+  // Nearest-neighbor search over a local .fvecs embedding file
+  if (const char *vectors = std::getenv("MCP_VECTORS")) {
+    const char *metric = std::getenv("MCP_VECTOR_METRIC");
+    const char *labels = std::getenv("MCP_VECTOR_LABELS");
+    const char *graph = std::getenv("MCP_VECTOR_GRAPH");
+    server.registerTool(std::make_unique<VectorSearchTool>(vectors, metric ? metric : "cosine",
+                                                           labels ? labels : "", graph ? graph : ""));
+  }
+
+  // Persistent key-value scratch space stored in the MCP_KV_DIR directory
+  if (const char *directory = std::getenv("MCP_KV_DIR")) {
+    server.registerTool(std::make_unique<KvStoreTool>(directory));
+  }
+
+  // Command runner, opt-in: MCP_COMMANDS lists the commands it may run,
+  // in working directories under MCP_ROOT (default: the current directory)
+  if (const char *commands = std::getenv("MCP_COMMANDS")) {
+    const char *root = std::getenv("MCP_ROOT");
+    server.registerTool(std::make_unique<CommandTool>(commands, root ? root : "."));
+  }
+
   server.run();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,502 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vectorKernels.hh"
+
+// ============================================================================
+// HNSW Index
+// ============================================================================
+
+/**
+ * @brief Hierarchical Navigable Small World graph over a float matrix
+ *
+ * Approximate nearest neighbor search (Malkov & Yashunin): every vector is
+ * a node of layer 0 and, with exponentially decreasing probability, of the
+ * layers above. A query descends greedily from the top layer, then explores
+ * layer 0 with a beam of width ef.
+ *
+ * The vectors are not copied: the index reads rows from caller-owned memory
+ * (typically a mapped file) with a row stride. Build inserts nodes from
+ * several threads, each neighbor list guarded by its own mutex; the finished
+ * graph is read-only and queries need no locking.
+ */
+class HnswIndex {
+public:
+  enum class Metric { L2, InnerProduct, Cosine };
+
+  /// A search answer: smaller distances are closer
+  struct Neighbor {
+    float distance;
+    uint32_t id;
+    bool operator<(const Neighbor &other) const { return distance < other.distance; }
+    bool operator>(const Neighbor &other) const { return distance > other.distance; }
+  };
+
+private:
+  static constexpr uint32_t kM = 16;               ///< Links per node on upper layers
+  static constexpr uint32_t kM0 = 2 * kM;          ///< Links per node on layer 0
+  static constexpr uint32_t kEfConstruction = 200; ///< Beam width while building
+  static constexpr char kGraphMagic[8] = {'M', 'C', 'P', 'H', 'N', 'S', 'W', '1'};
+
+  const float *fData;                  ///< First row
+  std::size_t fCount;                  ///< Number of rows
+  std::size_t fDim;                    ///< Floats per vector
+  std::size_t fStride;                 ///< Floats between consecutive rows
+  Metric fMetric;
+  vectorKernels::Kernels fKernels;     ///< Distance kernels for this CPU
+  std::vector<float> fNorms;           ///< Row norms (cosine only)
+
+  std::vector<uint8_t> fLevels;                   ///< Top layer of each node
+  std::vector<uint32_t> fLinks0;                  ///< Layer 0: per node, count then kM0 ids
+  std::vector<std::vector<uint32_t>> fUpperLinks; ///< Layers 1..level: count then kM ids each
+  uint32_t fEntry = 0;                            ///< Entry point (a node of the top layer)
+  int fMaxLevel = -1;                             ///< Top layer
+  std::unique_ptr<std::mutex[]> fNodeLocks;       ///< Guard neighbor lists while building
+  std::mutex fEntryLock;                          ///< Guards fEntry and fMaxLevel while building
+  std::atomic<std::size_t> fInserted{0};          ///< Nodes inserted so far
+
+  /// Per-thread visited marks, reset by bumping an epoch
+  struct Visited {
+    std::vector<uint32_t> marks;
+    uint32_t epoch = 0;
+  };
+
+  const float *row(uint32_t id) const { return fData + id * fStride; }
+
+  static Visited &visited(std::size_t count) {
+    thread_local Visited instance;
+    if (instance.marks.size() < count) {
+      instance.marks.assign(count, 0);
+      instance.epoch = 0;
+    }
+    if (++instance.epoch == 0) {
+      std::fill(instance.marks.begin(), instance.marks.end(), 0);
+      instance.epoch = 1;
+    }
+    return instance;
+  }
+
+  float distance(const float *query, float queryNorm, uint32_t id) const {
+    switch (fMetric) {
+    case Metric::L2:
+      return fKernels.l2(query, row(id), fDim);
+    case Metric::InnerProduct:
+      return -fKernels.dot(query, row(id), fDim);
+    case Metric::Cosine:
+    default: {
+      float norms = queryNorm * fNorms[id];
+      return norms > 0 ? 1.0f - fKernels.dot(query, row(id), fDim) / norms : 1.0f;
+    }
+    }
+  }
+
+  float norm(const float *vector) const {
+    return fMetric == Metric::Cosine ? std::sqrt(fKernels.dot(vector, vector, fDim)) : 0.0f;
+  }
+
+  uint32_t *links(uint32_t id, int level) {
+    return level == 0 ? &fLinks0[id * (kM0 + 1)] : &fUpperLinks[id][(level - 1) * (kM + 1)];
+  }
+
+  const uint32_t *links(uint32_t id, int level) const {
+    return const_cast<HnswIndex *>(this)->links(id, level);
+  }
+
+  // Copy the neighbor list of a node, under its lock while building
+  void neighbors(uint32_t id, int level, bool locked, std::vector<uint32_t> &out) const {
+    std::unique_lock<std::mutex> lock;
+    if (locked) {
+      lock = std::unique_lock<std::mutex>(fNodeLocks[id]);
+    }
+    const uint32_t *list = links(id, level);
+    out.assign(list + 1, list + 1 + list[0]);
+  }
+
+  Neighbor greedy(const float *query, float queryNorm, Neighbor current, int level,
+                  bool locked) const {
+    std::vector<uint32_t> list;
+    for (bool changed = true; changed;) {
+      changed = false;
+      neighbors(current.id, level, locked, list);
+      for (uint32_t candidate : list) {
+        float d = distance(query, queryNorm, candidate);
+        if (d < current.distance) {
+          current = {d, candidate};
+          changed = true;
+        }
+      }
+    }
+    return current;
+  }
+
+  // Beam search of one layer; returns up to ef nodes, closest first
+  std::vector<Neighbor> searchLayer(const float *query, float queryNorm,
+                                    const std::vector<Neighbor> &entries, std::size_t ef,
+                                    int level, bool locked) const {
+    Visited &seen = visited(fCount);
+    std::priority_queue<Neighbor> best;                                          // furthest on top
+    std::priority_queue<Neighbor, std::vector<Neighbor>, std::greater<Neighbor>> frontier; // closest on top
+    for (const Neighbor &entry : entries) {
+      seen.marks[entry.id] = seen.epoch;
+      best.push(entry);
+      frontier.push(entry);
+    }
+    while (best.size() > ef) {
+      best.pop();
+    }
+
+    std::vector<uint32_t> list;
+    while (!frontier.empty()) {
+      Neighbor current = frontier.top();
+      if (current.distance > best.top().distance && best.size() >= ef) {
+        break;
+      }
+      frontier.pop();
+      neighbors(current.id, level, locked, list);
+      for (std::size_t i = 0; i < list.size(); ++i) {
+        if (i + 1 < list.size()) {
+          __builtin_prefetch(row(list[i + 1]));
+        }
+        uint32_t candidate = list[i];
+        if (seen.marks[candidate] == seen.epoch) {
+          continue;
+        }
+        seen.marks[candidate] = seen.epoch;
+        float d = distance(query, queryNorm, candidate);
+        if (best.size() < ef || d < best.top().distance) {
+          frontier.push({d, candidate});
+          best.push({d, candidate});
+          if (best.size() > ef) {
+            best.pop();
+          }
+        }
+      }
+    }
+
+    std::vector<Neighbor> result(best.size());
+    for (std::size_t i = result.size(); i-- > 0; best.pop()) {
+      result[i] = best.top();
+    }
+    return result;
+  }
+
+  // Neighbor selection heuristic: keep a candidate only if it is closer to
+  // the base node than to every neighbor already kept (candidates sorted)
+  std::vector<Neighbor> selectNeighbors(const std::vector<Neighbor> &candidates,
+                                        std::size_t max) const {
+    std::vector<Neighbor> selected;
+    for (const Neighbor &candidate : candidates) {
+      if (selected.size() >= max) {
+        break;
+      }
+      const float *vector = row(candidate.id);
+      float vectorNorm = fMetric == Metric::Cosine ? fNorms[candidate.id] : 0.0f;
+      bool diverse = std::none_of(selected.begin(), selected.end(), [&](const Neighbor &kept) {
+        return distance(vector, vectorNorm, kept.id) < candidate.distance;
+      });
+      if (diverse) {
+        selected.push_back(candidate);
+      }
+    }
+    return selected;
+  }
+
+  void connect(uint32_t id, const std::vector<Neighbor> &selected, int level) {
+    const uint32_t capacity = level == 0 ? kM0 : kM;
+    {
+      std::lock_guard<std::mutex> lock(fNodeLocks[id]);
+      uint32_t *list = links(id, level);
+      list[0] = selected.size();
+      for (std::size_t i = 0; i < selected.size(); ++i) {
+        list[1 + i] = selected[i].id;
+      }
+    }
+    for (const Neighbor &neighbor : selected) {
+      std::lock_guard<std::mutex> lock(fNodeLocks[neighbor.id]);
+      uint32_t *list = links(neighbor.id, level);
+      if (list[0] < capacity) {
+        list[1 + list[0]++] = id;
+        continue;
+      }
+      // Full: keep the best diverse subset of the old links plus the new one
+      const float *base = row(neighbor.id);
+      float baseNorm = fMetric == Metric::Cosine ? fNorms[neighbor.id] : 0.0f;
+      std::vector<Neighbor> candidates{{neighbor.distance, id}};
+      for (uint32_t i = 1; i <= list[0]; ++i) {
+        candidates.push_back({distance(base, baseNorm, list[i]), list[i]});
+      }
+      std::sort(candidates.begin(), candidates.end());
+      std::vector<Neighbor> kept = selectNeighbors(candidates, capacity);
+      list[0] = kept.size();
+      for (std::size_t i = 0; i < kept.size(); ++i) {
+        list[1 + i] = kept[i].id;
+      }
+    }
+  }
+
+  void insert(uint32_t id) {
+    const int level = fLevels[id];
+    std::unique_lock<std::mutex> entryLock(fEntryLock);
+    const int maxLevel = fMaxLevel;
+    const uint32_t entry = fEntry;
+    if (maxLevel < 0) {
+      fEntry = id;
+      fMaxLevel = level;
+      return;
+    }
+    if (level <= maxLevel) {
+      entryLock.unlock(); // only a new top node updates the entry point
+    }
+
+    const float *query = row(id);
+    const float queryNorm = fMetric == Metric::Cosine ? fNorms[id] : 0.0f;
+    Neighbor current{distance(query, queryNorm, entry), entry};
+    for (int layer = maxLevel; layer > level; --layer) {
+      current = greedy(query, queryNorm, current, layer, true);
+    }
+    std::vector<Neighbor> entries{current};
+    for (int layer = std::min(level, maxLevel); layer >= 0; --layer) {
+      std::vector<Neighbor> found = searchLayer(query, queryNorm, entries, kEfConstruction, layer, true);
+      connect(id, selectNeighbors(found, kM), layer);
+      entries = std::move(found);
+    }
+    if (level > maxLevel) {
+      fEntry = id;
+      fMaxLevel = level;
+    }
+  }
+
+  void allocateLinks() {
+    fLinks0.assign(fCount * (kM0 + 1), 0);
+    fUpperLinks.assign(fCount, {});
+    for (std::size_t id = 0; id < fCount; ++id) {
+      fUpperLinks[id].assign(fLevels[id] * (kM + 1), 0);
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor; the graph is empty until build() or load()
+   * @param data First row of the matrix (must outlive the index)
+   * @param count Number of rows
+   * @param dim Floats per vector
+   * @param stride Floats between consecutive rows (>= dim)
+   * @param metric Distance used for the graph and the queries
+   */
+  HnswIndex(const float *data, std::size_t count, std::size_t dim, std::size_t stride, Metric metric)
+      : fData(data), fCount(count), fDim(dim), fStride(stride), fMetric(metric),
+        fKernels(vectorKernels::selectKernels()) {
+    if (fMetric == Metric::Cosine) {
+      fNorms.resize(fCount);
+      for (std::size_t id = 0; id < fCount; ++id) {
+        fNorms[id] = std::sqrt(fKernels.dot(row(id), row(id), fDim));
+      }
+    }
+  }
+
+  HnswIndex(const HnswIndex &) = delete;
+  HnswIndex &operator=(const HnswIndex &) = delete;
+
+  std::size_t size() const { return fCount; }
+  std::size_t dimension() const { return fDim; }
+  std::size_t inserted() const { return fInserted; }
+  const char *instructionSet() const { return fKernels.name; }
+
+  /**
+   * @brief Build the graph
+   * @param threads Number of inserting threads
+   * @param stop Polled between insertions; true abandons the build
+   * @return false if the build was abandoned
+   */
+  bool build(std::size_t threads, const std::function<bool()> &stop) {
+    // Levels are drawn up front so every neighbor list is allocated before
+    // the threads start
+    std::mt19937_64 random(fCount);
+    std::uniform_real_distribution<double> uniform(std::nextafter(0.0, 1.0), 1.0);
+    const double scale = 1.0 / std::log(double(kM));
+    fLevels.resize(fCount);
+    for (std::size_t id = 0; id < fCount; ++id) {
+      fLevels[id] = std::min(int(-std::log(uniform(random)) * scale), 15);
+    }
+    allocateLinks();
+    fNodeLocks = std::make_unique<std::mutex[]>(fCount);
+    fEntry = 0;
+    fMaxLevel = -1;
+    fInserted = 0;
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> abandoned{false};
+    auto worker = [&] {
+      for (std::size_t id; (id = next++) < fCount;) {
+        if (stop && stop()) {
+          abandoned = true;
+          return;
+        }
+        insert(id);
+        ++fInserted;
+      }
+    };
+    if (fCount > 0) {
+      insert(next++); // the first node becomes the entry point
+      ++fInserted;
+    }
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) {
+      pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+      thread.join();
+    }
+    fNodeLocks.reset();
+    return !abandoned;
+  }
+
+  /**
+   * @brief k nearest neighbors of a vector
+   * @param query Vector of dimension() floats
+   * @param k Number of neighbors
+   * @param ef Beam width (raised to k); larger is slower and more accurate
+   * @param exclude Node left out of the answer (e.g. the query row itself), or -1
+   * @return Neighbors, closest first
+   */
+  std::vector<Neighbor> search(const float *query, std::size_t k, std::size_t ef,
+                               int64_t exclude = -1) const {
+    if (fMaxLevel < 0 || k == 0) {
+      return {};
+    }
+    const float queryNorm = norm(query);
+    Neighbor current{distance(query, queryNorm, fEntry), fEntry};
+    for (int layer = fMaxLevel; layer > 0; --layer) {
+      current = greedy(query, queryNorm, current, layer, false);
+    }
+    std::size_t wanted = k + (exclude >= 0 ? 1 : 0);
+    std::vector<Neighbor> found = searchLayer(query, queryNorm, {current}, std::max(ef, wanted), 0, false);
+    found.erase(std::remove_if(found.begin(), found.end(),
+                               [exclude](const Neighbor &n) { return int64_t(n.id) == exclude; }),
+                found.end());
+    if (found.size() > k) {
+      found.resize(k);
+    }
+    return found;
+  }
+
+  /**
+   * @brief Write the graph to a file (atomically replaced)
+   * @param path Graph file
+   * @param tag Identifies the vector data; load() rejects a different tag
+   * @return false on I/O error
+   */
+  bool save(const std::string &path, uint64_t tag) const {
+    std::string temporary = path + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    uint64_t header[6] = {fCount, fDim, uint64_t(fMetric), tag, fEntry, uint64_t(int64_t(fMaxLevel))};
+    std::fwrite(kGraphMagic, 1, sizeof(kGraphMagic), file);
+    std::fwrite(header, sizeof(uint64_t), 6, file);
+    std::fwrite(fLevels.data(), 1, fLevels.size(), file);
+    std::fwrite(fLinks0.data(), sizeof(uint32_t), fLinks0.size(), file);
+    for (const auto &upper : fUpperLinks) {
+      std::fwrite(upper.data(), sizeof(uint32_t), upper.size(), file);
+    }
+    bool ok = std::ferror(file) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Read a graph written by save() for the same vectors
+   * @param path Graph file
+   * @param tag Expected tag
+   * @return false if the file is missing, corrupt or does not match
+   */
+  bool load(const std::string &path, uint64_t tag) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+      return false;
+    }
+    const std::size_t size = st.st_size;
+    const char *p = static_cast<const char *>(map);
+    const char *end = p + size;
+    auto take = [&](void *out, std::size_t bytes) {
+      if (static_cast<std::size_t>(end - p) < bytes) {
+        return false;
+      }
+      std::memcpy(out, p, bytes);
+      p += bytes;
+      return true;
+    };
+
+    char magic[sizeof(kGraphMagic)];
+    uint64_t header[6];
+    bool ok = take(magic, sizeof(magic)) && std::memcmp(magic, kGraphMagic, sizeof(magic)) == 0 &&
+              take(header, sizeof(header)) && header[0] == fCount && header[1] == fDim &&
+              header[2] == uint64_t(fMetric) && header[3] == tag &&
+              (fCount == 0 || header[4] < fCount);
+    if (ok) {
+      fLevels.resize(fCount);
+      ok = take(fLevels.data(), fLevels.size());
+    }
+    if (ok) {
+      allocateLinks();
+      ok = take(fLinks0.data(), fLinks0.size() * sizeof(uint32_t));
+      for (std::size_t id = 0; ok && id < fCount; ++id) {
+        ok = take(fUpperLinks[id].data(), fUpperLinks[id].size() * sizeof(uint32_t));
+      }
+      ok = ok && p == end && (fCount == 0 || int64_t(header[5]) == fLevels[header[4]]);
+    }
+    // Reject out-of-range links rather than trust the file
+    for (std::size_t id = 0; ok && id < fCount; ++id) {
+      for (int level = 0; ok && level <= fLevels[id]; ++level) {
+        const uint32_t *list = links(id, level);
+        ok = list[0] <= (level == 0 ? kM0 : kM) &&
+             std::all_of(list + 1, list + 1 + list[0], [this](uint32_t n) { return n < fCount; });
+      }
+    }
+    munmap(map, size);
+    if (!ok) {
+      fLevels.clear();
+      fLinks0.clear();
+      fUpperLinks.clear();
+      return false;
+    }
+    fEntry = header[4];
+    fMaxLevel = int(int64_t(header[5]));
+    fInserted = fCount;
+    return true;
+  }
+};
@@ -0,0 +1,554 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mcpJson.hh"
+
+// ============================================================================
+// JSON Query Expressions
+// ============================================================================
+
+/**
+ * @brief jq-like paths and filters evaluated on JSON records
+ *
+ * Paths: "." (the record), ".name", ."quoted key", "[2]", "[]" (every
+ * element), chained as in ".items[].price". Filters combine comparisons
+ * with "and", "or", "not" and parentheses:
+ *
+ *     .status == "active" and (.age >= 18 or .tags contains "vip")
+ *
+ * Operators are == != < <= > >= and "contains" (substring of a string or
+ * element of an array); a path alone tests that it exists and is neither
+ * null nor false. A path reaching several values ("[]") satisfies a
+ * comparison if any of them does.
+ */
+namespace jsonQuery {
+
+/// One step of a path
+struct Segment {
+  enum class Kind { Key, Index, Each } kind;
+  std::string key;        ///< For Key
+  std::size_t index = 0;  ///< For Index
+};
+
+using Path = std::vector<Segment>;
+
+/// Text form of a path, as accepted by Parser
+inline std::string toString(const Path &path) {
+  std::string text;
+  for (const Segment &segment : path) {
+    if (segment.kind == Segment::Kind::Key) {
+      bool plain = !segment.key.empty() &&
+                   std::all_of(segment.key.begin(), segment.key.end(), [](char c) {
+                     return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+                   });
+      text += plain ? "." + segment.key : "." + json(segment.key).dump();
+    } else if (segment.kind == Segment::Kind::Index) {
+      text += "[" + std::to_string(segment.index) + "]";
+    } else {
+      text += "[]";
+    }
+  }
+  return text.empty() ? "." : text;
+}
+
+/// Filter syntax tree
+struct Filter {
+  enum class Kind { Or, And, Not, Test, Compare } kind;
+  std::unique_ptr<Filter> left;   ///< Or, And, Not
+  std::unique_ptr<Filter> right;  ///< Or, And
+  Path path;                      ///< Test, Compare
+  std::string op;                 ///< Compare
+  json literal;                   ///< Compare
+};
+
+/**
+ * @brief Recursive descent parser for paths and filters
+ */
+class Parser {
+private:
+  const std::string &fText;
+  std::size_t fPos = 0;
+
+  [[noreturn]] void fail(const std::string &message) const {
+    throw std::invalid_argument("Invalid expression at position " + std::to_string(fPos) +
+                                ": " + message + " in '" + fText + "'");
+  }
+
+  void skipSpaces() {
+    while (fPos < fText.size() && std::isspace(static_cast<unsigned char>(fText[fPos]))) {
+      ++fPos;
+    }
+  }
+
+  bool peek(char c) {
+    skipSpaces();
+    return fPos < fText.size() && fText[fPos] == c;
+  }
+
+  // Consume a keyword if it is next, as a whole word
+  bool keyword(const char *word) {
+    skipSpaces();
+    std::size_t length = std::strlen(word);
+    if (fText.compare(fPos, length, word) != 0) {
+      return false;
+    }
+    std::size_t end = fPos + length;
+    if (end < fText.size() && (std::isalnum(static_cast<unsigned char>(fText[end])) || fText[end] == '_')) {
+      return false;
+    }
+    fPos = end;
+    return true;
+  }
+
+  std::string quoted() {
+    std::size_t start = fPos++;
+    while (fPos < fText.size() && fText[fPos] != '"') {
+      fPos += fText[fPos] == '\\' ? 2 : 1;
+    }
+    if (fPos >= fText.size()) {
+      fail("unterminated string");
+    }
+    ++fPos;
+    return json::parse(fText.substr(start, fPos - start)).get<std::string>();
+  }
+
+  void bracket(Path &path) {
+    ++fPos; // '['
+    skipSpaces();
+    if (peek(']')) {
+      path.push_back({Segment::Kind::Each, "", 0});
+    } else if (peek('"')) {
+      path.push_back({Segment::Kind::Key, quoted(), 0});
+    } else {
+      std::size_t start = fPos;
+      while (fPos < fText.size() && std::isdigit(static_cast<unsigned char>(fText[fPos]))) {
+        ++fPos;
+      }
+      if (start == fPos) {
+        fail("expected an index");
+      }
+      path.push_back({Segment::Kind::Index, "", std::stoul(fText.substr(start, fPos - start))});
+    }
+    if (!peek(']')) {
+      fail("expected ']'");
+    }
+    ++fPos;
+  }
+
+  json literal() {
+    skipSpaces();
+    if (peek('"')) {
+      return quoted();
+    }
+    for (const char *word : {"true", "false", "null"}) {
+      if (keyword(word)) {
+        return json::parse(word);
+      }
+    }
+    std::size_t start = fPos;
+    while (fPos < fText.size() && std::strchr("+-.0123456789eE", fText[fPos]) != nullptr) {
+      ++fPos;
+    }
+    if (start == fPos) {
+      fail("expected a literal");
+    }
+    try {
+      return json::parse(fText.substr(start, fPos - start));
+    } catch (const json::exception &) {
+      fail("invalid number");
+    }
+  }
+
+  std::unique_ptr<Filter> primary() {
+    if (keyword("not")) {
+      auto node = std::make_unique<Filter>(Filter{Filter::Kind::Not, primary(), nullptr, {}, "", {}});
+      return node;
+    }
+    if (peek('(')) {
+      ++fPos;
+      auto node = disjunction();
+      if (!peek(')')) {
+        fail("expected ')'");
+      }
+      ++fPos;
+      return node;
+    }
+    auto node = std::make_unique<Filter>(Filter{Filter::Kind::Test, nullptr, nullptr, path(), "", {}});
+    skipSpaces();
+    for (const char *op : {"==", "!=", "<=", ">=", "<", ">"}) {
+      if (fText.compare(fPos, std::strlen(op), op) == 0) {
+        fPos += std::strlen(op);
+        node->op = op;
+        break;
+      }
+    }
+    if (node->op.empty() && keyword("contains")) {
+      node->op = "contains";
+    }
+    if (!node->op.empty()) {
+      node->kind = Filter::Kind::Compare;
+      node->literal = literal();
+    }
+    return node;
+  }
+
+  std::unique_ptr<Filter> conjunction() {
+    auto node = primary();
+    while (keyword("and")) {
+      node = std::make_unique<Filter>(Filter{Filter::Kind::And, std::move(node), primary(), {}, "", {}});
+    }
+    return node;
+  }
+
+  std::unique_ptr<Filter> disjunction() {
+    auto node = conjunction();
+    while (keyword("or")) {
+      node = std::make_unique<Filter>(Filter{Filter::Kind::Or, std::move(node), conjunction(), {}, "", {}});
+    }
+    return node;
+  }
+
+public:
+  explicit Parser(const std::string &text) : fText(text) {}
+
+  /// Parse one path at the current position
+  Path path() {
+    skipSpaces();
+    if (!peek('.')) {
+      fail("expected a path starting with '.'");
+    }
+    Path result;
+    while (fPos < fText.size()) {
+      if (fText[fPos] == '.') {
+        ++fPos;
+        if (fPos < fText.size() && fText[fPos] == '"') {
+          result.push_back({Segment::Kind::Key, quoted(), 0});
+        } else if (fPos < fText.size() && fText[fPos] == '[') {
+          bracket(result);
+        } else {
+          std::size_t start = fPos;
+          while (fPos < fText.size() && (std::isalnum(static_cast<unsigned char>(fText[fPos])) || fText[fPos] == '_')) {
+            ++fPos;
+          }
+          if (start < fPos) {
+            result.push_back({Segment::Kind::Key, fText.substr(start, fPos - start), 0});
+          } else if (!result.empty()) {
+            fail("expected a key");
+          }
+        }
+      } else if (fText[fPos] == '[') {
+        bracket(result);
+      } else {
+        break;
+      }
+    }
+    return result;
+  }
+
+  /// Parse a whole filter
+  std::unique_ptr<Filter> filter() {
+    auto node = disjunction();
+    skipSpaces();
+    if (fPos != fText.size()) {
+      fail("unexpected text");
+    }
+    return node;
+  }
+
+  /// Parse a comma-separated list of paths
+  std::vector<Path> paths() {
+    std::vector<Path> result{path()};
+    while (peek(',')) {
+      ++fPos;
+      result.push_back(path());
+    }
+    skipSpaces();
+    if (fPos != fText.size()) {
+      fail("unexpected text");
+    }
+    return result;
+  }
+};
+
+/**
+ * @brief Values reached by a path
+ * @param node Record (or part of it)
+ * @param path Path to follow
+ * @param out Receives pointers into node
+ */
+inline void collect(const json &node, const Path &path, std::vector<const json *> &out,
+                    std::size_t step = 0) {
+  if (step == path.size()) {
+    out.push_back(&node);
+    return;
+  }
+  const Segment &segment = path[step];
+  if (segment.kind == Segment::Kind::Key) {
+    if (node.is_object()) {
+      auto found = node.find(segment.key);
+      if (found != node.end()) {
+        collect(*found, path, out, step + 1);
+      }
+    }
+  } else if (node.is_array()) {
+    if (segment.kind == Segment::Kind::Each) {
+      for (const json &element : node) {
+        collect(element, path, out, step + 1);
+      }
+    } else if (segment.index < node.size()) {
+      collect(node[segment.index], path, out, step + 1);
+    }
+  }
+}
+
+inline bool compare(const json &value, const std::string &op, const json &literal) {
+  if (op == "==") {
+    return value == literal;
+  }
+  if (op == "!=") {
+    return value != literal;
+  }
+  if (op == "contains") {
+    if (value.is_string() && literal.is_string()) {
+      return value.get_ref<const std::string &>().find(literal.get_ref<const std::string &>()) !=
+             std::string::npos;
+    }
+    return value.is_array() && std::find(value.begin(), value.end(), literal) != value.end();
+  }
+  // Ordering only between numbers or between strings
+  bool comparable = (value.is_number() && literal.is_number()) || (value.is_string() && literal.is_string());
+  if (!comparable) {
+    return false;
+  }
+  if (op == "<") {
+    return value < literal;
+  }
+  if (op == "<=") {
+    return value <= literal;
+  }
+  if (op == ">") {
+    return value > literal;
+  }
+  return value >= literal;
+}
+
+/**
+ * @brief Evaluate a filter on a record
+ */
+inline bool matches(const Filter &filter, const json &record) {
+  switch (filter.kind) {
+  case Filter::Kind::Or:
+    return matches(*filter.left, record) || matches(*filter.right, record);
+  case Filter::Kind::And:
+    return matches(*filter.left, record) && matches(*filter.right, record);
+  case Filter::Kind::Not:
+    return !matches(*filter.left, record);
+  default:
+    break;
+  }
+  std::vector<const json *> values;
+  collect(record, filter.path, values);
+  for (const json *value : values) {
+    if (filter.kind == Filter::Kind::Test ? !(value->is_null() || *value == false)
+                                          : compare(*value, filter.op, filter.literal)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Every path a filter reads
+ */
+inline void filterPaths(const Filter &filter, std::vector<Path> &out) {
+  if (filter.kind == Filter::Kind::Test || filter.kind == Filter::Kind::Compare) {
+    out.push_back(filter.path);
+  }
+  if (filter.left) {
+    filterPaths(*filter.left, out);
+  }
+  if (filter.right) {
+    filterPaths(*filter.right, out);
+  }
+}
+
+/**
+ * @brief SAX handler building a sparse copy of a record
+ *
+ * Only the values on or below the wanted paths are materialized; the rest
+ * of the record is tokenized by the parser but never turned into json
+ * values. Array elements before a wanted index are kept as nulls so
+ * indices still match. With a record depth of 1 the input is an array whose
+ * elements are the records, and onRecord is called for each of them.
+ */
+class SparseRecordBuilder {
+public:
+  using RecordCallback = std::function<bool(json &record)>;
+
+private:
+  enum class Mode { Capture, Descend };
+
+  struct Frame {
+    json *container;        ///< Object or array being filled (nullptr for the outer array)
+    bool isArray;
+    std::size_t nextIndex;  ///< Index of the next element (arrays)
+    std::string key;        ///< Key of the next member (objects)
+    Mode mode;
+  };
+
+  const std::vector<Path> &fWanted;
+  std::size_t fRecordDepth;
+  RecordCallback fOnRecord;
+  json fRecord;
+  std::vector<Frame> fStack;
+  std::size_t fSkip = 0;  ///< Depth inside a container that is not kept
+
+  // Whether the actual path of the next value matches a wanted path, or a prefix of one
+  bool segmentMatches(const Segment &segment, const Frame &frame) const {
+    switch (segment.kind) {
+    case Segment::Kind::Key:
+      return !frame.isArray && frame.key == segment.key;
+    case Segment::Kind::Index:
+      return frame.isArray && frame.nextIndex == segment.index;
+    default:
+      return frame.isArray;
+    }
+  }
+
+  // What to do with the next value: capture it, descend into it, or skip it
+  int classify() const {
+    if (fSkip > 0) {
+      return -1;
+    }
+    if (fStack.size() > fRecordDepth && fStack.back().mode == Mode::Capture) {
+      return int(Mode::Capture);
+    }
+    const std::size_t depth = fStack.size() - fRecordDepth; // segments of the next value's path
+    bool descend = false;
+    for (const Path &wanted : fWanted) {
+      std::size_t common = std::min(depth, wanted.size());
+      bool prefix = true;
+      for (std::size_t i = 0; i < common && prefix; ++i) {
+        prefix = segmentMatches(wanted[i], fStack[fRecordDepth + i]);
+      }
+      if (prefix && depth >= wanted.size()) {
+        return int(Mode::Capture);
+      }
+      descend = descend || prefix;
+    }
+    return descend ? int(Mode::Descend) : -1;
+  }
+
+  // Slot for the next value in the current container
+  json *slot() {
+    if (fStack.size() == fRecordDepth) {
+      fRecord = json();
+      return &fRecord;
+    }
+    Frame &frame = fStack.back();
+    if (frame.isArray) {
+      while (frame.container->size() <= frame.nextIndex) {
+        frame.container->push_back(nullptr);
+      }
+      return &(*frame.container)[frame.nextIndex];
+    }
+    return &(*frame.container)[frame.key];
+  }
+
+  // A value just completed at the current level
+  bool completed() {
+    if (fStack.size() == fRecordDepth) {
+      return fOnRecord ? fOnRecord(fRecord) : true;
+    }
+    if (fStack.back().isArray) {
+      ++fStack.back().nextIndex;
+    }
+    return true;
+  }
+
+  bool scalar(json &&value) {
+    if (fSkip == 0 && classify() == int(Mode::Capture)) {
+      *slot() = std::move(value);
+    }
+    return fSkip > 0 || completed();
+  }
+
+  bool open(bool isArray) {
+    if (fStack.size() < fRecordDepth) {
+      // The outer array holding the records
+      fStack.push_back({nullptr, true, 0, "", Mode::Descend});
+      return true;
+    }
+    int mode = classify();
+    if (mode < 0) {
+      ++fSkip;
+      return true;
+    }
+    json *container = slot();
+    *container = isArray ? json::array() : json::object();
+    fStack.push_back({container, isArray, 0, "", Mode(mode)});
+    return true;
+  }
+
+  bool close() {
+    if (fSkip > 0) {
+      return --fSkip > 0 || completed();
+    }
+    fStack.pop_back();
+    return fStack.size() < fRecordDepth || completed();
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param wanted Paths to materialize (an empty path keeps whole records)
+   * @param recordDepth 0: the input is one record; 1: an array of records
+   * @param onRecord Called for each record when recordDepth is 1; returns false to stop
+   */
+  SparseRecordBuilder(const std::vector<Path> &wanted, std::size_t recordDepth,
+                      RecordCallback onRecord = nullptr)
+      : fWanted(wanted), fRecordDepth(recordDepth), fOnRecord(std::move(onRecord)) {}
+
+  /// The record built by the last parse (recordDepth 0)
+  json &record() { return fRecord; }
+
+  /// Reset before parsing another input
+  void reset() {
+    fRecord = json();
+    fStack.clear();
+    fSkip = 0;
+  }
+
+  // nlohmann::json SAX interface
+  bool null() { return scalar(nullptr); }
+  bool boolean(bool value) { return scalar(value); }
+  bool number_integer(json::number_integer_t value) { return scalar(value); }
+  bool number_unsigned(json::number_unsigned_t value) { return scalar(value); }
+  bool number_float(json::number_float_t value, const std::string &) { return scalar(value); }
+  bool string(std::string &value) { return scalar(std::move(value)); }
+  bool binary(json::binary_t &) { return scalar(nullptr); }
+  bool start_object(std::size_t) { return open(false); }
+  bool end_object() { return close(); }
+  bool start_array(std::size_t) { return open(true); }
+  bool end_array() { return close(); }
+  bool key(std::string &key) {
+    if (fSkip == 0) {
+      fStack.back().key = std::move(key);
+    }
+    return true;
+  }
+  bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) {
+    return false;
+  }
+};
+
+} // namespace jsonQuery
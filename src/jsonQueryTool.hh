@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mcpJson.hh"
+#include "jsonQuery.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool filtering and projecting the records of JSON files
+ *
+ * JSON Lines files (one record per line) are memory-mapped and split into
+ * line-aligned chunks scanned by several threads. A .json file holds one
+ * record, or an array of records, and is scanned by one thread. Records
+ * are parsed with a SAX handler that only materializes the fields read by
+ * the "where" filter and the "select" paths (see jsonQuery.hh). Each
+ * matching record is returned as one content item.
+ */
+class JsonQueryTool : public McpTool {
+private:
+  static constexpr std::size_t kMinChunk = 1 << 20;     ///< Smallest per-thread chunk
+  static constexpr std::size_t kCancelCheckLines = 4096;
+
+  struct Query {
+    std::vector<jsonQuery::Path> select;     ///< Projected paths (empty path: whole record)
+    std::unique_ptr<jsonQuery::Filter> where;
+    std::vector<jsonQuery::Path> wanted;     ///< Paths the parser materializes
+    std::size_t maxResults = 100;
+    bool countOnly = false;
+  };
+
+  /// Results of one chunk of lines
+  struct Chunk {
+    const char *begin;
+    const char *end;
+    std::vector<std::pair<std::size_t, std::string>> matches; ///< Local record number, text
+    std::size_t records = 0;   ///< Lines scanned
+    std::size_t matched = 0;
+    std::size_t invalid = 0;
+  };
+
+  SandboxRoot fRoot; ///< Directory readable by the tool
+
+  static json project(const Query &query, const json &record) {
+    if (query.select.size() == 1) {
+      const jsonQuery::Path &path = query.select[0];
+      std::vector<const json *> values;
+      jsonQuery::collect(record, path, values);
+      bool many = std::any_of(path.begin(), path.end(), [](const jsonQuery::Segment &segment) {
+        return segment.kind == jsonQuery::Segment::Kind::Each;
+      });
+      if (!many) {
+        return values.empty() ? json() : *values[0];
+      }
+      json result = json::array();
+      for (const json *value : values) {
+        result.push_back(*value);
+      }
+      return result;
+    }
+    json result = json::object();
+    for (const jsonQuery::Path &path : query.select) {
+      std::vector<const json *> values;
+      jsonQuery::collect(record, path, values);
+      result[jsonQuery::toString(path)] = values.empty() ? json() : *values[0];
+    }
+    return result;
+  }
+
+  // Returns false when the result limit is reached
+  static bool consider(const Query &query, json &record, std::size_t number, Chunk &chunk) {
+    if (query.where && !jsonQuery::matches(*query.where, record)) {
+      return true;
+    }
+    ++chunk.matched;
+    if (query.countOnly) {
+      return true;
+    }
+    chunk.matches.emplace_back(number, project(query, record).dump(-1, ' ', false, json::error_handler_t::replace));
+    return chunk.matches.size() < query.maxResults;
+  }
+
+  static void scanLines(const Query &query, Chunk &chunk, std::size_t index,
+                        std::atomic<std::size_t> &firstFull, const McpCancellation &cancellation) {
+    jsonQuery::SparseRecordBuilder builder(query.wanted, 0);
+    const char *line = chunk.begin;
+    while (line < chunk.end) {
+      const char *next = static_cast<const char *>(std::memchr(line, '\n', chunk.end - line));
+      const char *lineEnd = next ? next : chunk.end;
+      std::size_t number = chunk.records++;
+      if (number % kCancelCheckLines == 0 && (cancellation.requested() || firstFull < index)) {
+        return; // cancelled, or an earlier chunk already holds enough matches
+      }
+      const char *first = line;
+      while (first < lineEnd && std::isspace(static_cast<unsigned char>(*first))) {
+        ++first;
+      }
+      if (first < lineEnd) {
+        builder.reset();
+        if (!json::sax_parse(first, lineEnd, &builder)) {
+          ++chunk.invalid;
+        } else if (!consider(query, builder.record(), number, chunk)) {
+          for (std::size_t full = firstFull; index < full && !firstFull.compare_exchange_weak(full, index);) {
+          }
+          return;
+        }
+      }
+      line = lineEnd + 1;
+    }
+  }
+
+  static void scanDocument(const Query &query, Chunk &chunk) {
+    const char *first = chunk.begin;
+    while (first < chunk.end && std::isspace(static_cast<unsigned char>(*first))) {
+      ++first;
+    }
+    bool array = first < chunk.end && *first == '[';
+    jsonQuery::SparseRecordBuilder builder(query.wanted, array ? 1 : 0, [&](json &record) {
+      return consider(query, record, chunk.records++, chunk);
+    });
+    bool complete = json::sax_parse(first, chunk.end, &builder);
+    if (!array) {
+      chunk.records = 1;
+      if (!complete) {
+        throw std::runtime_error("Invalid JSON document");
+      }
+      consider(query, builder.record(), 0, chunk);
+    } else if (!complete && (query.countOnly || chunk.matches.size() < query.maxResults)) {
+      throw std::runtime_error("Invalid JSON document after record " + std::to_string(chunk.records));
+    }
+  }
+
+  static bool hasSuffix(const std::string &text, const char *suffix) {
+    std::size_t length = std::strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param root Directory the tool is allowed to read
+   */
+  explicit JsonQueryTool(const std::string &root) : fRoot(root) {}
+
+  std::string name() const override { return "JsonQueryTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Filter and project the records of a JSON Lines file (or of a .json "
+                        "file holding a record or an array of records) with jq-like paths"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"path", {{"type", "string"}, {"description", "File path, relative to the tool root"}}},
+            {"where", {{"type", "string"}, {"description", "Filter, e.g. '.status == \"open\" and (.size > 10 or .tags contains \"urgent\")'"}}},
+            {"select", {{"type", "string"}, {"description", "Comma-separated paths to return, e.g. '.id, .user.name, .items[].sku' (default: whole records)"}}},
+            {"count", {{"type", "boolean"}, {"description", "Only return the number of matching records"}}},
+            {"maxResults", {{"type", "integer"}, {"description", "Maximum number of records returned (default: 100)"}}}}},
+          {"required", json::array({"path"})}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    std::string relative = arguments.value("path", "");
+    std::string path = fRoot.resolve(relative);
+
+    Query query;
+    std::string select = arguments.value("select", "");
+    query.select = select.empty() ? std::vector<jsonQuery::Path>{{}} : jsonQuery::Parser(select).paths();
+    std::string where = arguments.value("where", "");
+    if (!where.empty()) {
+      query.where = jsonQuery::Parser(where).filter();
+    }
+    query.wanted = query.select;
+    if (query.where) {
+      jsonQuery::filterPaths(*query.where, query.wanted);
+    }
+    query.countOnly = arguments.value("count", false);
+    query.maxResults = std::max<int64_t>(1, arguments.value("maxResults", int64_t(100)));
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::invalid_argument("Not a readable file: " + relative);
+    }
+    std::size_t size = st.st_size;
+    void *map = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    close(fd);
+    if (map == MAP_FAILED) {
+      throw std::runtime_error("Cannot map file: " + relative);
+    }
+    std::unique_ptr<void, std::function<void(void *)>> unmap(map, [size](void *p) {
+      if (p != nullptr) {
+        munmap(p, size);
+      }
+    });
+    const char *data = static_cast<const char *>(map);
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    // Line-aligned chunks, one per thread
+    std::vector<Chunk> chunks;
+    bool document = hasSuffix(relative, ".json");
+    std::size_t threads = document ? 1
+                                   : std::clamp<std::size_t>(size / kMinChunk, 1,
+                                                             std::clamp(std::thread::hardware_concurrency(), 1u, 8u));
+    const char *begin = data;
+    for (std::size_t i = 0; i < threads && begin < data + size; ++i) {
+      const char *end = i + 1 == threads ? data + size : data + size * (i + 1) / threads;
+      if (end < begin) {
+        end = begin;
+      }
+      const char *newline = static_cast<const char *>(std::memchr(end, '\n', data + size - end));
+      end = newline ? newline + 1 : data + size;
+      chunks.push_back({begin, end, {}, 0, 0, 0});
+      begin = end;
+    }
+
+    McpCancellation cancellation = currentCancellation();
+    if (document) {
+      scanDocument(query, chunks[0]);
+    } else {
+      std::atomic<std::size_t> firstFull{SIZE_MAX};
+      std::vector<std::thread> pool;
+      for (std::size_t i = 1; i < chunks.size(); ++i) {
+        pool.emplace_back([&, i] { scanLines(query, chunks[i], i, firstFull, cancellation); });
+      }
+      if (!chunks.empty()) {
+        scanLines(query, chunks[0], 0, firstFull, cancellation);
+      }
+      for (auto &thread : pool) {
+        thread.join();
+      }
+    }
+    if (cancellation.requested()) {
+      throw std::runtime_error("Cancelled");
+    }
+
+    // Chunks in file order: a chunk's matches only count once the chunks
+    // before it were scanned completely
+    json content = json::array();
+    std::size_t returned = 0;
+    std::size_t matched = 0;
+    std::size_t invalid = 0;
+    std::size_t firstRecord = 1;
+    bool truncated = false;
+    for (const Chunk &chunk : chunks) {
+      matched += chunk.matched;
+      invalid += chunk.invalid;
+      for (const auto &[number, text] : chunk.matches) {
+        if (returned == query.maxResults) {
+          truncated = true;
+          break;
+        }
+        content.push_back(textItem((document ? "record " : "line ") + std::to_string(firstRecord + number) + ": " + text));
+        ++returned;
+      }
+      // A chunk holding maxResults matches stopped scanning early
+      truncated = truncated || chunk.matches.size() >= query.maxResults;
+      if (truncated) {
+        break;
+      }
+      firstRecord += chunk.records;
+    }
+
+    std::string summary;
+    if (query.countOnly) {
+      summary = std::to_string(matched) + " matching records";
+    } else if (returned == 0) {
+      summary = "No matches";
+    } else if (truncated) {
+      summary = "Results limited to " + std::to_string(query.maxResults) + " records";
+    }
+    if (invalid > 0) {
+      summary += (summary.empty() ? "" : " (") + std::to_string(invalid) + " invalid lines skipped" +
+                 (summary.empty() ? "" : ")");
+    }
+    if (!summary.empty()) {
+      content.push_back(textItem(summary));
+    }
+    return content;
+  }
+};
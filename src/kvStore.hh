@@ -0,0 +1,675 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checksum.hh"
+
+// ============================================================================
+// Key-Value Store
+// ============================================================================
+
+/**
+ * @brief Persistent string key-value store with a log-structured backend
+ *
+ * Every update is appended to a log file as a record checksummed with
+ * CRC-32C; an in-memory hash index maps each live key to the offset of its
+ * value in the log, so a lookup is one hash probe and one pread() of a page
+ * cache resident value.
+ *
+ * A background thread group-commits the log: updates asking for
+ * durability wait for the next fdatasync(), which covers every update
+ * written before it started, and other updates are synced at least every
+ * second. The same thread compacts the log once most of it is garbage
+ * (live records are copied to a new log, writers only wait while the
+ * records appended meanwhile are copied) and writes snapshots of the index.
+ *
+ * On open, the index is rebuilt from the snapshot, memory-mapped and read
+ * without touching the values, then from the log records appended after
+ * it. A torn record at the end of the log (crash during a write) is
+ * truncated.
+ */
+class KvStore {
+public:
+  struct Stats {
+    std::size_t keys;
+    uint64_t logBytes;       ///< Size of the log file
+    uint64_t liveBytes;      ///< Bytes of the records of live keys
+    uint64_t compactions;    ///< Since open
+    bool fromSnapshot;       ///< Index recovered from a snapshot on open
+    uint64_t replayedBytes;  ///< Log bytes replayed on open
+  };
+
+  static constexpr std::size_t kMaxKeySize = 4096;
+  static constexpr std::size_t kMaxValueSize = 16 << 20;
+
+private:
+  static constexpr char kLogMagic[8] = {'M', 'C', 'P', 'K', 'V', 'L', 'O', 'G'};
+  static constexpr char kIndexMagic[8] = {'M', 'C', 'P', 'K', 'V', 'I', 'D', 'X'};
+  static constexpr uint64_t kLogHeaderSize = 16;      ///< Magic, generation
+  static constexpr uint64_t kRecordHeaderSize = 13;   ///< CRC, key size, value size, type
+  static constexpr uint64_t kIndexHeaderSize = 40;    ///< Magic, generation, log end, count, live bytes
+  static constexpr uint64_t kCompactMinGarbage = 1 << 20;
+  static constexpr uint64_t kSnapshotEveryBytes = 8 << 20;  ///< Log growth between snapshots
+  static constexpr std::size_t kCopyBuffer = 1 << 20;
+  static constexpr std::chrono::milliseconds kSyncInterval{1000};
+
+  enum class RecordType : uint8_t { Put = 0, Delete = 1 };
+
+  /// Position of a live value in the log
+  struct Location {
+    uint64_t value;    ///< Offset of the value bytes
+    uint32_t size;     ///< Value size
+    uint32_t record;   ///< Size of the whole record
+  };
+
+  using Index = std::unordered_map<std::string, Location>;
+
+  std::string fDirectory;
+  std::string fLogPath;
+  std::string fIndexPath;
+
+  mutable std::shared_mutex fMutex;  ///< Protects the fields below
+  Index fIndex;
+  int fFd = -1;                      ///< Log file
+  uint64_t fGeneration = 0;          ///< Identifies the log file (changes on compaction)
+  uint64_t fEnd = 0;                 ///< Log size
+  uint64_t fLiveBytes = 0;
+  uint64_t fCompactions = 0;
+
+  // Group commit
+  std::mutex fSyncMutex;             ///< Protects fSyncedSequence, fRequested and fStopping
+  std::condition_variable fSyncWake; ///< Wakes the background thread
+  std::condition_variable fSynced;   ///< Signals completed syncs
+  std::atomic<uint64_t> fWritten{0}; ///< Sequence number of the last write
+  uint64_t fSyncedSequence = 0;      ///< Writes up to this sequence are durable
+  uint64_t fRequested = 0;           ///< Highest sequence a writer waits for
+  bool fStopping = false;
+  std::thread fBackground;
+
+  // Background thread only
+  uint64_t fSnapshotEnd = 0;         ///< Log end covered by the last snapshot
+  bool fFromSnapshot = false;
+  uint64_t fReplayedBytes = 0;
+
+  // --------------------------------------------------------------------------
+  // Encoding
+  // --------------------------------------------------------------------------
+
+  template <typename T>
+  static void pack(std::string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template <typename T>
+  static T unpack(const char *in) {
+    T value;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+  }
+
+  static void appendRecord(std::string &out, RecordType type, std::string_view key, std::string_view value) {
+    std::size_t start = out.size();
+    pack<uint32_t>(out, 0); // CRC, filled below
+    pack<uint32_t>(out, key.size());
+    pack<uint32_t>(out, value.size());
+    pack<uint8_t>(out, static_cast<uint8_t>(type));
+    out.append(key);
+    out.append(value);
+    uint32_t crc = checksum::crc32c(out.data() + start + 4, out.size() - start - 4);
+    std::memcpy(&out[start], &crc, sizeof(crc));
+  }
+
+  /**
+   * Decode the records in [data, data + size), whose first byte is at log
+   * offset 'base'; calls visit(type, key, location) for each. Returns the
+   * size of the valid prefix: decoding stops at a torn or corrupt record.
+   */
+  template <typename Visit>
+  static uint64_t decodeRecords(const char *data, uint64_t size, uint64_t base, Visit visit) {
+    uint64_t p = 0;
+    while (size - p >= kRecordHeaderSize) {
+      uint32_t crc = unpack<uint32_t>(data + p);
+      uint32_t keySize = unpack<uint32_t>(data + p + 4);
+      uint32_t valueSize = unpack<uint32_t>(data + p + 8);
+      uint8_t type = unpack<uint8_t>(data + p + 12);
+      uint64_t record = kRecordHeaderSize + uint64_t(keySize) + valueSize;
+      if (keySize > kMaxKeySize || valueSize > kMaxValueSize || type > 1 || size - p < record ||
+          checksum::crc32c(data + p + 4, record - 4) != crc) {
+        break;
+      }
+      std::string_view key(data + p + kRecordHeaderSize, keySize);
+      visit(static_cast<RecordType>(type), key,
+            Location{base + p + kRecordHeaderSize + keySize, valueSize, uint32_t(record)});
+      p += record;
+    }
+    return p;
+  }
+
+  static void apply(Index &index, uint64_t &liveBytes, RecordType type, std::string_view key,
+                    const Location &location) {
+    auto entry = index.find(std::string(key));
+    if (entry != index.end()) {
+      liveBytes -= entry->second.record;
+      if (type == RecordType::Delete) {
+        index.erase(entry);
+        return;
+      }
+      entry->second = location;
+    } else if (type == RecordType::Put) {
+      index.emplace(key, location);
+    } else {
+      return;
+    }
+    liveBytes += location.record;
+  }
+
+  static void writeAll(int fd, const char *data, std::size_t size, uint64_t offset) {
+    while (size > 0) {
+      ssize_t written = pwrite(fd, data, size, offset);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        throw std::runtime_error("Cannot write key-value log: " + std::string(strerror(errno)));
+      }
+      data += written;
+      size -= written;
+      offset += written;
+    }
+  }
+
+  static bool readAll(int fd, char *data, std::size_t size, uint64_t offset) {
+    while (size > 0) {
+      ssize_t count = pread(fd, data, size, offset);
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        return false;
+      }
+      data += count;
+      size -= count;
+      offset += count;
+    }
+    return true;
+  }
+
+  void syncDirectory() const {
+    int fd = open(fDirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+      fsync(fd);
+      close(fd);
+    }
+  }
+
+  static uint64_t newGeneration() {
+    std::random_device random;
+    return (uint64_t(random()) << 32) ^ random() ^
+           uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+  }
+
+  static std::string logHeader(uint64_t generation) {
+    std::string header(kLogMagic, sizeof(kLogMagic));
+    pack<uint64_t>(header, generation);
+    return header;
+  }
+
+  // --------------------------------------------------------------------------
+  // Recovery
+  // --------------------------------------------------------------------------
+
+  // Load the index snapshot if it matches the log; returns the log offset to replay from
+  uint64_t loadSnapshot(uint64_t logSize) {
+    int fd = open(fIndexPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return kLogHeaderSize;
+    }
+    struct stat st;
+    std::size_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    void *map = size >= kIndexHeaderSize + 4 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+      return kLogHeaderSize;
+    }
+    const char *data = static_cast<const char *>(map);
+    uint64_t logEnd = unpack<uint64_t>(data + 16);
+    uint64_t count = unpack<uint64_t>(data + 24);
+    bool valid = std::memcmp(data, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+                 unpack<uint64_t>(data + 8) == fGeneration && logEnd >= kLogHeaderSize && logEnd <= logSize &&
+                 unpack<uint32_t>(data + size - 4) == checksum::crc32c(data, size - 4);
+    Index index;
+    if (valid) {
+      index.reserve(count);
+      std::size_t p = kIndexHeaderSize;
+      for (uint64_t i = 0; i < count && valid; ++i) {
+        if (size - 4 - p < 20) {
+          valid = false;
+          break;
+        }
+        uint32_t keySize = unpack<uint32_t>(data + p);
+        Location location{unpack<uint64_t>(data + p + 12), unpack<uint32_t>(data + p + 4), unpack<uint32_t>(data + p + 8)};
+        p += 20;
+        valid = keySize <= size - 4 - p && location.value + location.size <= logEnd;
+        if (valid) {
+          index.emplace(std::string(data + p, keySize), location);
+          p += keySize;
+        }
+      }
+    }
+    uint64_t liveBytes = valid ? unpack<uint64_t>(data + 32) : 0;
+    munmap(map, size);
+    if (!valid) {
+      return kLogHeaderSize;
+    }
+    fIndex = std::move(index);
+    fLiveBytes = liveBytes;
+    fFromSnapshot = true;
+    fSnapshotEnd = logEnd;
+    return logEnd;
+  }
+
+  void recover() {
+    struct stat st;
+    if (fstat(fFd, &st) != 0) {
+      throw std::runtime_error("Cannot stat key-value log: " + fLogPath);
+    }
+    uint64_t size = st.st_size;
+    char header[kLogHeaderSize];
+    if (size < kLogHeaderSize) {
+      if (size > 0 && ftruncate(fFd, 0) != 0) {
+        throw std::runtime_error("Cannot truncate key-value log: " + fLogPath);
+      }
+      fGeneration = newGeneration();
+      std::string fresh = logHeader(fGeneration);
+      writeAll(fFd, fresh.data(), fresh.size(), 0);
+      fdatasync(fFd);
+      fEnd = kLogHeaderSize;
+      return;
+    }
+    if (!readAll(fFd, header, sizeof(header), 0) || std::memcmp(header, kLogMagic, sizeof(kLogMagic)) != 0) {
+      throw std::runtime_error("Not a key-value log: " + fLogPath);
+    }
+    fGeneration = unpack<uint64_t>(header + 8);
+
+    uint64_t start = loadSnapshot(size);
+    uint64_t valid = 0;
+    if (size > start) {
+      void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fFd, 0);
+      if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map key-value log: " + fLogPath);
+      }
+      madvise(map, size, MADV_SEQUENTIAL);
+      const char *data = static_cast<const char *>(map);
+      valid = decodeRecords(data + start, size - start, start,
+                            [&](RecordType type, std::string_view key, const Location &location) {
+                              apply(fIndex, fLiveBytes, type, key, location);
+                            });
+      munmap(map, size);
+    }
+    fReplayedBytes = valid;
+    fEnd = start + valid;
+    if (fEnd < size && ftruncate(fFd, fEnd) != 0) {
+      throw std::runtime_error("Cannot truncate the torn end of the key-value log: " + fLogPath);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Background work
+  // --------------------------------------------------------------------------
+
+  void saveSnapshot() {
+    std::string out(kIndexMagic, sizeof(kIndexMagic));
+    int fd;
+    uint64_t logEnd;
+    {
+      std::shared_lock<std::shared_mutex> lock(fMutex);
+      pack<uint64_t>(out, fGeneration);
+      pack<uint64_t>(out, fEnd);
+      pack<uint64_t>(out, fIndex.size());
+      pack<uint64_t>(out, fLiveBytes);
+      for (const auto &[key, location] : fIndex) {
+        pack<uint32_t>(out, key.size());
+        pack<uint32_t>(out, location.size);
+        pack<uint32_t>(out, location.record);
+        pack<uint64_t>(out, location.value);
+        out.append(key);
+      }
+      logEnd = fEnd;
+      fd = dup(fFd);
+    }
+    // The snapshot may only refer to durable log records
+    if (fd < 0 || fdatasync(fd) != 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+    close(fd);
+    pack<uint32_t>(out, checksum::crc32c(out.data(), out.size()));
+
+    std::string temporary = fIndexPath + ".tmp";
+    fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      return;
+    }
+    bool written = true;
+    try {
+      writeAll(fd, out.data(), out.size(), 0);
+    } catch (const std::exception &) {
+      written = false;
+    }
+    written = written && fdatasync(fd) == 0;
+    close(fd);
+    if (written && rename(temporary.c_str(), fIndexPath.c_str()) == 0) {
+      syncDirectory();
+      fSnapshotEnd = logEnd;
+    } else {
+      unlink(temporary.c_str());
+    }
+  }
+
+  bool needsCompaction() const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    uint64_t garbage = fEnd - kLogHeaderSize - fLiveBytes;
+    return garbage >= kCompactMinGarbage && garbage > fLiveBytes;
+  }
+
+  void compact() {
+    std::vector<std::pair<std::string, Location>> live;
+    uint64_t copied;
+    int source;
+    {
+      std::shared_lock<std::shared_mutex> lock(fMutex);
+      live.assign(fIndex.begin(), fIndex.end());
+      copied = fEnd;
+      source = dup(fFd);
+    }
+    if (source < 0) {
+      return;
+    }
+    std::string temporary = fLogPath + ".compact";
+    int target = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (target < 0) {
+      close(source);
+      return;
+    }
+    uint64_t generation = newGeneration();
+    Index index;
+    index.reserve(live.size());
+    uint64_t liveBytes = 0;
+    uint64_t end = 0;
+    std::string buffer = logHeader(generation);
+    std::string value;
+    try {
+      auto flush = [&] {
+        writeAll(target, buffer.data(), buffer.size(), end);
+        end += buffer.size();
+        buffer.clear();
+      };
+      auto append = [&](RecordType type, std::string_view key, std::string_view data) {
+        uint64_t offset = end + buffer.size();
+        appendRecord(buffer, type, key, data);
+        Location location{offset + kRecordHeaderSize + key.size(), uint32_t(data.size()),
+                          uint32_t(kRecordHeaderSize + key.size() + data.size())};
+        apply(index, liveBytes, type, key, location);
+        if (buffer.size() >= kCopyBuffer) {
+          flush();
+        }
+      };
+
+      // Copy the live records without blocking writers
+      for (const auto &[key, location] : live) {
+        value.resize(location.size);
+        if (!readAll(source, value.data(), value.size(), location.value)) {
+          throw std::runtime_error("short read");
+        }
+        append(RecordType::Put, key, value);
+      }
+      flush();
+      fdatasync(target);
+
+      // Copy the records appended meanwhile, then switch logs
+      std::unique_lock<std::shared_mutex> lock(fMutex);
+      std::string tail(fEnd - copied, '\0');
+      if (!readAll(source, tail.data(), tail.size(), copied)) {
+        throw std::runtime_error("short read");
+      }
+      decodeRecords(tail.data(), tail.size(), copied,
+                    [&](RecordType type, std::string_view key, const Location &location) {
+                      append(type, key, std::string_view(tail.data() + (location.value - copied), location.size));
+                    });
+      flush();
+      if (fdatasync(target) != 0 || rename(temporary.c_str(), fLogPath.c_str()) != 0) {
+        throw std::runtime_error("sync failed");
+      }
+      syncDirectory();
+      close(fFd);
+      fFd = target;
+      fIndex = std::move(index);
+      fLiveBytes = liveBytes;
+      fEnd = end;
+      fGeneration = generation;
+      ++fCompactions;
+      uint64_t durable = fWritten; // everything in the new log so far was synced
+      lock.unlock();
+
+      std::lock_guard<std::mutex> syncLock(fSyncMutex);
+      fSyncedSequence = std::max(fSyncedSequence, durable);
+      fSynced.notify_all();
+    } catch (const std::exception &) {
+      close(target);
+      unlink(temporary.c_str());
+      close(source);
+      return;
+    }
+    close(source);
+    fSnapshotEnd = 0;
+    saveSnapshot();
+  }
+
+  void background() {
+    std::unique_lock<std::mutex> lock(fSyncMutex);
+    while (!fStopping) {
+      fSyncWake.wait_for(lock, kSyncInterval, [this] { return fStopping || fRequested > fSyncedSequence; });
+      if (fStopping) {
+        break;
+      }
+      uint64_t target = fWritten;
+      if (target > fSyncedSequence) {
+        lock.unlock();
+        int fd;
+        {
+          std::shared_lock<std::shared_mutex> logLock(fMutex);
+          fd = dup(fFd);
+        }
+        if (fd >= 0) {
+          fdatasync(fd);
+          close(fd);
+        }
+        lock.lock();
+        fSyncedSequence = std::max(fSyncedSequence, target);
+        fSynced.notify_all();
+      }
+      if (fRequested > fSyncedSequence) {
+        continue; // more writers arrived during the sync
+      }
+
+      lock.unlock();
+      if (needsCompaction()) {
+        compact();
+      } else {
+        uint64_t end;
+        {
+          std::shared_lock<std::shared_mutex> logLock(fMutex);
+          end = fEnd;
+        }
+        if (end >= fSnapshotEnd + kSnapshotEveryBytes) {
+          saveSnapshot();
+        }
+      }
+      lock.lock();
+    }
+  }
+
+  void waitDurable(uint64_t sequence) {
+    std::unique_lock<std::mutex> lock(fSyncMutex);
+    fRequested = std::max(fRequested, sequence);
+    fSyncWake.notify_one();
+    fSynced.wait(lock, [&] { return fSyncedSequence >= sequence || fStopping; });
+  }
+
+  bool write(RecordType type, const std::string &key, const std::string &value, bool durable) {
+    if (key.empty() || key.size() > kMaxKeySize) {
+      throw std::invalid_argument("Key size must be between 1 and " + std::to_string(kMaxKeySize) + " bytes");
+    }
+    if (value.size() > kMaxValueSize) {
+      throw std::invalid_argument("Value larger than " + std::to_string(kMaxValueSize) + " bytes");
+    }
+    std::string record;
+    appendRecord(record, type, key, value);
+    uint64_t sequence;
+    {
+      std::unique_lock<std::shared_mutex> lock(fMutex);
+      if (type == RecordType::Delete && fIndex.find(key) == fIndex.end()) {
+        return false;
+      }
+      writeAll(fFd, record.data(), record.size(), fEnd);
+      apply(fIndex, fLiveBytes, type, key,
+            Location{fEnd + kRecordHeaderSize + key.size(), uint32_t(value.size()), uint32_t(record.size())});
+      fEnd += record.size();
+      sequence = ++fWritten;
+    }
+    if (durable) {
+      waitDurable(sequence);
+    }
+    return true;
+  }
+
+public:
+  /**
+   * @brief Open or create a store
+   * @param directory Directory holding the log and the index snapshot (created if missing)
+   * @throws std::runtime_error if the log cannot be opened or is not a key-value log
+   */
+  explicit KvStore(const std::string &directory)
+      : fDirectory(directory), fLogPath(directory + "/kv.log"), fIndexPath(directory + "/kv.index") {
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+      throw std::runtime_error("Cannot create key-value directory: " + directory);
+    }
+    fFd = open(fLogPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fFd < 0) {
+      throw std::runtime_error("Cannot open key-value log: " + fLogPath);
+    }
+    try {
+      recover();
+    } catch (...) {
+      close(fFd);
+      throw;
+    }
+    fBackground = std::thread([this] { background(); });
+  }
+
+  ~KvStore() {
+    {
+      std::lock_guard<std::mutex> lock(fSyncMutex);
+      fStopping = true;
+    }
+    fSyncWake.notify_all();
+    fSynced.notify_all();
+    fBackground.join();
+    fdatasync(fFd);
+    if (fEnd != fSnapshotEnd) {
+      saveSnapshot();
+    }
+    close(fFd);
+  }
+
+  KvStore(const KvStore &) = delete;
+  KvStore &operator=(const KvStore &) = delete;
+
+  /**
+   * @brief Value of a key, if present
+   */
+  std::optional<std::string> get(const std::string &key) const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    auto entry = fIndex.find(key);
+    if (entry == fIndex.end()) {
+      return std::nullopt;
+    }
+    std::string value(entry->second.size, '\0');
+    if (!readAll(fFd, value.data(), value.size(), entry->second.value)) {
+      throw std::runtime_error("Cannot read key-value log: " + fLogPath);
+    }
+    return value;
+  }
+
+  /**
+   * @brief Set the value of a key
+   * @param durable Return once the update is on disk
+   */
+  void put(const std::string &key, const std::string &value, bool durable) {
+    write(RecordType::Put, key, value, durable);
+  }
+
+  /**
+   * @brief Delete a key
+   * @return false if the key did not exist
+   */
+  bool remove(const std::string &key, bool durable) { return write(RecordType::Delete, key, "", durable); }
+
+  /**
+   * @brief Entries whose key starts with a prefix, in key order
+   * @param limit Maximum number of entries returned
+   * @param matched Set to the number of matching keys
+   */
+  std::vector<std::pair<std::string, std::string>> scan(const std::string &prefix, std::size_t limit,
+                                                        std::size_t &matched) const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    std::vector<Index::const_iterator> entries;
+    for (auto entry = fIndex.begin(); entry != fIndex.end(); ++entry) {
+      if (entry->first.compare(0, prefix.size(), prefix) == 0) {
+        entries.push_back(entry);
+      }
+    }
+    matched = entries.size();
+    std::size_t shown = std::min(limit, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + shown, entries.end(),
+                      [](const auto &a, const auto &b) { return a->first < b->first; });
+    std::vector<std::pair<std::string, std::string>> results;
+    for (std::size_t i = 0; i < shown; ++i) {
+      std::string value(entries[i]->second.size, '\0');
+      if (!readAll(fFd, value.data(), value.size(), entries[i]->second.value)) {
+        throw std::runtime_error("Cannot read key-value log: " + fLogPath);
+      }
+      results.emplace_back(entries[i]->first, std::move(value));
+    }
+    return results;
+  }
+
+  Stats stats() const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    return {fIndex.size(), fEnd, fLiveBytes, fCompactions, fFromSnapshot, fReplayedBytes};
+  }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "mcpJson.hh"
+#include "kvStore.hh"
+#include "mcpTool.hh"
+
+/**
+ * @brief Built-in tool giving agents a persistent key-value scratch space
+ *
+ * Operations on a KvStore (see kvStore.hh), which keeps its state across
+ * calls and server restarts. Values are strings; structured data can be
+ * stored as JSON text.
+ *
+ * The tool is not read-only, so the server runs all its calls, reads
+ * included, one at a time in request order: a get sent after a durable put
+ * waits for the put's fdatasync.
+ */
+class KvStoreTool : public McpTool {
+private:
+  static constexpr std::size_t kDefaultScanLimit = 100;
+
+  KvStore fStore;
+
+public:
+  /**
+   * @brief Constructor; opens or creates the store
+   * @param directory Directory holding the store files
+   */
+  explicit KvStoreTool(const std::string &directory) : fStore(directory) {}
+
+  std::string name() const override { return "KvStoreTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Persistent key-value store kept across calls and sessions: get, put, "
+                        "delete or scan (by key prefix, in key order) string values"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"op", {{"type", "string"}, {"enum", {"get", "put", "delete", "scan", "stats"}}, {"description", "Operation"}}},
+            {"key", {{"type", "string"}, {"description", "Key (get, put, delete); get returns no content for a missing key"}}},
+            {"value", {{"type", "string"}, {"description", "Value (put)"}}},
+            {"prefix", {{"type", "string"}, {"description", "Key prefix (scan, default: all keys)"}}},
+            {"limit", {{"type", "integer"}, {"description", "Maximum number of entries returned by scan (default: 100)"}}},
+            {"durable", {{"type", "boolean"}, {"description", "Return once the update is on disk (put, delete; default: false, synced within a second)"}}}}},
+          {"required", json::array({"op"})}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = false;
+    hints.destructiveHint = true;
+    hints.idempotentHint = false;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    std::string op = arguments.value("op", "");
+    std::string key = arguments.value("key", "");
+    bool durable = arguments.value("durable", false);
+    json content = json::array();
+
+    if (op == "get") {
+      // A missing key is an answer, not an error: no content
+      if (std::optional<std::string> value = fStore.get(key)) {
+        content.push_back(textItem(*value));
+      }
+    } else if (op == "put") {
+      if (!arguments.contains("value") || !arguments["value"].is_string()) {
+        throw std::invalid_argument("put needs a string value");
+      }
+      std::string value = arguments["value"].get<std::string>();
+      fStore.put(key, value, durable);
+      content.push_back(textItem("Stored " + key + " (" + std::to_string(value.size()) + " bytes)"));
+    } else if (op == "delete") {
+      bool removed = fStore.remove(key, durable);
+      content.push_back(textItem((removed ? "Deleted " : "No such key: ") + key));
+    } else if (op == "scan") {
+      std::size_t limit = std::max<int64_t>(1, arguments.value("limit", int64_t(kDefaultScanLimit)));
+      std::size_t matched = 0;
+      for (const auto &[entryKey, value] : fStore.scan(arguments.value("prefix", ""), limit, matched)) {
+        content.push_back(textItem(entryKey + " = " + value));
+      }
+      std::string summary = std::to_string(matched) + " keys";
+      if (matched > limit) {
+        summary += ", showing the first " + std::to_string(limit);
+      }
+      content.push_back(textItem(summary));
+    } else if (op == "stats") {
+      KvStore::Stats stats = fStore.stats();
+      json result = {{"keys", stats.keys},
+                     {"logBytes", stats.logBytes},
+                     {"liveBytes", stats.liveBytes},
+                     {"compactions", stats.compactions},
+                     {"recoveredFromSnapshot", stats.fromSnapshot},
+                     {"replayedBytes", stats.replayedBytes}};
+      content.push_back(textItem(result.dump()));
+    } else {
+      throw std::invalid_argument("Unknown op: " + op + " (expected get, put, delete, scan or stats)");
+    }
+    return content;
+  }
+};
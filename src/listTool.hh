@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fnmatch.h>
+
+#include "directoryTree.hh"
+#include "fileWatcher.hh"
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool listing directory trees with their file attributes
+ *
+ * Listings are answered from an in-memory DirectoryTree (directoryTree.hh)
+ * of the whole root, built in the background by the parallel walker when
+ * the tool is created and kept up to date by an inotify watcher, so a
+ * listing never touches the file system. Changes made during the initial
+ * walk are queued and applied once it completes. File sizes are refreshed
+ * when a file is closed after writing.
+ */
+class ListTool : public McpTool {
+private:
+  static constexpr std::size_t kDefaultMaxResults = 1000;
+  static constexpr std::chrono::milliseconds kReadyPoll{100}; ///< Cancellation checks while the tree is built
+
+  enum class Order { kName, kSize, kTime };
+
+  /// Listing parameters
+  struct Query {
+    std::size_t maxDepth = 1;      ///< Levels below the listed directory (0: no limit)
+    std::string glob;              ///< Name pattern (empty: any)
+    char type = 0;                 ///< 'f' files, 'd' directories, 0 any
+    uint64_t minSize = 0;          ///< Smallest file size listed
+    int64_t modifiedAfterNs = 0;   ///< Oldest modification time listed
+    bool hidden = false;           ///< Include names starting with '.'
+    Order order = Order::kName;
+    std::size_t maxResults = kDefaultMaxResults;
+  };
+
+  /// Totals over the listed levels
+  struct Totals {
+    std::size_t files = 0;
+    std::size_t directories = 0;
+    uint64_t bytes = 0;
+    std::size_t matched = 0;
+  };
+
+  SandboxRoot fRoot;                      ///< Listed directory
+  DirectoryTree fTree;                    ///< Snapshot of the root
+  mutable std::shared_mutex fTreeMutex;   ///< Listings share it, updates are exclusive
+  std::mutex fReadyMutex;                 ///< Protects fReady and fPending
+  std::condition_variable fReadyChanged;  ///< Signals the end of the initial walk
+  bool fReady = false;                    ///< Initial walk complete
+  std::vector<std::pair<std::string, FileWatcher::Event>> fPending; ///< Changes seen during the walk
+  std::atomic<bool> fStopping{false};     ///< Set by the destructor
+  std::unique_ptr<FileWatcher> fWatcher;  ///< Incremental updates
+  std::thread fBuilder;                   ///< Initial walk
+
+  void build() {
+    // Watch first, so that changes made during the walk are not missed
+    try {
+      fWatcher = std::make_unique<FileWatcher>(
+          fRoot.path(), [this](const std::string &path, FileWatcher::Event event) {
+            onChange(path, event);
+          });
+    } catch (const std::exception &) {
+      // No inotify: the tree is only read once
+    }
+    DirectoryTree tree(fRoot.path());
+    tree.build([this] { return fStopping.load(); });
+    std::lock_guard<std::mutex> readyLock(fReadyMutex);
+    {
+      std::unique_lock<std::shared_mutex> lock(fTreeMutex);
+      fTree = std::move(tree);
+      for (const auto &[path, event] : fPending) {
+        apply(path, event);
+      }
+    }
+    fPending.clear();
+    fReady = true;
+    fReadyChanged.notify_all();
+  }
+
+  // Called with fTreeMutex held exclusively
+  void apply(const std::string &path, FileWatcher::Event event) {
+    if (event == FileWatcher::Event::Overflow) {
+      fTree.build([this] { return fStopping.load(); });
+    } else {
+      fTree.refresh(fRoot.relative(path), event == FileWatcher::Event::Added);
+    }
+  }
+
+  void onChange(const std::string &path, FileWatcher::Event event) {
+    {
+      std::lock_guard<std::mutex> readyLock(fReadyMutex);
+      if (!fReady) {
+        fPending.emplace_back(path, event);
+        return;
+      }
+    }
+    if (event == FileWatcher::Event::Overflow) {
+      // Rebuild aside, so that listings go on meanwhile
+      DirectoryTree tree(fRoot.path());
+      tree.build([this] { return fStopping.load(); });
+      std::unique_lock<std::shared_mutex> lock(fTreeMutex);
+      fTree = std::move(tree);
+      return;
+    }
+    std::unique_lock<std::shared_mutex> lock(fTreeMutex);
+    apply(path, event);
+  }
+
+  void waitReady(const McpCancellation &cancellation) {
+    std::unique_lock<std::mutex> lock(fReadyMutex);
+    while (!fReadyChanged.wait_for(lock, kReadyPoll, [this] { return fReady; })) {
+      if (cancellation.requested()) {
+        throw std::runtime_error("Cancelled");
+      }
+    }
+  }
+
+  bool matches(const DirectoryTree::Node &node, std::string_view name, const Query &query) const {
+    bool directory = node.type == DT_DIR;
+    if ((query.type == 'f' && directory) || (query.type == 'd' && !directory)) {
+      return false;
+    }
+    if (!directory && node.size < query.minSize) {
+      return false;
+    }
+    if (node.mtimeNs < query.modifiedAfterNs) {
+      return false;
+    }
+    return query.glob.empty() || fnmatch(query.glob.c_str(), std::string(name).c_str(), 0) == 0;
+  }
+
+  // Depth-first walk of the snapshot below 'index', down to the query
+  // depth: totals the entries seen and collects the matching ones with
+  // their position in tree order. In name order the walk stops once a match
+  // beyond maxResults is found, and returns false; other orders must see
+  // every match to sort them.
+  bool collect(uint32_t index, std::size_t depth, const Query &query,
+               std::vector<std::pair<uint32_t, uint32_t>> &rows, Totals &totals) const {
+    for (uint32_t child = fTree.node(index).firstChild; child != DirectoryTree::kNone;
+         child = fTree.node(child).nextSibling) {
+      const DirectoryTree::Node &node = fTree.node(child);
+      std::string_view name = fTree.name(child);
+      if (!query.hidden && name[0] == '.') {
+        continue;
+      }
+      if (matches(node, name, query)) {
+        if (query.order == Order::kName && rows.size() == query.maxResults) {
+          return false;
+        }
+        ++totals.matched;
+        rows.emplace_back(static_cast<uint32_t>(rows.size()), child);
+      }
+      bool directory = node.type == DT_DIR;
+      if (directory) {
+        ++totals.directories;
+      } else {
+        ++totals.files;
+        totals.bytes += node.size;
+      }
+      if (directory && (query.maxDepth == 0 || depth < query.maxDepth) &&
+          !collect(child, depth + 1, query, rows, totals)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Path of 'node' below the listed directory 'base' (at 'prefix'), built
+  // from the parent links: only for the entries returned
+  std::string pathOf(uint32_t node, uint32_t base, const std::string &prefix) const {
+    std::vector<std::string_view> names;
+    for (; node != base; node = fTree.node(node).parent) {
+      names.push_back(fTree.name(node));
+    }
+    std::string path = prefix;
+    for (auto name = names.rbegin(); name != names.rend(); ++name) {
+      if (!path.empty()) {
+        path += '/';
+      }
+      path += *name;
+    }
+    return path;
+  }
+
+  static std::string formatTime(int64_t nanoseconds) {
+    std::time_t seconds = nanoseconds / 1000000000;
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &utc);
+    return text;
+  }
+
+  std::string formatRow(const std::string &path, const DirectoryTree::Node &node) const {
+    char attributes[64];
+    std::snprintf(attributes, sizeof(attributes), "%04o %12llu  ", node.mode & 07777,
+                  static_cast<unsigned long long>(node.size));
+    const char *suffix = node.type == DT_DIR ? "/" : node.type == DT_LNK ? "@" : "";
+    return attributes + formatTime(node.mtimeNs) + "  " + path + suffix;
+  }
+
+  static Query parseQuery(const json &arguments) {
+    Query query;
+    query.maxDepth = std::max<int64_t>(0, arguments.value("maxDepth", int64_t(1)));
+    query.glob = arguments.value("glob", "");
+    std::string type = arguments.value("type", "any");
+    if (type == "file") {
+      query.type = 'f';
+    } else if (type == "directory") {
+      query.type = 'd';
+    } else if (type != "any") {
+      throw std::invalid_argument("Unknown type: " + type + " (expected file, directory or any)");
+    }
+    query.minSize = std::max<int64_t>(0, arguments.value("minSize", int64_t(0)));
+    if (arguments.contains("modifiedWithin")) {
+      int64_t seconds = std::max<int64_t>(0, arguments.value("modifiedWithin", int64_t(0)));
+      auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch());
+      query.modifiedAfterNs = now.count() - seconds * 1000000000;
+    }
+    query.hidden = arguments.value("hidden", false);
+    std::string order = arguments.value("sortBy", "name");
+    if (order == "size") {
+      query.order = Order::kSize;
+    } else if (order == "mtime") {
+      query.order = Order::kTime;
+    } else if (order != "name") {
+      throw std::invalid_argument("Unknown sortBy: " + order + " (expected name, size or mtime)");
+    }
+    query.maxResults = std::max<int64_t>(1, arguments.value("maxResults", int64_t(kDefaultMaxResults)));
+    return query;
+  }
+
+public:
+  /**
+   * @brief Constructor; starts reading the tree in the background
+   * @param root Directory to list
+   */
+  explicit ListTool(const std::string &root) : fRoot(root), fTree(fRoot.path()) {
+    fBuilder = std::thread([this] { build(); });
+  }
+
+  ~ListTool() override {
+    fStopping = true;
+    fBuilder.join();
+    fWatcher.reset();
+  }
+
+  std::string name() const override { return "ListTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "List a directory tree with permissions, sizes and modification times (UTC), "
+                        "filtered by name, type, size or age, with totals for the levels listed"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"path", {{"type", "string"}, {"description", "Directory or file, relative to the root (default: .)"}}},
+            {"maxDepth", {{"type", "integer"}, {"description", "Levels listed below the directory (default: 1, 0: no limit)"}}},
+            {"glob", {{"type", "string"}, {"description", "Only list names matching this pattern, e.g. *.cpp"}}},
+            {"type", {{"type", "string"}, {"enum", {"any", "file", "directory"}}, {"description", "Entry type listed (default: any)"}}},
+            {"minSize", {{"type", "integer"}, {"description", "Only list files of at least this many bytes"}}},
+            {"modifiedWithin", {{"type", "integer"}, {"description", "Only list entries modified in the last N seconds"}}},
+            {"hidden", {{"type", "boolean"}, {"description", "Include names starting with '.' (default: false)"}}},
+            {"sortBy", {{"type", "string"}, {"enum", {"name", "size", "mtime"}}, {"description", "Tree order by name (default), or largest / newest first"}}},
+            {"maxResults", {{"type", "integer"}, {"description", "Maximum number of entries (default: 1000)"}}}}}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.idempotentHint = false; // The tree changes: results must not be reused by the server
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    Query query = parseQuery(arguments);
+    std::string relative = fRoot.relative(fRoot.resolve(arguments.value("path", ".")));
+    if (relative == ".") {
+      relative.clear();
+    }
+    waitReady(currentCancellation());
+
+    std::vector<std::pair<uint32_t, uint32_t>> rows; // position in tree order, node
+    Totals totals;
+    json content = json::array();
+    std::shared_lock<std::shared_mutex> lock(fTreeMutex);
+    uint32_t index = fTree.find(relative);
+    if (index == DirectoryTree::kNone) {
+      throw std::invalid_argument("No such file or directory: " + arguments.value("path", "."));
+    }
+    if (fTree.node(index).type != DT_DIR) {
+      content.push_back(textItem(formatRow(relative, fTree.node(index))));
+      return content;
+    }
+    bool complete = collect(index, 1, query, rows, totals);
+
+    if (query.order != Order::kName) {
+      auto key = [this, &query](uint32_t node) {
+        return query.order == Order::kSize ? int64_t(fTree.node(node).size) : fTree.node(node).mtimeNs;
+      };
+      std::size_t kept = std::min(rows.size(), query.maxResults);
+      std::partial_sort(rows.begin(), rows.begin() + kept, rows.end(), [&key](const auto &a, const auto &b) {
+        int64_t ka = key(a.second), kb = key(b.second);
+        return ka != kb ? ka > kb : a.first < b.first;
+      });
+      rows.resize(kept);
+    }
+
+    std::string listing;
+    for (const auto &[position, node] : rows) {
+      listing += listing.empty() ? "" : "\n";
+      listing += formatRow(pathOf(node, index, relative), fTree.node(node));
+    }
+    if (!listing.empty()) {
+      content.push_back(textItem(listing));
+    }
+    std::string below = relative.empty() ? "." : relative;
+    std::string summary;
+    if (!complete) {
+      // The walk stopped at the limit: the totals would be partial
+      summary = "More than " + std::to_string(rows.size()) + " matching entries below " + below +
+                ", showing the first " + std::to_string(rows.size());
+    } else {
+      summary = std::to_string(totals.files) + " files, " + std::to_string(totals.directories) +
+                " directories, " + std::to_string(totals.bytes) + " bytes listed below " + below + ", " +
+                std::to_string(totals.matched) + " matching entries";
+      if (totals.matched > rows.size()) {
+        summary += ", showing the first " + std::to_string(rows.size());
+      }
+    }
+    content.push_back(textItem(summary));
+    return content;
+  }
+};
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include <malloc.h>
+#include <sys/mman.h>
+
+// ============================================================================
+// Size-Class Allocator
+// ============================================================================
+
+/**
+ * @brief Thread-caching allocator for small blocks, built in with MCP_ALLOCATOR
+ *
+ * Blocks of up to kMaxSmall bytes are rounded to one of kClassCount size
+ * classes: 16-byte steps up to 128 bytes (json values, object members,
+ * short strings), then four classes per power of two. Each class is carved
+ * from 256 KB spans of one reserved address range, so the class of a block
+ * is found from its address and unsized deletes need no header.
+ *
+ * Each thread keeps a free list per class and only takes the central lock
+ * of a class to move a batch of blocks in or out. Freed blocks gather in
+ * the central lists; when they grow by kScavengeBytes since the last pass
+ * (at most once per kScavengeInterval), spans whose blocks are all free
+ * are returned to the OS with MADV_DONTNEED and reused by any class.
+ * Larger blocks and aligned allocations go to malloc.
+ *
+ * Compiling with -DMCP_ALLOCATOR makes the global operator new and delete
+ * of mcpMemoryGovernor.hh (see MCP_DEFINE_ALLOCATION_FUNCTIONS) use it
+ * instead of malloc.
+ */
+class McpAllocator {
+public:
+  static constexpr std::size_t kClassCount = 40;
+  static constexpr std::size_t kMaxSmall = 32768;     ///< Largest block served from spans
+  static constexpr std::size_t kSpanSize = 256 << 10; ///< Span size (and alignment)
+  static constexpr std::size_t kReservedSize = std::size_t(64) << 30; ///< Address range reserved for spans
+  static constexpr std::size_t kMaxSpans = kReservedSize / kSpanSize;
+  static constexpr std::size_t kScavengeBytes = 8 << 20; ///< Growth of the central free bytes triggering a scavenge
+  static constexpr std::chrono::seconds kScavengeInterval{1};
+
+  /// Counters, for metrics
+  struct Stats {
+    uint64_t spansInUse;      ///< Spans holding blocks of a class
+    uint64_t spansReleased;   ///< Spans returned to the OS, awaiting reuse
+    uint64_t centralFreeBytes; ///< Free blocks held by the central lists
+    uint64_t scavenges;       ///< Scavenging passes run
+  };
+
+private:
+  struct Block {
+    Block *next;
+  };
+
+  /// Free blocks of one class shared by all threads, and the span being carved
+  struct Central {
+    std::mutex mutex;
+    Block *free = nullptr;
+    std::size_t count = 0;
+    char *cursor = nullptr; ///< Next uncarved block
+    char *end = nullptr;    ///< End of the span being carved
+  };
+
+  /// Free blocks of one class owned by a thread
+  struct Cache {
+    Block *free;
+    uint32_t count;
+  };
+
+  /// Per-thread caches; trivially destructible, so usable until the thread ends
+  struct ThreadCaches {
+    Cache classes[kClassCount];
+    bool registered; ///< The flusher of this thread exists
+    bool exited;     ///< The thread is ending: frees go to the central lists
+  };
+
+  /// Returns the cached blocks of a thread when it ends
+  struct Flusher {
+    ~Flusher() {
+      ThreadCaches &caches = sCaches;
+      for (std::size_t c = 0; c < kClassCount; ++c) {
+        Cache &cache = caches.classes[c];
+        if (cache.count > 0) {
+          pushCentral(c, cache.free, cache.count);
+          cache = {nullptr, 0};
+        }
+      }
+      caches.exited = true;
+    }
+  };
+
+  static Central sCentral[kClassCount]; // defined below the class, once Central is complete
+  static inline thread_local ThreadCaches sCaches;
+
+  static inline std::mutex sSpanMutex;       ///< Protects the span bookkeeping below
+  static inline char *sBase = nullptr;       ///< Reserved range (nullptr: not reserved yet)
+  static inline bool sReserveFailed = false; ///< Reservation failed: everything goes to malloc
+  static inline std::size_t sSpansCarved = 0; ///< Spans taken from the range
+  static inline uint32_t sReleased[kMaxSpans]; ///< Stack of released spans
+  static inline std::size_t sReleasedCount = 0;
+  static inline uint8_t sSpanClass[kMaxSpans]; ///< Class + 1 of each span (0: free)
+
+  static inline std::atomic<char *> sRangeBegin{nullptr}; ///< Published range, read without the lock
+  static inline std::atomic<uint64_t> sCentralFreeBytes{0};
+  static inline std::atomic<uint64_t> sSpansInUse{0};
+  static inline std::atomic<uint64_t> sScavenges{0};
+  static inline std::atomic<int64_t> sLastScavenge{0};
+  static inline std::atomic<uint64_t> sScavengeFloor{0}; ///< Central free bytes left by the last pass
+  static inline std::atomic<bool> sScavenging{false};
+
+  static constexpr std::size_t computeClassSize(std::size_t c) {
+    if (c < 8) {
+      return (c + 1) * 16;
+    }
+    // Four classes per power of two: 2^g + 2^(g-2), ..., 2^(g+1)
+    std::size_t g = 7 + (c - 8) / 4;
+    return (std::size_t(1) << g) + ((c - 8) % 4 + 1) * (std::size_t(1) << (g - 2));
+  }
+
+  struct ClassTables {
+    uint32_t size[kClassCount];  ///< Block size of each class
+    uint32_t batch[kClassCount]; ///< Blocks moved between a thread cache and the central list at once
+    uint8_t small[1024 / 16 + 1]; ///< Class of each size up to 1 KB, by 16-byte step
+  };
+
+  static constexpr ClassTables makeTables() {
+    ClassTables tables{};
+    for (std::size_t c = 0; c < kClassCount; ++c) {
+      tables.size[c] = static_cast<uint32_t>(computeClassSize(c));
+      tables.batch[c] = static_cast<uint32_t>(std::clamp<std::size_t>((8 << 10) / tables.size[c], 2, 64));
+    }
+    for (std::size_t step = 0, c = 0; step <= 1024 / 16; ++step) {
+      while (tables.size[c] < std::max<std::size_t>(step * 16, 1)) {
+        ++c;
+      }
+      tables.small[step] = static_cast<uint8_t>(c);
+    }
+    return tables;
+  }
+
+  static const ClassTables kTables; // defined below the class, once makeTables() is
+
+  static std::size_t classOf(std::size_t size) {
+    if (size <= 1024) {
+      return kTables.small[(size + 15) >> 4];
+    }
+    std::size_t g = 63 - __builtin_clzll(size - 1);
+    return 8 + (g - 7) * 4 + ((size - 1 - (std::size_t(1) << g)) >> (g - 2));
+  }
+
+  static std::size_t classSize(std::size_t c) { return kTables.size[c]; }
+
+  static uint32_t batchSize(std::size_t c) { return kTables.batch[c]; }
+
+  static bool owns(const void *block) {
+    char *begin = sRangeBegin.load(std::memory_order_relaxed);
+    return begin != nullptr && static_cast<const char *>(block) >= begin &&
+           static_cast<const char *>(block) < begin + kReservedSize;
+  }
+
+  // Take a span for class c (null if the range is exhausted or cannot be reserved)
+  static char *takeSpan(std::size_t c) {
+    std::lock_guard<std::mutex> lock(sSpanMutex);
+    if (sBase == nullptr && !sReserveFailed) {
+      void *range = mmap(nullptr, kReservedSize + kSpanSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                         -1, 0);
+      if (range == MAP_FAILED) {
+        sReserveFailed = true;
+        return nullptr;
+      }
+      uintptr_t aligned = (reinterpret_cast<uintptr_t>(range) + kSpanSize - 1) & ~uintptr_t(kSpanSize - 1);
+      sBase = reinterpret_cast<char *>(aligned);
+      sRangeBegin.store(sBase, std::memory_order_release);
+    }
+    if (sBase == nullptr) {
+      return nullptr;
+    }
+    std::size_t span;
+    if (sReleasedCount > 0) {
+      span = sReleased[--sReleasedCount];
+    } else if (sSpansCarved < kMaxSpans) {
+      span = sSpansCarved++;
+      if (mprotect(sBase + span * kSpanSize, kSpanSize, PROT_READ | PROT_WRITE) != 0) {
+        --sSpansCarved;
+        return nullptr;
+      }
+    } else {
+      return nullptr;
+    }
+    sSpanClass[span] = static_cast<uint8_t>(c + 1);
+    sSpansInUse.fetch_add(1, std::memory_order_relaxed);
+    return sBase + span * kSpanSize;
+  }
+
+  // Move up to 'wanted' blocks of class c from the central list to a thread cache
+  static uint32_t popCentral(std::size_t c, Cache &cache, uint32_t wanted) {
+    Central &central = sCentral[c];
+    std::size_t size = classSize(c);
+    std::lock_guard<std::mutex> lock(central.mutex);
+    uint32_t moved = 0;
+    while (moved < wanted && central.free != nullptr) {
+      Block *block = central.free;
+      central.free = block->next;
+      block->next = cache.free;
+      cache.free = block;
+      ++moved;
+    }
+    central.count -= moved;
+    uint64_t freeBytes = sCentralFreeBytes.fetch_sub(moved * size, std::memory_order_relaxed) - moved * size;
+    if (freeBytes < sScavengeFloor.load(std::memory_order_relaxed)) {
+      sScavengeFloor.store(freeBytes, std::memory_order_relaxed);
+    }
+    while (moved < wanted) {
+      if (central.cursor == central.end) {
+        char *span = takeSpan(c);
+        if (span == nullptr) {
+          break;
+        }
+        central.cursor = span;
+        central.end = span + kSpanSize / size * size;
+      }
+      Block *block = reinterpret_cast<Block *>(central.cursor);
+      central.cursor += size;
+      block->next = cache.free;
+      cache.free = block;
+      ++moved;
+    }
+    cache.count += moved;
+    return moved;
+  }
+
+  static void pushCentral(std::size_t c, Block *first, std::size_t count) {
+    Central &central = sCentral[c];
+    Block *last = first;
+    while (last->next != nullptr) {
+      last = last->next;
+    }
+    {
+      std::lock_guard<std::mutex> lock(central.mutex);
+      last->next = central.free;
+      central.free = first;
+      central.count += count;
+    }
+    uint64_t freeBytes = sCentralFreeBytes.fetch_add(count * classSize(c), std::memory_order_relaxed);
+    if (freeBytes > sScavengeFloor.load(std::memory_order_relaxed) + kScavengeBytes) {
+      maybeScavenge();
+    }
+  }
+
+  static void maybeScavenge() {
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (now - sLastScavenge.load(std::memory_order_relaxed) < kScavengeInterval.count() ||
+        sScavenging.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    sLastScavenge.store(now, std::memory_order_relaxed);
+    scavenge();
+    // Blocks of partly used spans stay; only new frees warrant another pass
+    sScavengeFloor.store(sCentralFreeBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sScavenging.store(false, std::memory_order_release);
+  }
+
+  // Return the wholly free spans of class c; called with its central lock held
+  static void scavengeClass(std::size_t c, Central &central) {
+    std::size_t size = classSize(c);
+    std::size_t perSpan = kSpanSize / size;
+    if (central.count < perSpan) {
+      return;
+    }
+    // Sort the free blocks by address in scratch memory taken from the OS,
+    // since operator new cannot be used here
+    std::size_t scratchSize = central.count * sizeof(Block *);
+    void *scratch = mmap(nullptr, scratchSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (scratch == MAP_FAILED) {
+      return;
+    }
+    Block **blocks = static_cast<Block **>(scratch);
+    std::size_t count = 0;
+    for (Block *block = central.free; block != nullptr; block = block->next) {
+      blocks[count++] = block;
+    }
+    std::sort(blocks, blocks + count);
+
+    char *carving = central.cursor != central.end ? central.end - 1 : nullptr;
+    Block *kept = nullptr;
+    std::size_t keptCount = 0;
+    std::size_t releasedSpans = 0;
+    for (std::size_t i = 0; i < count;) {
+      std::size_t span = (reinterpret_cast<char *>(blocks[i]) - sBase) / kSpanSize;
+      std::size_t j = i;
+      while (j < count && (reinterpret_cast<char *>(blocks[j]) - sBase) / kSpanSize == span) {
+        ++j;
+      }
+      char *spanBegin = sBase + span * kSpanSize;
+      bool beingCarved = carving != nullptr && carving >= spanBegin && carving < spanBegin + kSpanSize;
+      if (j - i == perSpan && !beingCarved) {
+        madvise(spanBegin, kSpanSize, MADV_DONTNEED);
+        std::lock_guard<std::mutex> lock(sSpanMutex);
+        sSpanClass[span] = 0;
+        sReleased[sReleasedCount++] = static_cast<uint32_t>(span);
+        ++releasedSpans;
+      } else {
+        for (std::size_t k = i; k < j; ++k) {
+          blocks[k]->next = kept;
+          kept = blocks[k];
+        }
+        keptCount += j - i;
+      }
+      i = j;
+    }
+    munmap(scratch, scratchSize);
+    central.free = kept;
+    central.count = keptCount;
+    sCentralFreeBytes.fetch_sub((count - keptCount) * size, std::memory_order_relaxed);
+    sSpansInUse.fetch_sub(releasedSpans, std::memory_order_relaxed);
+  }
+
+  static void *allocateSmall(std::size_t c) {
+    Cache &cache = sCaches.classes[c];
+    if (cache.free == nullptr) {
+      if (!sCaches.registered && !sCaches.exited) {
+        sCaches.registered = true;
+        static thread_local Flusher flusher;
+        (void)flusher;
+      }
+      if (popCentral(c, cache, batchSize(c)) == 0) {
+        return nullptr;
+      }
+    }
+    Block *block = cache.free;
+    cache.free = block->next;
+    --cache.count;
+    return block;
+  }
+
+  static void freeSmall(void *pointer) {
+    std::size_t span = (static_cast<char *>(pointer) - sRangeBegin.load(std::memory_order_relaxed)) / kSpanSize;
+    std::size_t c = sSpanClass[span] - 1;
+    Block *block = static_cast<Block *>(pointer);
+    ThreadCaches &caches = sCaches;
+    if (caches.exited) {
+      block->next = nullptr;
+      pushCentral(c, block, 1);
+      return;
+    }
+    Cache &cache = caches.classes[c];
+    block->next = cache.free;
+    cache.free = block;
+    uint32_t batch = batchSize(c);
+    if (++cache.count > 2 * batch) {
+      // Keep one batch, return the rest
+      Block *last = cache.free;
+      for (uint32_t i = 1; i < batch; ++i) {
+        last = last->next;
+      }
+      Block *returned = last->next;
+      last->next = nullptr;
+      std::size_t count = cache.count - batch;
+      cache.count = batch;
+      pushCentral(c, returned, count);
+    }
+  }
+
+public:
+  /**
+   * @brief Allocate a block
+   * @param size Size in bytes
+   * @return Block aligned on 16 bytes, or nullptr when out of memory
+   */
+  static void *allocate(std::size_t size) {
+    if (size <= kMaxSmall) {
+      if (void *block = allocateSmall(classOf(size))) {
+        return block;
+      }
+    }
+    return std::malloc(size == 0 ? 1 : size);
+  }
+
+  /// Free a block from allocate() (nullptr is ignored)
+  static void deallocate(void *block) {
+    if (owns(block)) {
+      freeSmall(block);
+    } else {
+      std::free(block);
+    }
+  }
+
+  /// Usable size of a block from allocate()
+  static std::size_t blockSize(void *block) {
+    if (owns(block)) {
+      std::size_t span = (static_cast<char *>(block) - sRangeBegin.load(std::memory_order_relaxed)) / kSpanSize;
+      return classSize(sSpanClass[span] - 1);
+    }
+    return malloc_usable_size(block);
+  }
+
+  /// Return wholly free spans to the OS now
+  static void scavenge() {
+    if (sRangeBegin.load(std::memory_order_acquire) == nullptr) {
+      return;
+    }
+    for (std::size_t c = 0; c < kClassCount; ++c) {
+      std::lock_guard<std::mutex> lock(sCentral[c].mutex);
+      scavengeClass(c, sCentral[c]);
+    }
+    sScavenges.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static Stats stats() {
+    std::size_t released;
+    {
+      std::lock_guard<std::mutex> lock(sSpanMutex);
+      released = sReleasedCount;
+    }
+    return {sSpansInUse.load(std::memory_order_relaxed), released,
+            sCentralFreeBytes.load(std::memory_order_relaxed), sScavenges.load(std::memory_order_relaxed)};
+  }
+};
+
+inline constexpr McpAllocator::ClassTables McpAllocator::kTables = McpAllocator::makeTables();
+inline McpAllocator::Central McpAllocator::sCentral[McpAllocator::kClassCount];
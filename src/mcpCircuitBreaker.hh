@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// ============================================================================
+// Circuit Breaker
+// ============================================================================
+
+/**
+ * @brief Per-tool circuit breaker driven by error rate and latency
+ *
+ * Outcomes are counted in a sliding window made of time buckets. A call is
+ * a failure if it reports an error or exceeds the slow-call threshold;
+ * calls failed by their caller (bad arguments) are reported with release()
+ * and not counted.
+ * - Closed: calls run; when enough calls in the window fail, the breaker opens
+ * - Open: calls are rejected immediately until the open duration elapses
+ * - Half-open: a single probe call runs; success closes the breaker, failure
+ *   opens it again
+ */
+class McpCircuitBreaker {
+public:
+  enum class State { Closed, Open, HalfOpen };
+
+  /**
+   * @brief Thresholds controlling the breaker
+   */
+  struct Policy {
+    std::chrono::milliseconds window{30000};     ///< Sliding window length
+    std::size_t minimumCalls = 20;               ///< Calls needed to evaluate the rate
+    double failureRateThreshold = 0.5;           ///< Failure ratio that opens the breaker
+    std::chrono::milliseconds slowCallThreshold{10000}; ///< Latency counted as failure
+    std::chrono::milliseconds openDuration{30000}; ///< Time spent open before probing
+  };
+
+  using Listener = std::function<void(State from, State to)>;
+
+  static const char *stateName(State state) {
+    switch (state) {
+    case State::Closed:
+      return "closed";
+    case State::Open:
+      return "open";
+    default:
+      return "half-open";
+    }
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t kBuckets = 10; ///< Window granularity
+
+  struct Bucket {
+    int64_t epoch = -1;      ///< Window slice this bucket currently counts
+    uint32_t calls = 0;
+    uint32_t failures = 0;
+  };
+
+  mutable std::mutex fMutex;         ///< Protects all fields below
+  Policy fPolicy;                    ///< Active thresholds
+  Listener fListener;                ///< Notified of state changes
+  State fState = State::Closed;      ///< Current state
+  Clock::time_point fOpenedAt;       ///< Time of the last transition to Open
+  bool fProbeInFlight = false;       ///< Half-open probe admitted
+  std::array<Bucket, kBuckets> fBuckets; ///< Sliding window
+  uint64_t fOpenCount = 0;           ///< Number of transitions to Open
+  uint64_t fRejected = 0;            ///< Calls rejected while open
+
+  int64_t sliceOf(Clock::time_point now) const {
+    auto slice = fPolicy.window / kBuckets;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch())
+               .count() /
+           std::max<int64_t>(1, slice.count());
+  }
+
+  Bucket &currentBucket(Clock::time_point now) {
+    int64_t epoch = sliceOf(now);
+    Bucket &bucket = fBuckets[epoch % kBuckets];
+    if (bucket.epoch != epoch) {
+      bucket = Bucket{epoch, 0, 0};
+    }
+    return bucket;
+  }
+
+  bool failureRateExceeded(Clock::time_point now) const {
+    int64_t oldest = sliceOf(now) - static_cast<int64_t>(kBuckets) + 1;
+    uint64_t calls = 0;
+    uint64_t failures = 0;
+    for (const Bucket &bucket : fBuckets) {
+      if (bucket.epoch >= oldest) {
+        calls += bucket.calls;
+        failures += bucket.failures;
+      }
+    }
+    return calls >= fPolicy.minimumCalls &&
+           failures >= fPolicy.failureRateThreshold * calls;
+  }
+
+  // Must be called with fMutex held
+  void transition(State to, Clock::time_point now) {
+    fState = to;
+    fProbeInFlight = false;
+    if (to == State::Open) {
+      fOpenedAt = now;
+      ++fOpenCount;
+    } else if (to == State::Closed) {
+      fBuckets.fill(Bucket{});
+    }
+  }
+
+  void notify(State from, State to) {
+    if (from != to && fListener) {
+      fListener(from, to);
+    }
+  }
+
+public:
+  McpCircuitBreaker(const Policy &policy, Listener listener)
+      : fPolicy(policy), fListener(std::move(listener)) {}
+
+  /**
+   * @brief Replace the thresholds (resets the breaker to Closed)
+   */
+  void setPolicy(const Policy &policy) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fPolicy = policy;
+    transition(State::Closed, Clock::now());
+  }
+
+  /**
+   * @brief Ask whether a call may run now
+   * @return true if the call may run; it must then be reported with record()
+   */
+  bool allowRequest() {
+    State from;
+    State to;
+    bool allowed;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      auto now = Clock::now();
+      from = fState;
+      if (fState == State::Open && now - fOpenedAt >= fPolicy.openDuration) {
+        transition(State::HalfOpen, now);
+      }
+      if (fState == State::Closed) {
+        allowed = true;
+      } else if (fState == State::HalfOpen && !fProbeInFlight) {
+        fProbeInFlight = true;
+        allowed = true;
+      } else {
+        ++fRejected;
+        allowed = false;
+      }
+      to = fState;
+    }
+    notify(from, to);
+    return allowed;
+  }
+
+  /**
+   * @brief Report the outcome of a call admitted by allowRequest()
+   * @param failed true if the call reported an error
+   * @param latency Duration of the call
+   */
+  void record(bool failed, std::chrono::nanoseconds latency) {
+    State from;
+    State to;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      auto now = Clock::now();
+      bool failure = failed || latency >= fPolicy.slowCallThreshold;
+      from = fState;
+      if (fState == State::HalfOpen) {
+        transition(failure ? State::Open : State::Closed, now);
+      } else if (fState == State::Closed) {
+        Bucket &bucket = currentBucket(now);
+        ++bucket.calls;
+        bucket.failures += failure ? 1 : 0;
+        if (failure && failureRateExceeded(now)) {
+          transition(State::Open, now);
+        }
+      }
+      to = fState;
+    }
+    notify(from, to);
+  }
+
+  /**
+   * @brief Report a call admitted by allowRequest() whose outcome says
+   * nothing about the tool's health: it is not counted, and a half-open
+   * breaker admits another probe
+   */
+  void release() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fState == State::HalfOpen) {
+      fProbeInFlight = false;
+    }
+  }
+
+  /**
+   * @brief Milliseconds until an open breaker admits a probe (0 otherwise)
+   */
+  int64_t retryAfterMs() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fState != State::Open) {
+      return 0;
+    }
+    auto remaining = fPolicy.openDuration - (Clock::now() - fOpenedAt);
+    return std::max<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+  }
+
+  State state() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fState;
+  }
+
+  uint64_t openCount() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fOpenCount;
+  }
+
+  uint64_t rejectedCount() const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fRejected;
+  }
+};
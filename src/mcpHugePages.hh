@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+
+#include "mcpMemoryGovernor.hh"
+
+// ============================================================================
+// Huge Pages
+// ============================================================================
+
+/**
+ * @brief Anonymous memory regions backed by huge pages
+ *
+ * Regions are whole 2 MB pages, aligned on 2 MB. Depending on the mode they
+ * are mapped with MAP_HUGETLB (explicit huge pages, which must be reserved
+ * in /proc/sys/vm/nr_hugepages), or mapped normally and marked
+ * MADV_HUGEPAGE so the kernel backs them with transparent huge pages when
+ * it can. An explicit mapping that fails falls back to a transparent one.
+ * With huge pages, a large buffer is faulted in a few 2 MB pages instead of
+ * hundreds of 4 KB ones, and needs as few TLB entries.
+ *
+ * The mode is process-wide; set it before the server starts.
+ */
+class McpHugePages {
+public:
+  enum class Mode { Off, Transparent, Explicit };
+
+  static constexpr std::size_t kPageSize = 2 << 20; ///< Huge page size (x86-64, arm64 with 4 KB pages)
+
+  /// Mapping counters, for metrics
+  struct Stats {
+    uint64_t explicitMaps;    ///< Regions mapped with MAP_HUGETLB
+    uint64_t transparentMaps; ///< Regions marked MADV_HUGEPAGE
+    uint64_t fallbacks;       ///< Explicit mappings that failed
+    uint64_t mappedBytes;     ///< Bytes currently mapped
+  };
+
+private:
+  static inline std::atomic<Mode> sMode{Mode::Off};
+  static inline std::atomic<uint64_t> sExplicitMaps{0};
+  static inline std::atomic<uint64_t> sTransparentMaps{0};
+  static inline std::atomic<uint64_t> sFallbacks{0};
+  static inline std::atomic<uint64_t> sMappedBytes{0};
+
+  // Normal mapping aligned on kPageSize: the unaligned head and tail are unmapped
+  static void *mapAligned(std::size_t size) {
+    void *area = mmap(nullptr, size + kPageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(area);
+    uintptr_t aligned = (start + kPageSize - 1) & ~uintptr_t(kPageSize - 1);
+    if (aligned > start) {
+      munmap(area, aligned - start);
+    }
+    std::size_t tail = start + size + kPageSize - (aligned + size);
+    if (tail > 0) {
+      munmap(reinterpret_cast<void *>(aligned + size), tail);
+    }
+    return reinterpret_cast<void *>(aligned);
+  }
+
+public:
+  /// Size of the region mapped for 'size' bytes
+  static std::size_t roundUp(std::size_t size) { return (size + kPageSize - 1) & ~(kPageSize - 1); }
+
+  static void setMode(Mode mode) { sMode = mode; }
+
+  static Mode mode() { return sMode.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Parse a mode name
+   * @param name "off", "transparent" or "explicit"
+   * @return The mode
+   * @throws std::invalid_argument for any other name
+   */
+  static Mode parseMode(const std::string &name) {
+    if (name == "off") {
+      return Mode::Off;
+    }
+    if (name == "transparent") {
+      return Mode::Transparent;
+    }
+    if (name == "explicit") {
+      return Mode::Explicit;
+    }
+    throw std::invalid_argument("Unknown huge page mode: " + name);
+  }
+
+  static const char *modeName(Mode mode) {
+    switch (mode) {
+    case Mode::Transparent:
+      return "transparent";
+    case Mode::Explicit:
+      return "explicit";
+    default:
+      return "off";
+    }
+  }
+
+  /**
+   * @brief Map a region
+   * @param size Requested size, rounded up to whole huge pages
+   * @return Start of the region, aligned on kPageSize
+   * @throws std::bad_alloc when no memory can be mapped
+   */
+  static void *map(std::size_t size) {
+    size = roundUp(size);
+    Mode current = mode();
+    void *region = nullptr;
+    if (current == Mode::Explicit) {
+      region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (region != MAP_FAILED) {
+        sExplicitMaps.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        region = nullptr;
+        sFallbacks.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (region == nullptr) {
+      region = mapAligned(size);
+      if (current != Mode::Off) {
+        madvise(region, size, MADV_HUGEPAGE);
+        sTransparentMaps.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    sMappedBytes.fetch_add(size, std::memory_order_relaxed);
+    return region;
+  }
+
+  /**
+   * @brief Unmap a region returned by map()
+   * @param region Start of the region
+   * @param size Size given to map()
+   */
+  static void unmap(void *region, std::size_t size) {
+    size = roundUp(size);
+    munmap(region, size);
+    sMappedBytes.fetch_sub(size, std::memory_order_relaxed);
+  }
+
+  static Stats stats() {
+    return {sExplicitMaps.load(std::memory_order_relaxed), sTransparentMaps.load(std::memory_order_relaxed),
+            sFallbacks.load(std::memory_order_relaxed), sMappedBytes.load(std::memory_order_relaxed)};
+  }
+};
+
+/**
+ * @brief Allocator placing blocks of a huge page or more in McpHugePages regions
+ *
+ * Smaller blocks come from the default allocator: a huge page per small
+ * buffer would multiply the memory used. Blocks of kPageSize bytes or more
+ * are always mapped (with the huge page hint only if a mode is set), so a
+ * block is released the same way whatever the mode was when it was made.
+ * Mapped blocks are charged to McpMemoryGovernor like heap blocks.
+ */
+template <class T> class McpHugePageAllocator {
+public:
+  using value_type = T;
+
+  McpHugePageAllocator() noexcept = default;
+  template <class U> McpHugePageAllocator(const McpHugePageAllocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    if (n * sizeof(T) < McpHugePages::kPageSize) {
+      return std::allocator<T>().allocate(n);
+    }
+    void *region = McpHugePages::map(n * sizeof(T));
+    if (McpMemoryGovernor::enabled() && !McpMemoryGovernor::onAllocate(McpHugePages::roundUp(n * sizeof(T)))) {
+      McpHugePages::unmap(region, n * sizeof(T));
+      throw McpMemoryGovernor::BudgetExceeded();
+    }
+    return static_cast<T *>(region);
+  }
+
+  void deallocate(T *block, std::size_t n) noexcept {
+    if (n * sizeof(T) < McpHugePages::kPageSize) {
+      std::allocator<T>().deallocate(block, n);
+    } else {
+      McpHugePages::unmap(block, n * sizeof(T));
+      if (McpMemoryGovernor::enabled()) {
+        McpMemoryGovernor::onFree(McpHugePages::roundUp(n * sizeof(T)));
+      }
+    }
+  }
+
+  template <class U> bool operator==(const McpHugePageAllocator<U> &) const noexcept { return true; }
+  template <class U> bool operator!=(const McpHugePageAllocator<U> &) const noexcept { return false; }
+};
+
+/// Message buffer: large messages are read and serialized into huge pages
+using McpBuffer = std::basic_string<char, std::char_traits<char>, McpHugePageAllocator<char>>;
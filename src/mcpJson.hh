@@ -0,0 +1,418 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "json.hpp"
+#include "perfectHash.hh"
+
+// ============================================================================
+// Interned Protocol Keys
+// ============================================================================
+
+/**
+ * @brief Object key of the MCP protocol, with its interned id
+ *
+ * Ids are small non-zero integers assigned once, in the mcpKey namespace.
+ * Flat objects record the id of each known key when it is inserted (by the
+ * parser or by the server), so looking up a McpKey in an object compares
+ * bytes rather than strings. A McpKey can be used wherever nlohmann accepts
+ * a key: find(), value(), contains(), operator[]...
+ */
+struct McpKey {
+  uint8_t id;            ///< Interned id, never 0
+  std::string_view name; ///< Key as it appears in messages
+
+  constexpr operator std::string_view() const { return name; }
+};
+
+inline bool operator==(const std::string &a, const McpKey &b) { return std::string_view(a) == b.name; }
+inline bool operator==(const McpKey &a, const std::string &b) { return a.name == std::string_view(b); }
+inline bool operator!=(const std::string &a, const McpKey &b) { return !(a == b); }
+inline bool operator!=(const McpKey &a, const std::string &b) { return !(a == b); }
+inline bool operator<(const std::string &a, const McpKey &b) { return std::string_view(a) < b.name; }
+inline bool operator<(const McpKey &a, const std::string &b) { return a.name < std::string_view(b); }
+
+namespace mcpKey {
+inline constexpr McpKey kJsonrpc{1, "jsonrpc"};
+inline constexpr McpKey kId{2, "id"};
+inline constexpr McpKey kMethod{3, "method"};
+inline constexpr McpKey kParams{4, "params"};
+inline constexpr McpKey kResult{5, "result"};
+inline constexpr McpKey kError{6, "error"};
+inline constexpr McpKey kCode{7, "code"};
+inline constexpr McpKey kMessage{8, "message"};
+inline constexpr McpKey kData{9, "data"};
+inline constexpr McpKey kContent{10, "content"};
+inline constexpr McpKey kType{11, "type"};
+inline constexpr McpKey kText{12, "text"};
+inline constexpr McpKey kIsError{13, "isError"};
+inline constexpr McpKey kName{14, "name"};
+inline constexpr McpKey kArguments{15, "arguments"};
+inline constexpr McpKey kMeta{16, "_meta"};
+inline constexpr McpKey kProgressToken{17, "progressToken"};
+
+/// Ids of the keys above, by name
+inline constexpr auto kSymbols = makePerfectHashTable<uint8_t, 17>({{
+    {kJsonrpc.name, kJsonrpc.id},
+    {kId.name, kId.id},
+    {kMethod.name, kMethod.id},
+    {kParams.name, kParams.id},
+    {kResult.name, kResult.id},
+    {kError.name, kError.id},
+    {kCode.name, kCode.id},
+    {kMessage.name, kMessage.id},
+    {kData.name, kData.id},
+    {kContent.name, kContent.id},
+    {kType.name, kType.id},
+    {kText.name, kText.id},
+    {kIsError.name, kIsError.id},
+    {kName.name, kName.id},
+    {kArguments.name, kArguments.id},
+    {kMeta.name, kMeta.id},
+    {kProgressToken.name, kProgressToken.id},
+}});
+
+/**
+ * @brief Interned id of a key
+ * @param name Key to resolve
+ * @return Id of the protocol key, or 0 for any other key
+ */
+inline uint8_t intern(std::string_view name) {
+  if (name.size() < 2 || name.size() > 13) {
+    return 0;
+  }
+  const uint8_t *id = kSymbols.find(name);
+  return id != nullptr ? *id : 0;
+}
+} // namespace mcpKey
+
+// ============================================================================
+// Flat JSON Objects
+// ============================================================================
+
+/**
+ * @brief Insertion-ordered object storage for nlohmann::basic_json
+ *
+ * Members are kept in one contiguous vector, in insertion order. Objects
+ * of up to kHashThreshold members (the request envelope, params, content
+ * items...) are searched linearly, which is faster than hashing or tree
+ * search at that size and costs no allocation per key. Larger objects also
+ * keep an open-addressing table of member positions, maintained on every
+ * update, so lookups stay constant time and const lookups never write.
+ *
+ * The first kSymbolCount members also have the interned id of their key
+ * (see McpKey) packed in one word, so finding a protocol key in a small
+ * object is a few word operations, without reading any key.
+ *
+ * Equality does not depend on member order. Erasing shifts the following
+ * members, like nlohmann::ordered_map.
+ */
+template <class Key, class T, class IgnoredLess = std::less<Key>,
+          class Allocator = std::allocator<std::pair<const Key, T>>>
+class McpFlatMap
+    : private std::vector<std::pair<Key, T>,
+                          typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<Key, T>>> {
+public:
+  // Keys are not const, so that members move (rather than copy) when the vector grows
+  using Container =
+      std::vector<std::pair<Key, T>, typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<Key, T>>>;
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = typename Container::value_type;
+  using size_type = typename Container::size_type;
+  using difference_type = typename Container::difference_type;
+  using allocator_type = typename Container::allocator_type;
+  using reference = typename Container::reference;
+  using const_reference = typename Container::const_reference;
+  using iterator = typename Container::iterator;
+  using const_iterator = typename Container::const_iterator;
+  using key_compare = std::equal_to<>;
+
+  static constexpr size_type kHashThreshold = 8; ///< Largest object searched linearly
+  static constexpr size_type kInitialCapacity = 4; ///< Members allocated with the first one
+  static constexpr size_type kSymbolCount = 8; ///< Members whose key id is recorded
+
+private:
+  static_assert(kSymbolCount >= kHashThreshold, "small objects are searched by key id");
+  static constexpr uint64_t kLowBytes = 0x0101010101010101ull;
+
+  std::vector<uint32_t> fSlots; ///< Member position + 1, 0 if empty (only above kHashThreshold)
+  uint64_t fSymbols = 0;        ///< Key id of member i in byte i (0: not a protocol key)
+
+  static uint8_t symbol(const McpKey &key) { return key.id; }
+
+  template <class K>
+  static uint8_t symbol(const K &key) {
+    return mcpKey::intern(std::string_view(key));
+  }
+
+  void setSymbol(size_type position, uint8_t id) {
+    if (position < kSymbolCount) {
+      fSymbols |= uint64_t(id) << (8 * position);
+    }
+  }
+
+  const value_type &member(size_type position) const { return Container::operator[](position); }
+
+  template <class K>
+  static std::size_t hash(const K &key) {
+    return std::hash<std::string_view>()(std::string_view(key));
+  }
+
+  void place(size_type position) {
+    std::size_t mask = fSlots.size() - 1;
+    for (std::size_t slot = hash(member(position).first) & mask;; slot = (slot + 1) & mask) {
+      if (fSlots[slot] == 0) {
+        fSlots[slot] = static_cast<uint32_t>(position + 1);
+        return;
+      }
+    }
+  }
+
+  void reindex() {
+    fSymbols = 0;
+    for (size_type position = 0; position < this->size() && position < kSymbolCount; ++position) {
+      setSymbol(position, symbol(member(position).first));
+    }
+    fSlots.clear();
+    if (this->size() <= kHashThreshold) {
+      fSlots.shrink_to_fit();
+      return;
+    }
+    std::size_t slots = 32;
+    while (slots < this->size() * 2) {
+      slots *= 2;
+    }
+    fSlots.assign(slots, 0);
+    for (size_type position = 0; position < this->size(); ++position) {
+      place(position);
+    }
+  }
+
+  // Index the member just appended
+  void appended() {
+    if (this->size() <= kHashThreshold) {
+      return;
+    }
+    if (this->size() * 2 > fSlots.size()) {
+      reindex();
+    } else {
+      place(this->size() - 1);
+    }
+  }
+
+  template <class K>
+  size_type position(const K &key) const {
+    if (fSlots.empty()) {
+      for (size_type i = 0; i < this->size(); ++i) {
+        if (member(i).first == key) {
+          return i;
+        }
+      }
+      return this->size();
+    }
+    std::size_t mask = fSlots.size() - 1;
+    for (std::size_t slot = hash(key) & mask; fSlots[slot] != 0; slot = (slot + 1) & mask) {
+      size_type candidate = fSlots[slot] - 1;
+      if (member(candidate).first == key) {
+        return candidate;
+      }
+    }
+    return this->size();
+  }
+
+  size_type position(const McpKey &key) const {
+    if (!fSlots.empty()) {
+      return position(key.name);
+    }
+    // Bytes equal to the id become zero; the lowest flagged byte is the first match
+    uint64_t matches = fSymbols ^ (key.id * kLowBytes);
+    matches = (matches - kLowBytes) & ~matches & (kLowBytes << 7);
+    return matches != 0 ? static_cast<size_type>(__builtin_ctzll(matches) / 8) : this->size();
+  }
+
+  // Members in key order, to compare objects regardless of insertion order
+  std::vector<const value_type *> sorted() const {
+    std::vector<const value_type *> members;
+    members.reserve(this->size());
+    for (const value_type &member : *this) {
+      members.push_back(&member);
+    }
+    std::sort(members.begin(), members.end(),
+              [](const value_type *a, const value_type *b) { return a->first < b->first; });
+    return members;
+  }
+
+public:
+  McpFlatMap() noexcept(noexcept(Container())) : Container{} {}
+  explicit McpFlatMap(const Allocator &alloc) : Container{allocator_type(alloc)} {}
+  template <class It>
+  McpFlatMap(It first, It last, const Allocator &alloc = Allocator()) : Container{allocator_type(alloc)} {
+    insert(first, last);
+  }
+  McpFlatMap(std::initializer_list<value_type> init, const Allocator &alloc = Allocator())
+      : Container{allocator_type(alloc)} {
+    Container::reserve(init.size());
+    insert(init.begin(), init.end());
+  }
+
+  using Container::begin;
+  using Container::cbegin;
+  using Container::cend;
+  using Container::empty;
+  using Container::end;
+  using Container::get_allocator;
+  using Container::max_size;
+  using Container::size;
+
+  template <class KeyType, class... Args>
+  std::pair<iterator, bool> emplace(KeyType &&key, Args &&...args) {
+    size_type found = position(key);
+    if (found < this->size()) {
+      return {begin() + found, false};
+    }
+    if (Container::capacity() == 0) {
+      Container::reserve(kInitialCapacity);
+    }
+    uint8_t id = symbol(key);
+    Container::emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyType>(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    setSymbol(this->size() - 1, id);
+    appended();
+    return {std::prev(end()), true};
+  }
+
+  std::pair<iterator, bool> insert(value_type &&value) { return emplace(value.first, std::move(value.second)); }
+
+  std::pair<iterator, bool> insert(const value_type &value) { return emplace(value.first, value.second); }
+
+  template <class InputIt,
+            class = std::enable_if_t<std::is_convertible<typename std::iterator_traits<InputIt>::iterator_category,
+                                                         std::input_iterator_tag>::value>>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  template <class KeyType>
+  T &operator[](KeyType &&key) {
+    return emplace(std::forward<KeyType>(key)).first->second;
+  }
+
+  template <class KeyType>
+  T &at(const KeyType &key) {
+    size_type found = position(key);
+    if (found == this->size()) {
+      throw std::out_of_range("key not found");
+    }
+    return Container::operator[](found).second;
+  }
+
+  template <class KeyType>
+  const T &at(const KeyType &key) const {
+    size_type found = position(key);
+    if (found == this->size()) {
+      throw std::out_of_range("key not found");
+    }
+    return Container::operator[](found).second;
+  }
+
+  template <class KeyType>
+  const T &operator[](const KeyType &key) const {
+    return at(key);
+  }
+
+  template <class KeyType>
+  iterator find(const KeyType &key) {
+    return begin() + position(key);
+  }
+
+  template <class KeyType>
+  const_iterator find(const KeyType &key) const {
+    return begin() + position(key);
+  }
+
+  template <class KeyType>
+  size_type count(const KeyType &key) const {
+    return position(key) < this->size() ? 1 : 0;
+  }
+
+  iterator erase(iterator first, iterator last) {
+    if (first == last) {
+      return first;
+    }
+    difference_type offset = std::distance(begin(), first);
+    Container::erase(first, last);
+    reindex();
+    return begin() + offset;
+  }
+
+  iterator erase(iterator pos) { return erase(pos, std::next(pos)); }
+
+  iterator erase(const_iterator pos) { return erase(begin() + std::distance(cbegin(), pos)); }
+
+  template <class KeyType, class = std::enable_if_t<!std::is_convertible<KeyType, const_iterator>::value>>
+  size_type erase(const KeyType &key) {
+    size_type found = position(key);
+    if (found == this->size()) {
+      return 0;
+    }
+    erase(begin() + found);
+    return 1;
+  }
+
+  void clear() noexcept {
+    Container::clear();
+    fSlots.clear();
+    fSymbols = 0;
+  }
+
+  friend bool operator==(const McpFlatMap &a, const McpFlatMap &b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (const value_type &member : a) {
+      auto other = b.find(member.first);
+      if (other == b.end() || !(other->second == member.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const McpFlatMap &a, const McpFlatMap &b) { return !(a == b); }
+
+  friend bool operator<(const McpFlatMap &a, const McpFlatMap &b) {
+    std::vector<const value_type *> left = a.sorted();
+    std::vector<const value_type *> right = b.sorted();
+    return std::lexicographical_compare(left.begin(), left.end(), right.begin(), right.end(),
+                                        [](const value_type *x, const value_type *y) { return *x < *y; });
+  }
+};
+
+/**
+ * @brief The JSON type used throughout the server and its tools
+ *
+ * Objects keep their members in insertion order (see McpFlatMap), so
+ * responses list "jsonrpc", "id" and "result" in the order they are built.
+ * Defining MCP_JSON_SORTED_OBJECTS selects nlohmann's std::map objects,
+ * sorted by key, instead.
+ */
+#if defined(MCP_JSON_SORTED_OBJECTS)
+using json = nlohmann::json;
+#else
+using json = nlohmann::basic_json<McpFlatMap>;
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <string>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "mcpHugePages.hh"
+
+// ============================================================================
+// Line Reader
+// ============================================================================
+
+/**
+ * @brief Reads newline-terminated messages from a file descriptor
+ *
+ * Unlike std::getline on std::cin, waiting for input can be interrupted: the
+ * reader sleeps in ppoll() with the given signal mask, so a stop signal that
+ * is blocked elsewhere is delivered exactly while the reader waits, and the
+ * stop flag is checked before every line. Bytes read past the last returned
+ * line stay available through pending(). A message of a huge page or more
+ * is buffered in huge pages (see McpHugePages).
+ */
+class McpLineReader {
+private:
+  int fFd;                             ///< Input file descriptor
+  const std::atomic<bool> *fStopFlag;  ///< Stops reading when set
+  const sigset_t *fWaitMask;           ///< Signal mask applied while waiting
+  McpBuffer fBuffer;                   ///< Bytes read but not yet returned
+  std::size_t fStart = 0;              ///< Start of unconsumed bytes in fBuffer
+  bool fEof = false;                   ///< End of input reached
+
+  static constexpr std::size_t kChunkSize = 64 * 1024;
+
+  // Wait for input, then append what is available to fBuffer
+  bool fill() {
+    struct pollfd pfd = {fFd, POLLIN, 0};
+    if (ppoll(&pfd, 1, nullptr, fWaitMask) < 0) {
+      // EINTR: a signal arrived, loop back to check the stop flag
+      return errno == EINTR;
+    }
+
+    // Drop consumed bytes; only a partial line is moved
+    fBuffer.erase(0, fStart);
+    fStart = 0;
+    std::size_t size = fBuffer.size();
+    fBuffer.resize(size + kChunkSize);
+    ssize_t count = ::read(fFd, &fBuffer[size], kChunkSize);
+    fBuffer.resize(size + (count > 0 ? count : 0));
+    if (count == 0 || (count < 0 && errno != EINTR && errno != EAGAIN)) {
+      fEof = true;
+    }
+    return true;
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param fd File descriptor to read from
+   * @param stopFlag Flag that interrupts reading when set (may be null)
+   * @param waitMask Signal mask used while waiting for input (null keeps the current one)
+   */
+  explicit McpLineReader(int fd, const std::atomic<bool> *stopFlag = nullptr,
+                         const sigset_t *waitMask = nullptr)
+      : fFd(fd), fStopFlag(stopFlag), fWaitMask(waitMask) {}
+
+  /**
+   * @brief Read the next line (without its terminating newline)
+   * @param line Receives the line
+   * @return false at end of input or when the stop flag is set
+   */
+  bool readLine(McpBuffer &line) {
+    while (true) {
+      if (fStopFlag != nullptr && fStopFlag->load()) {
+        return false;
+      }
+      std::size_t end = fBuffer.find('\n', fStart);
+      if (end != McpBuffer::npos) {
+        line.assign(fBuffer, fStart, end - fStart);
+        fStart = end + 1;
+        return true;
+      }
+      if (fEof) {
+        // Last line without a trailing newline
+        if (fStart < fBuffer.size()) {
+          line.assign(fBuffer, fStart, McpBuffer::npos);
+          fStart = fBuffer.size();
+          return true;
+        }
+        return false;
+      }
+      if (!fill()) {
+        return false;
+      }
+    }
+  }
+
+  /**
+   * @brief Push bytes back in front of the unread input
+   * @param bytes Bytes to return before anything still to be read
+   */
+  void unread(const std::string &bytes) {
+    fBuffer.insert(fStart, bytes);
+  }
+
+  /**
+   * @brief Bytes received but not yet returned as a line
+   */
+  std::string pending() const { return std::string(fBuffer.data() + fStart, fBuffer.size() - fStart); }
+};
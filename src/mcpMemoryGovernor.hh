@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+#include "mcpAllocator.hh"
+
+// ============================================================================
+// Memory Governor
+// ============================================================================
+
+/**
+ * @brief Per-request and global heap budgets
+ *
+ * When budgets are configured, every operator new and delete updates a
+ * process-wide count of live heap bytes, and allocations made by a thread
+ * inside a Scope are also charged to that scope's Account: the request
+ * being parsed, executed or answered. An allocation that would take the
+ * account past the request budget, or the process past the global budget,
+ * throws BudgetExceeded instead. The server turns it into a JSON-RPC error
+ * for that request alone. Allocations outside any scope (the server's own
+ * bookkeeping, threads started by tools) are counted but never refused.
+ *
+ * An account throws once: the allocations made while the exception unwinds
+ * and the error is reported succeed, so the request can be answered.
+ *
+ * Frees are not credited back to accounts: blocks do not record their
+ * owner, and a block is often freed by another request (a cached result,
+ * a recycled buffer) or after its request has ended. The request budget
+ * therefore bounds the bytes a request allocates, while the global budget
+ * bounds the bytes live in the process.
+ *
+ * Budgets cover the heap (operator new and huge page buffers), not file
+ * mappings or thread stacks. Without budgets, the only cost is one relaxed
+ * load per allocation.
+ */
+class McpMemoryGovernor {
+public:
+  /// Thrown by operator new when an allocation would exceed a budget
+  class BudgetExceeded : public std::bad_alloc {
+  public:
+    const char *what() const noexcept override { return "memory budget exceeded"; }
+  };
+
+  /// Memory charged to one request, possibly from several threads
+  class Account {
+    friend class McpMemoryGovernor;
+    std::atomic<int64_t> fAllocated{0}; ///< Bytes allocated within its scopes
+    std::atomic<bool> fExceeded{false}; ///< A budget was exceeded (the account no longer throws)
+    std::atomic<bool> fGlobal{false};   ///< The global budget was the one exceeded
+
+  public:
+    std::size_t allocated() const { return static_cast<std::size_t>(fAllocated.load(std::memory_order_relaxed)); }
+    bool exceeded() const { return fExceeded.load(std::memory_order_acquire); }
+    bool globalBudgetExceeded() const { return fGlobal.load(std::memory_order_relaxed); }
+  };
+
+  /// Charges the allocations of the current thread to an account (none if null)
+  class Scope {
+    Account *fPrevious;
+
+  public:
+    explicit Scope(Account *account) : fPrevious(sCurrent) { sCurrent = account; }
+    ~Scope() { sCurrent = fPrevious; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  /// Counters, for metrics
+  struct Stats {
+    std::size_t globalBudget;  ///< Bytes (0: none)
+    std::size_t requestBudget; ///< Bytes (0: none)
+    int64_t liveBytes;         ///< Heap bytes allocated and not yet freed
+    int64_t peakBytes;         ///< Highest liveBytes
+    uint64_t exceeded;         ///< Requests stopped by a budget
+    uint64_t shed;             ///< Requests refused on arrival
+  };
+
+private:
+  static inline std::atomic<bool> sEnabled{false};
+  static inline std::size_t sGlobalBudget = 0;
+  static inline std::size_t sRequestBudget = 0;
+  static inline std::atomic<int64_t> sLive{0};
+  static inline std::atomic<int64_t> sPeak{0};
+  static inline std::atomic<uint64_t> sExceeded{0};
+  static inline std::atomic<uint64_t> sShed{0};
+  static inline thread_local Account *sCurrent = nullptr;
+
+public:
+  /**
+   * @brief Set the budgets; call before the server starts
+   * @param globalBudget Live heap bytes allowed to the process (0: no limit)
+   * @param requestBudget Bytes one request may allocate (0: no limit)
+   */
+  static void configure(std::size_t globalBudget, std::size_t requestBudget) {
+    sGlobalBudget = globalBudget;
+    sRequestBudget = requestBudget;
+    sEnabled = globalBudget > 0 || requestBudget > 0;
+  }
+
+  static bool enabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+  static std::size_t requestBudget() { return sRequestBudget; }
+
+  static std::size_t globalBudget() { return sGlobalBudget; }
+
+  /**
+   * @brief Decide whether a new request can be accepted
+   * @param reserve Bytes the request is expected to need (its size, at least)
+   * @return false, and the request is counted as shed, when it cannot fit
+   */
+  static bool admit(std::size_t reserve) {
+    if (!enabled()) {
+      return true;
+    }
+    bool fits = (sRequestBudget == 0 || reserve <= sRequestBudget) &&
+                (sGlobalBudget == 0 ||
+                 sLive.load(std::memory_order_relaxed) + static_cast<int64_t>(reserve) <= int64_t(sGlobalBudget));
+    if (!fits) {
+      sShed.fetch_add(1, std::memory_order_relaxed);
+    }
+    return fits;
+  }
+
+  /**
+   * @brief Account for a new block (called by operator new when enabled)
+   * @param bytes Usable size of the block
+   * @return false if the block must be freed and BudgetExceeded thrown
+   */
+  static bool onAllocate(std::size_t bytes) {
+    int64_t size = static_cast<int64_t>(bytes);
+    int64_t live = sLive.fetch_add(size, std::memory_order_relaxed) + size;
+    Account *account = sCurrent;
+    if (account != nullptr && !account->fExceeded.load(std::memory_order_relaxed)) {
+      int64_t allocated = account->fAllocated.fetch_add(size, std::memory_order_relaxed) + size;
+      bool overRequest = sRequestBudget > 0 && allocated > int64_t(sRequestBudget);
+      bool overGlobal = sGlobalBudget > 0 && live > int64_t(sGlobalBudget);
+      // Only the first thread to exceed the budget throws
+      if ((overRequest || overGlobal) && !account->fExceeded.exchange(true, std::memory_order_acq_rel)) {
+        account->fGlobal.store(!overRequest, std::memory_order_relaxed);
+        account->fAllocated.fetch_sub(size, std::memory_order_relaxed);
+        sLive.fetch_sub(size, std::memory_order_relaxed);
+        sExceeded.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+    int64_t peak = sPeak.load(std::memory_order_relaxed);
+    while (live > peak && !sPeak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return true;
+  }
+
+  /// Account for a freed block (called by operator delete when enabled)
+  static void onFree(std::size_t bytes) { sLive.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed); }
+
+  static Stats stats() {
+    return {sGlobalBudget,
+            sRequestBudget,
+            std::max<int64_t>(sLive.load(std::memory_order_relaxed), 0),
+            sPeak.load(std::memory_order_relaxed),
+            sExceeded.load(std::memory_order_relaxed),
+            sShed.load(std::memory_order_relaxed)};
+  }
+};
+
+// ============================================================================
+// Global Allocation Functions
+// ============================================================================
+
+// Defined by the one translation unit that defines
+// MCP_DEFINE_ALLOCATION_FUNCTIONS before including this header (hello.cpp):
+// blocks come from McpAllocator when built with MCP_ALLOCATOR, from malloc
+// otherwise, and are reported to the governor when budgets are set. The
+// aligned forms keep their default implementation. A program that does not
+// define the macro keeps the standard functions: only huge page buffers
+// are then charged to the governor.
+
+inline void *mcpAllocateBlock(std::size_t size) {
+#if defined(MCP_ALLOCATOR)
+  return McpAllocator::allocate(size);
+#else
+  return std::malloc(size == 0 ? 1 : size);
+#endif
+}
+
+inline void mcpFreeBlock(void *block) {
+#if defined(MCP_ALLOCATOR)
+  McpAllocator::deallocate(block);
+#else
+  std::free(block);
+#endif
+}
+
+inline std::size_t mcpBlockSize(void *block) {
+#if defined(MCP_ALLOCATOR)
+  return McpAllocator::blockSize(block);
+#else
+  return malloc_usable_size(block);
+#endif
+}
+
+// Allocate and charge a block: nullptr when out of memory, throws
+// BudgetExceeded when over budget
+inline void *mcpGovernedAllocate(std::size_t size) {
+  void *block = mcpAllocateBlock(size);
+  if (block != nullptr && McpMemoryGovernor::enabled() && !McpMemoryGovernor::onAllocate(mcpBlockSize(block))) {
+    mcpFreeBlock(block);
+    throw McpMemoryGovernor::BudgetExceeded();
+  }
+  return block;
+}
+
+inline void mcpGovernedFree(void *block) {
+  if (block != nullptr && McpMemoryGovernor::enabled()) {
+    McpMemoryGovernor::onFree(mcpBlockSize(block));
+  }
+  mcpFreeBlock(block);
+}
+
+#if defined(MCP_DEFINE_ALLOCATION_FUNCTIONS)
+
+// The replacements are built on malloc and free: GCC, seeing free() inlined
+// into operator delete, would report it as mismatched with operator new
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(std::size_t size) {
+  if (void *block = mcpGovernedAllocate(size)) {
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return mcpGovernedAllocate(size);
+  } catch (const McpMemoryGovernor::BudgetExceeded &) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void *block) noexcept { mcpGovernedFree(block); }
+
+void operator delete[](void *block) noexcept { mcpGovernedFree(block); }
+
+void operator delete(void *block, std::size_t) noexcept { mcpGovernedFree(block); }
+
+void operator delete[](void *block, std::size_t) noexcept { mcpGovernedFree(block); }
+
+void operator delete(void *block, const std::nothrow_t &) noexcept { mcpGovernedFree(block); }
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept { mcpGovernedFree(block); }
+
+#pragma GCC diagnostic pop
+
+#endif
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+// ============================================================================
+// Token-Bucket Rate Limiter
+// ============================================================================
+
+/**
+ * @brief Token-bucket limiter keyed by (session, tool)
+ *
+ * Each key owns a bucket refilled at a constant rate up to a burst size; a
+ * call consumes one token. Buckets live in a fixed open-addressing table of
+ * atomic slots, so checking a call takes no lock. A bucket idle for longer
+ * than the slowest configured refill is full again, carries no information,
+ * and its slot is reused by the next key that needs one.
+ *
+ * Limits are configured before the server starts; a limit of 0 calls per
+ * second disables limiting. A bucket holds at most kMaxBurst tokens: the
+ * packed state leaves 24 bits to the milli-token count.
+ */
+class McpRateLimiter {
+public:
+  static constexpr double kMaxBurst = ((uint64_t(1) << 24) - 1) / 1000; ///< Largest burst, in calls
+
+private:
+  struct Limit {
+    double rate = 0;  ///< Milli-tokens added per ms (= tokens per second)
+    double burst = 0; ///< Bucket capacity
+  };
+
+  /// Bucket state: milli-tokens in the high 24 bits, last refill time (ms
+  /// since limiter creation) in the low 40 bits
+  struct Slot {
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> state{0};
+  };
+
+  static constexpr std::size_t kSlots = 4096;   ///< Table size (power of two)
+  static constexpr std::size_t kProbes = 16;    ///< Max probe length
+  static constexpr int kTimeBits = 40;
+  static constexpr uint64_t kTimeMask = (uint64_t(1) << kTimeBits) - 1;
+  static constexpr uint64_t kMaxMilliTokens = (uint64_t(1) << 24) - 1;
+
+  Limit fDefault;                        ///< Limit applied to every tool
+  std::map<std::string, Limit> fPerTool; ///< Tool-specific overrides
+  uint64_t fExpiryMs = 0;                ///< Idle time after which any bucket is full
+  std::array<Slot, kSlots> fSlots;       ///< Bucket table
+  std::chrono::steady_clock::time_point fEpoch = std::chrono::steady_clock::now();
+
+  static uint64_t hashKey(const std::string &session, const std::string &tool) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const std::string &s) {
+      for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+      }
+      h ^= 0xFF; // separator, so ("ab","c") and ("a","bc") differ
+      h *= 1099511628211ull;
+    };
+    mix(session);
+    mix(tool);
+    return h == 0 ? 1 : h; // 0 marks an empty slot
+  }
+
+  static uint64_t pack(uint64_t milliTokens, uint64_t nowMs) {
+    return (std::min(milliTokens, kMaxMilliTokens) << kTimeBits) | (nowMs & kTimeMask);
+  }
+
+  const Limit &limitFor(const std::string &tool) const {
+    auto entry = fPerTool.find(tool);
+    return entry == fPerTool.end() ? fDefault : entry->second;
+  }
+
+  uint64_t nowMs() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - fEpoch)
+        .count();
+  }
+
+  // Tokens available at time now, given a packed state
+  static uint64_t refill(uint64_t state, uint64_t now, const Limit &limit) {
+    uint64_t tokens = state >> kTimeBits;
+    uint64_t last = state & kTimeMask;
+    uint64_t elapsed = now > last ? now - last : 0;
+    double refilled = tokens + elapsed * limit.rate; // milli-tokens
+    return static_cast<uint64_t>(std::min(refilled, limit.burst * 1000));
+  }
+
+  Limit makeLimit(double callsPerSecond, double burst) {
+    if (burst > kMaxBurst) {
+      throw std::invalid_argument("Rate limit burst above " + std::to_string(int(kMaxBurst)) + " calls");
+    }
+    Limit limit{callsPerSecond, std::max(burst, 1.0)};
+    if (callsPerSecond > 0) {
+      fExpiryMs = std::max(fExpiryMs, static_cast<uint64_t>(
+                                          std::ceil(limit.burst * 1000 / callsPerSecond)));
+    }
+    return limit;
+  }
+
+  // Find or claim the slot of a key; nullptr when the probe window is full.
+  // The whole window is searched for the key before a slot is claimed: an
+  // expired slot ahead of the key's own would otherwise give it a second,
+  // full bucket.
+  Slot *findSlot(uint64_t key, uint64_t now, const Limit &limit) {
+    for (std::size_t i = 0; i < kProbes; ++i) {
+      Slot &slot = fSlots[(key + i) & (kSlots - 1)];
+      if (slot.key.load(std::memory_order_acquire) == key) {
+        return &slot;
+      }
+    }
+    uint64_t full = static_cast<uint64_t>(limit.burst * 1000);
+    for (std::size_t i = 0; i < kProbes; ++i) {
+      Slot &slot = fSlots[(key + i) & (kSlots - 1)];
+      uint64_t current = slot.key.load(std::memory_order_acquire);
+      if (current == key) {
+        return &slot;
+      }
+      uint64_t last = slot.state.load(std::memory_order_relaxed) & kTimeMask;
+      if (current == 0 || (now > last && now - last >= fExpiryMs)) {
+        // Empty or fully refilled (expired) slot: take it over
+        if (slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+          slot.state.store(pack(full, now), std::memory_order_release);
+          return &slot;
+        }
+        if (current == key) {
+          return &slot;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+public:
+  /**
+   * @brief Set the limit applied to every tool without a specific limit
+   * @param callsPerSecond Sustained call rate (0 disables limiting)
+   * @param burst Number of calls allowed back to back (at most kMaxBurst)
+   * @throws std::invalid_argument if burst exceeds kMaxBurst
+   */
+  void setDefaultLimit(double callsPerSecond, double burst) {
+    fDefault = makeLimit(callsPerSecond, burst);
+  }
+
+  /**
+   * @brief Set the limit of a specific tool
+   * @param tool Tool name
+   * @param callsPerSecond Sustained call rate (0 disables limiting)
+   * @param burst Number of calls allowed back to back (at most kMaxBurst)
+   * @throws std::invalid_argument if burst exceeds kMaxBurst
+   */
+  void setToolLimit(const std::string &tool, double callsPerSecond, double burst) {
+    fPerTool[tool] = makeLimit(callsPerSecond, burst);
+  }
+
+  /**
+   * @brief Try to consume one token for a call
+   * @param session Session issuing the call
+   * @param tool Tool being called
+   * @return 0 if the call is allowed, otherwise the suggested retry delay in ms
+   */
+  uint64_t tryAcquire(const std::string &session, const std::string &tool) {
+    const Limit &limit = limitFor(tool);
+    if (limit.rate <= 0) {
+      return 0;
+    }
+
+    uint64_t now = nowMs();
+    Slot *slot = findSlot(hashKey(session, tool), now, limit);
+    if (slot == nullptr) {
+      return 0; // table saturated: fail open rather than reject
+    }
+
+    uint64_t state = slot->state.load(std::memory_order_acquire);
+    while (true) {
+      uint64_t tokens = refill(state, now, limit);
+      if (tokens < 1000) {
+        return static_cast<uint64_t>(std::ceil((1000 - tokens) / limit.rate));
+      }
+      if (slot->state.compare_exchange_weak(state, pack(tokens - 1000, now),
+                                            std::memory_order_acq_rel)) {
+        return 0;
+      }
+    }
+  }
+};
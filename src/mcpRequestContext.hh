@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mcpHugePages.hh"
+#include "mcpJson.hh"
+
+// ============================================================================
+// Request Context
+// ============================================================================
+
+/**
+ * @brief Buffers and values used to process one message, recycled between messages
+ *
+ * A context holds the raw input line, the parsed request and the buffer its
+ * response is serialized into. Contexts are taken from a small per-thread
+ * pool and go back to the pool of the thread that releases them, with their
+ * string capacity intact, so a steady stream of messages of similar sizes
+ * makes no allocator round trip for these buffers. A buffer grown past
+ * kHighWater by an exceptional message is freed when its context is
+ * released, so one large request does not pin its memory for the session.
+ * Buffers of a huge page or more are mapped through McpHugePages; the
+ * high-water mark spans two huge pages, so a buffer that grew into them is
+ * reused instead of being unmapped and mapped again by the next message.
+ */
+class McpRequestContext {
+public:
+  McpBuffer line;   ///< Raw message, without its newline
+  json request;     ///< Parsed message
+  McpBuffer output; ///< Serialized outgoing message
+
+  /// Returns a context to the pool of the current thread
+  struct Release {
+    void operator()(McpRequestContext *context) const { McpRequestContext::release(context); }
+  };
+  using Handle = std::unique_ptr<McpRequestContext, Release>;
+
+  /// Pool counters, for metrics
+  struct Stats {
+    uint64_t created;  ///< Contexts allocated
+    uint64_t reused;   ///< Contexts taken from a pool
+    uint64_t trimmed;  ///< Buffers freed for exceeding kHighWater
+  };
+
+private:
+  static constexpr std::size_t kPoolSize = 4;         ///< Contexts kept per thread
+  static constexpr std::size_t kHighWater = 2 * McpHugePages::kPageSize; ///< Largest buffer capacity kept
+
+  static inline std::atomic<uint64_t> sCreated{0};
+  static inline std::atomic<uint64_t> sReused{0};
+  static inline std::atomic<uint64_t> sTrimmed{0};
+
+  static std::vector<std::unique_ptr<McpRequestContext>> &pool() {
+    thread_local std::vector<std::unique_ptr<McpRequestContext>> contexts;
+    return contexts;
+  }
+
+  static void trim(McpBuffer &buffer) {
+    if (buffer.capacity() > kHighWater) {
+      McpBuffer().swap(buffer);
+      sTrimmed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      buffer.clear();
+    }
+  }
+
+  static void release(McpRequestContext *context) {
+    std::unique_ptr<McpRequestContext> owned(context);
+    trim(owned->line);
+    trim(owned->output);
+    owned->request = nullptr;
+    std::vector<std::unique_ptr<McpRequestContext>> &contexts = pool();
+    if (contexts.size() < kPoolSize) {
+      contexts.push_back(std::move(owned));
+    }
+  }
+
+public:
+  /**
+   * @brief Take a context from the pool of the current thread, or allocate one
+   * @return Empty context, returned to a pool when the handle is destroyed
+   */
+  static Handle acquire() {
+    std::vector<std::unique_ptr<McpRequestContext>> &contexts = pool();
+    if (contexts.empty()) {
+      sCreated.fetch_add(1, std::memory_order_relaxed);
+      return Handle(new McpRequestContext());
+    }
+    sReused.fetch_add(1, std::memory_order_relaxed);
+    Handle context(contexts.back().release());
+    contexts.pop_back();
+    return context;
+  }
+
+  /**
+   * @brief Serialize a message into 'output', reusing its capacity
+   * @param message Message to serialize (invalid UTF-8 is replaced)
+   * @return The serialized message, valid until the next call
+   */
+  const McpBuffer &serialize(const json &message) {
+    output.clear();
+    return append(message);
+  }
+
+  /**
+   * @brief Serialize a value at the end of 'output'
+   * @param value Value to serialize (invalid UTF-8 is replaced)
+   * @return 'output'
+   */
+  const McpBuffer &append(const json &value) {
+    nlohmann::detail::serializer<json> serializer(nlohmann::detail::output_adapter<char, McpBuffer>(output), ' ',
+                                                  json::error_handler_t::replace);
+    serializer.dump(value, false, false, 0);
+    return output;
+  }
+
+  /// Counters of all pools
+  static Stats stats() {
+    return {sCreated.load(std::memory_order_relaxed), sReused.load(std::memory_order_relaxed),
+            sTrimmed.load(std::memory_order_relaxed)};
+  }
+};
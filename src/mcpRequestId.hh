@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "mcpJson.hh"
+
+// ============================================================================
+// Request Ids
+// ============================================================================
+
+/**
+ * @brief Id of a JSON-RPC request, kept as the bytes the client sent
+ *
+ * The id is located in the text of the request rather than taken from the
+ * parsed value, and written back verbatim in the response: it is never
+ * formatted again, and escaped string or non-integer ids ("\u00e9", 1.0, 1e3)
+ * come back exactly as they were sent. Small ids fit in the string's
+ * inline buffer, so copying an id to a worker thread does not allocate.
+ */
+class McpRequestId {
+  std::string fText; ///< JSON text of the id
+
+public:
+  /// The null id, for messages without one or that cannot be parsed
+  McpRequestId() : fText("null") {}
+
+  /// Id from its JSON text, which is not validated
+  explicit McpRequestId(std::string text) : fText(std::move(text)) {}
+
+  /// Id from a parsed value, for ids the scanner cannot locate
+  explicit McpRequestId(const json &value) : fText(value.dump()) {}
+
+  /// JSON text of the id, as written in responses
+  const std::string &text() const { return fText; }
+
+  bool isNull() const { return fText == "null"; }
+
+  /**
+   * @brief Find the id of a message
+   * @param message Text of a message already parsed successfully
+   * @param key Name of the member holding the id
+   * @return The member's text, or the null id if the message has none
+   */
+  static McpRequestId find(std::string_view message, std::string_view key = "id") {
+    std::string_view text = rawMember(message, key);
+    return text.empty() ? McpRequestId() : McpRequestId(std::string(text));
+  }
+
+  /**
+   * @brief Locate a member of a JSON object in its text
+   *
+   * The text must be valid JSON (the scanner only skips over values). Keys
+   * are compared byte for byte, so a key written with escapes is not
+   * found. As in the parsed value, the last duplicate wins.
+   *
+   * @param object Text of a JSON object
+   * @param key Member name
+   * @return Text of the member's value, or an empty view
+   */
+  static std::string_view rawMember(std::string_view object, std::string_view key) {
+    std::string_view found;
+    std::size_t pos = skipSpace(object, 0);
+    if (pos >= object.size() || object[pos] != '{') {
+      return found;
+    }
+    pos = skipSpace(object, pos + 1);
+    while (pos < object.size() && object[pos] == '"') {
+      std::size_t nameEnd = skipValue(object, pos);
+      std::string_view name = object.substr(pos + 1, nameEnd - pos - 2);
+      pos = skipSpace(object, nameEnd);
+      if (pos >= object.size() || object[pos] != ':') {
+        break;
+      }
+      std::size_t valueBegin = skipSpace(object, pos + 1);
+      std::size_t valueEnd = skipValue(object, valueBegin);
+      if (name == key) {
+        found = object.substr(valueBegin, valueEnd - valueBegin);
+      }
+      pos = skipSpace(object, valueEnd);
+      if (pos < object.size() && object[pos] == ',') {
+        pos = skipSpace(object, pos + 1);
+      }
+    }
+    return found;
+  }
+
+private:
+  static std::size_t skipSpace(std::string_view text, std::size_t pos) {
+    while (pos < text.size() &&
+           (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+      ++pos;
+    }
+    return pos;
+  }
+
+  // End of the value starting at 'pos'
+  static std::size_t skipValue(std::string_view text, std::size_t pos) {
+    int depth = 0;
+    while (pos < text.size()) {
+      char c = text[pos];
+      if (c == '"') {
+        for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+          if (text[pos] == '\\') {
+            ++pos;
+          }
+        }
+        ++pos;
+      } else if (c == '{' || c == '[') {
+        ++depth;
+        ++pos;
+      } else if (c == '}' || c == ']') {
+        if (depth == 0) {
+          return pos;
+        }
+        --depth;
+        ++pos;
+      } else if (depth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+        return pos;
+      } else {
+        ++pos;
+      }
+      if (depth == 0 && (c == '"' || c == '}' || c == ']')) {
+        return std::min(pos, text.size());
+      }
+    }
+    return std::min(pos, text.size());
+  }
+};
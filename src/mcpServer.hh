@@ -1,17 +1,39 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
-#include "json.hpp"
-#include "mcpTool.hh"
+#include <sys/mman.h>
+#include <unistd.h>
 
-using json = nlohmann::json;
+#include "mcpJson.hh"
+#include "mcpAllocator.hh"
+#include "mcpCircuitBreaker.hh"
+#include "mcpHugePages.hh"
+#include "mcpLineReader.hh"
+#include "mcpMemoryGovernor.hh"
+#include "mcpRateLimiter.hh"
+#include "mcpRequestContext.hh"
+#include "mcpRequestId.hh"
+#include "mcpTool.hh"
+#include "mcpWorkerPool.hh"
 
 /**
  * @brief Simple MCP (Model Context Protocol) server implementation
@@ -19,6 +41,15 @@ using json = nlohmann::json;
  * This class implements a server that:
  * - Communicates via JSON-RPC 2.0 protocol over stdin/stdout
  * - Manages a collection of tools that can be called by MCP clients
+ * - Schedules tool calls according to their annotations: read-only tools
+ *   run concurrently on a worker pool, read-only idempotent tools are cached
+ *   and coalesced, other tools run one at a time in request order
+ * - Partitions the result cache across worker shards: each cache partition
+ *   is only touched by its own worker thread and needs no lock
+ * - Protects itself from failing tools with per-tool circuit breakers, and
+ *   reports their state changes through MCP logging notifications
+ * - Drains in-flight calls on end of input or SIGTERM before returning
+ * - Can replace its own binary on SIGUSR2 without closing the client pipes
  * - Handles model context interactions
  * - Logs all exchanges to a file for debugging
  */
@@ -29,61 +60,630 @@ private:
       fRegisteredTools;       ///< Registry of available tools
   std::string fServerName;    ///< Server name for MCP identification
   std::string fServerVersion; ///< Server version for MCP identification
+  std::string fSessionId = "stdio"; ///< Client session, as named at initialize
+
+  // Tool scheduling
+  McpWorkerPool fWorkers;     ///< Runs read-only tool calls concurrently
+  McpWorkerPool fOrdered{1};  ///< Runs the other tool calls one at a time, off the reader thread
+  std::mutex fOutputMutex;    ///< Serializes writes to stdout
+
+  /// Results of read-only idempotent calls owned by one worker shard
+  struct CacheShard {
+    std::unordered_map<std::string, json> results; ///< Cached results by call key
+    std::deque<std::string> order;                 ///< Keys in insertion order (for eviction)
+  };
+  std::vector<CacheShard> fCacheShards;   ///< One partition per worker shard
+  std::size_t fResultCacheCapacity = 256; ///< Maximum number of cached results
+  McpRateLimiter fRateLimiter; ///< Per-session, per-tool call limits
+  McpCircuitBreaker::Policy fCircuitPolicy; ///< Thresholds of new breakers
+  std::map<std::string, std::unique_ptr<McpCircuitBreaker>>
+      fCircuitBreakers;       ///< One breaker per registered tool
+  std::atomic<int> fLogLevel{1}; ///< Minimum level index sent to the client
+
+  // Shutdown
+  std::mutex fPendingMutex;   ///< Protects fPendingCalls
+  std::multimap<std::string, std::shared_ptr<std::atomic<bool>>>
+      fPendingCalls;          ///< Unanswered tool calls (by id text) and their cancel flags
+  std::atomic<bool> fShuttingDown{false}; ///< Asks running tools to stop
+  std::chrono::milliseconds fDrainGracePeriod{5000}; ///< Time given to in-flight calls at exit
+  static inline std::atomic<bool> sStopRequested{false}; ///< Set by SIGTERM/SIGINT/SIGUSR2
+  static inline std::atomic<bool> sUpgradeRequested{false}; ///< Set by SIGUSR2
+
+  // Binary upgrade
+  std::vector<std::string> fUpgradeCommand; ///< Command exec'ed on SIGUSR2 (empty: disabled)
+  static constexpr const char *kHandoffVariable = "MCP_HANDOFF_FD";
+
+  /// Time left to cancelled tools before the process exits without them
+  static constexpr std::chrono::milliseconds kCancelTimeout{200};
+
+  static constexpr const char *kLogLevels[] = {
+      "debug", "info", "notice", "warning", "error", "critical", "alert", "emergency"};
 
   // Message handling methods
-  void sendResponse(const json &id, const json &result) {
-    json response = {{"jsonrpc", "2.0"}, {"id", id}, {"result", result}};
+  void writeMessage(const json &message) {
+    // Serialized outside the lock, into a recycled buffer of this thread
+    McpRequestContext::Handle context = McpRequestContext::acquire();
+    const McpBuffer &text = context->serialize(message);
+    std::lock_guard<std::mutex> lock(fOutputMutex);
+    std::cout.write(text.data(), static_cast<std::streamsize>(text.size())) << std::endl;
+  }
+
+  // Responses are assembled around the text of the request id, which is
+  // copied verbatim; only the result or error goes through the serializer
+  void writeResponse(const McpRequestId &id, const McpKey &key, const json &value) {
+    McpRequestContext::Handle context = McpRequestContext::acquire();
+    McpBuffer &text = context->output;
+    text.append("{\"jsonrpc\":\"2.0\",\"id\":").append(id.text());
+    text.append(",\"").append(key.name).append("\":");
+    context->append(value);
+    text.push_back('}');
+    std::lock_guard<std::mutex> lock(fOutputMutex);
+    std::cout.write(text.data(), static_cast<std::streamsize>(text.size())) << std::endl;
+  }
+
+  void sendResponse(const McpRequestId &id, const json &result) {
+    writeResponse(id, mcpKey::kResult, result);
+  }
+
+  void sendError(const McpRequestId &id, int code, const std::string &message,
+                 const json &data = json()) {
+    json error(json::value_t::object);
+    error[mcpKey::kCode] = code;
+    error[mcpKey::kMessage] = message;
+    if (!data.is_null()) {
+      error[mcpKey::kData] = data;
+    }
+    writeResponse(id, mcpKey::kError, error);
+  }
+
+  void sendNotification(const std::string &method, json params) {
+    json message(json::value_t::object);
+    message[mcpKey::kJsonrpc] = "2.0";
+    message[mcpKey::kMethod] = method;
+    message[mcpKey::kParams] = std::move(params);
+    writeMessage(message);
+  }
 
-    std::string responseStr = response.dump();
-    std::cout << responseStr << std::endl;
+  // Send an MCP log message if its level passes the client's threshold
+  void log(int level, const std::string &logger, const json &data) {
+    if (level >= fLogLevel.load(std::memory_order_relaxed)) {
+      sendNotification("notifications/message",
+                       {{"level", kLogLevels[level]}, {"logger", logger}, {"data", data}});
+    }
+  }
+
+  // Pending call tracking: each tools/call id is answered exactly once
+  std::shared_ptr<std::atomic<bool>> beginCall(const McpRequestId &id) {
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::lock_guard<std::mutex> lock(fPendingMutex);
+    fPendingCalls.emplace(id.text(), cancelled);
+    return cancelled;
   }
 
-  void sendError(const json &id, int code, const std::string &message) {
-    json response = {{"jsonrpc", "2.0"},
-                     {"id", id},
-                     {"error", {{"code", code}, {"message", message}}}};
+  bool endCall(const McpRequestId &id) {
+    std::lock_guard<std::mutex> lock(fPendingMutex);
+    auto call = fPendingCalls.find(id.text());
+    if (call == fPendingCalls.end()) {
+      return false;
+    }
+    fPendingCalls.erase(call);
+    return true;
+  }
 
-    std::string responseStr = response.dump();
-    std::cout << responseStr << std::endl;
+  // Error data telling which memory budget a request ran into
+  static json memoryBudgetData(bool global) {
+    return {{"budget", global ? "global" : "request"},
+            {"budgetBytes", global ? McpMemoryGovernor::globalBudget() : McpMemoryGovernor::requestBudget()}};
+  }
+
+  // Run the part of a call done on a worker thread within the request's
+  // account. Running out of budget outside the tool itself (looking up the
+  // cache, reporting an open circuit) still answers the call, instead of
+  // letting the exception escape the worker.
+  template <class Body>
+  void runWithAccount(const McpRequestId &id, McpMemoryGovernor::Account *account, Body &&body) {
+    McpMemoryGovernor::Scope scope(account);
+    try {
+      body();
+    } catch (const McpMemoryGovernor::BudgetExceeded &) {
+      sendToolError(id, -32000, "Memory budget exceeded",
+                    memoryBudgetData(account != nullptr && account->globalBudgetExceeded()));
+    }
+  }
+
+  // A null result, or an account over budget, means the call ran out of
+  // memory; the response is serialized within the same account, so an
+  // oversized result is turned into an error as well
+  void sendToolResponse(const McpRequestId &id, const json &result,
+                        const McpMemoryGovernor::Account *account = nullptr) {
+    if (result.is_null() || (account != nullptr && account->exceeded())) {
+      sendToolError(id, -32000, "Memory budget exceeded",
+                    memoryBudgetData(account != nullptr && account->globalBudgetExceeded()));
+      return;
+    }
+    if (!endCall(id)) {
+      return;
+    }
+    try {
+      sendResponse(id, result);
+    } catch (const McpMemoryGovernor::BudgetExceeded &) {
+      sendError(id, -32000, "Memory budget exceeded",
+                memoryBudgetData(account != nullptr && account->globalBudgetExceeded()));
+    }
+  }
+
+  void sendToolError(const McpRequestId &id, int code, const std::string &message,
+                     const json &data = json()) {
+    if (endCall(id)) {
+      sendError(id, code, message, data);
+    }
+  }
+
+  void handleCancelled(std::string_view message) {
+    // The client no longer wants a response; ask the call to stop.
+    // Calls are keyed by the text of their id, so the requestId is read the same way.
+    McpRequestId requestId = McpRequestId::find(McpRequestId::rawMember(message, "params"), "requestId");
+    std::lock_guard<std::mutex> lock(fPendingMutex);
+    auto call = fPendingCalls.find(requestId.text());
+    if (call != fPendingCalls.end()) {
+      call->second->store(true);
+      fPendingCalls.erase(call);
+    }
+  }
+
+  // Tool execution methods
+  json executeTool(McpTool &tool, McpCircuitBreaker &breaker, const std::string &arguments,
+                   const std::atomic<bool> *cancelled = nullptr,
+                   const json &progressToken = json()) {
+    auto start = std::chrono::steady_clock::now();
+    json result;
+    bool clientError = false;
+    McpTool::currentCancellation() = {cancelled, &fShuttingDown};
+    try {
+      if (!progressToken.is_null()) {
+        McpTool::currentProgress().report = [this, progressToken](double progress,
+                                                                  const std::string &message) {
+          json params(json::value_t::object);
+          params[mcpKey::kProgressToken] = progressToken;
+          params["progress"] = progress;
+          if (!message.empty()) {
+            params[mcpKey::kMessage] = message;
+          }
+          sendNotification("notifications/progress", std::move(params));
+        };
+      }
+      // Tool returns MCP content array directly
+      result[mcpKey::kContent] = tool.call(arguments);
+    } catch (const McpMemoryGovernor::BudgetExceeded &) {
+      // Not a failure of the tool: answered with a JSON-RPC error
+      result = nullptr;
+    } catch (const std::exception &e) {
+      // Invalid or mistyped arguments, and calls the client cancelled, say
+      // nothing about the tool's health: a client sending bad requests must
+      // not open the breaker for everyone else
+      clientError = dynamic_cast<const std::invalid_argument *>(&e) != nullptr ||
+                    dynamic_cast<const json::exception *>(&e) != nullptr ||
+                    (cancelled != nullptr && cancelled->load());
+      // The error text is not charged, so reporting it cannot exceed the budget
+      McpMemoryGovernor::Scope uncharged(nullptr);
+      result[mcpKey::kContent] = json::array({McpTool::textItem("Error: " + std::string(e.what()))});
+      result[mcpKey::kIsError] = true;
+    }
+    McpTool::currentCancellation() = {};
+    McpTool::currentProgress() = {};
+    if (result.is_null() || clientError) {
+      breaker.release();
+    } else {
+      breaker.record(result.value(mcpKey::kIsError, false),
+                     std::chrono::steady_clock::now() - start);
+    }
+    return result;
+  }
+
+  void sendCircuitOpenError(const McpRequestId &id, const std::string &toolName,
+                            const McpCircuitBreaker &breaker) {
+    sendToolError(id, -32000, "Circuit open for tool: " + toolName,
+              {{"retryAfterMs", breaker.retryAfterMs()}});
+  }
+
+  void onCircuitStateChange(const std::string &toolName, McpCircuitBreaker::State from,
+                            McpCircuitBreaker::State to) {
+    // warning when opening, notice when probing, info when recovered
+    int level = to == McpCircuitBreaker::State::Open       ? 3
+                : to == McpCircuitBreaker::State::HalfOpen ? 2
+                                                           : 1;
+    log(level, "circuit-breaker",
+        {{"tool", toolName},
+         {"from", McpCircuitBreaker::stateName(from)},
+         {"to", McpCircuitBreaker::stateName(to)}});
+  }
+
+  void storeCachedResult(CacheShard &cache, const std::string &key, const json &result) {
+    std::size_t capacity = fResultCacheCapacity / fCacheShards.size();
+    if (capacity == 0 || fShuttingDown || result.is_null() || result.value(mcpKey::kIsError, false)) {
+      return;
+    }
+    while (cache.results.size() >= capacity) {
+      cache.results.erase(cache.order.front());
+      cache.order.pop_front();
+    }
+    if (cache.results.emplace(key, result).second) {
+      cache.order.push_back(key);
+    }
+  }
+
+  void scheduleCachedCall(const McpRequestId &id, McpTool &tool, McpCircuitBreaker &breaker,
+                          const std::string &toolName, std::string arguments,
+                          std::shared_ptr<std::atomic<bool>> cancelled, json progressToken,
+                          std::shared_ptr<McpMemoryGovernor::Account> account) {
+    // The dump keeps the client's member order: the same arguments sent in
+    // another order get their own cache entry
+    std::string key = toolName + '\n' + arguments;
+
+    // Every call with this key goes to the same shard, which owns its cache
+    // entry. Calls there run one after the other, so an identical call
+    // queued behind a running one is answered from the cache it fills.
+    // Each call executes under its own cancellation flag and progress token:
+    // cancelling one of them never stops the others.
+    std::size_t shard = std::hash<std::string>()(key) % fCacheShards.size();
+    auto task = [this, &tool, &breaker, shard, key = std::move(key), id, toolName,
+                 arguments = std::move(arguments), cancelled = std::move(cancelled),
+                 progressToken = std::move(progressToken), account = std::move(account)]() {
+      runWithAccount(id, account.get(), [&]() {
+        CacheShard &cache = fCacheShards[shard];
+        auto cached = cache.results.find(key);
+        if (cached != cache.results.end()) {
+          sendToolResponse(id, cached->second, account.get());
+        } else if (cancelled->load()) {
+          // Cancelled while queued: no response is expected
+        } else if (!breaker.allowRequest()) {
+          sendCircuitOpenError(id, toolName, breaker);
+        } else {
+          json result = executeTool(tool, breaker, arguments, cancelled.get(), progressToken);
+          if (account == nullptr || !account->exceeded()) {
+            // The entry outlives the request: not charged to it
+            McpMemoryGovernor::Scope uncharged(nullptr);
+            storeCachedResult(cache, key, result);
+          }
+          sendToolResponse(id, result, account.get());
+        }
+      });
+    };
+    dispatch([this, shard, task = std::move(task)]() { fWorkers.submitTo(shard, task); });
   }
 
   // Request processing methods
-  void handleToolsListRequest(const json &id) {
+  void handleToolsListRequest(const McpRequestId &id) {
     json tools = json::array();
 
     for (const auto &toolPair : fRegisteredTools) {
       const auto &tool = toolPair.second;
       // Parse the tool description (which should return valid JSON)
-      tools.push_back(json::parse(tool->describe()));
+      json description = json::parse(tool->describe());
+      if (!description.contains("annotations")) {
+        description["annotations"] = tool->annotations().toJson();
+      }
+      tools.push_back(description);
     }
 
     json result = {{"tools", tools}};
-    sendResponse(id, result);
+    sendResponse(id, std::move(result));
   }
 
-  void handleToolCall(const json &id, const std::string &toolName,
-                      const json &arguments) {
-    if (fRegisteredTools.find(toolName) == fRegisteredTools.end()) {
+  // The arguments are borrowed from the parsed request: they are serialized
+  // once, for the tool, and that text is moved to the thread running it,
+  // with the memory account of the request
+  void handleToolCall(const McpRequestId &id, const std::string &toolName,
+                      const json &arguments, const json &progressToken,
+                      std::shared_ptr<McpMemoryGovernor::Account> account) {
+    auto entry = fRegisteredTools.find(toolName);
+    if (entry == fRegisteredTools.end()) {
       sendError(id, -32602, "Method not found: " + toolName);
       return;
     }
 
-    // Call the tool with JSON arguments
-    json toolResponse = fRegisteredTools[toolName]->call(arguments.dump());
+    if (uint64_t retryAfterMs = fRateLimiter.tryAcquire(fSessionId, toolName)) {
+      sendError(id, -32000, "Rate limit exceeded for tool: " + toolName,
+                {{"retryAfterMs", retryAfterMs}});
+      return;
+    }
+    std::shared_ptr<std::atomic<bool>> cancelled = beginCall(id);
+
+    McpTool &tool = *entry->second;
+    McpCircuitBreaker &breaker = *fCircuitBreakers.at(toolName);
+    McpToolAnnotations hints = tool.annotations();
+    std::string argumentsText = arguments.dump();
+
+    if (hints.readOnlyHint && hints.idempotentHint) {
+      // Cached and coalesced calls consult the breaker only when they execute
+      scheduleCachedCall(id, tool, breaker, toolName, std::move(argumentsText), std::move(cancelled),
+                         progressToken, std::move(account));
+      return;
+    }
+    if (!breaker.allowRequest()) {
+      sendCircuitOpenError(id, toolName, breaker);
+      return;
+    }
+
+    auto task = [this, &tool, &breaker, id, arguments = std::move(argumentsText), cancelled, progressToken,
+                 account = std::move(account)]() {
+      runWithAccount(id, account.get(), [&]() {
+        sendToolResponse(id, executeTool(tool, breaker, arguments, cancelled.get(), progressToken),
+                         account.get());
+      });
+    };
+    if (!hints.readOnlyHint) {
+      // Tools that may modify state run in request order, once every
+      // concurrent call issued before them has completed. They run on the
+      // ordered lane, so the reader keeps handling cancellations and other
+      // requests meanwhile.
+      fOrdered.submit([this, task = std::move(task)]() {
+        fWorkers.waitIdle();
+        task();
+      });
+    } else {
+      dispatch([this, task = std::move(task)]() { fWorkers.submit(task); });
+    }
+  }
 
-    // Tool returns MCP content array directly
-    json result = {{"content", toolResponse}};
+  // Hand a call to the worker pool. While a call of the ordered lane is
+  // queued or running, later calls queue behind it on the lane, so they
+  // still see its effects.
+  void dispatch(std::function<void()> submission) {
+    if (fOrdered.idle()) {
+      submission();
+    } else {
+      fOrdered.submit(std::move(submission));
+    }
+  }
 
-    sendResponse(id, result);
+  // Wait for both pools within one timeout; the ordered lane goes first,
+  // since it feeds the worker pool
+  bool waitIdleFor(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto remaining = [deadline]() {
+      return std::max(std::chrono::milliseconds(0), std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                        deadline - std::chrono::steady_clock::now()));
+    };
+    return fOrdered.waitIdleFor(remaining()) && fWorkers.waitIdleFor(remaining());
   }
 
-  void handleInitialize(const json &id) {
+  void handleInitialize(const McpRequestId &id, const json &params) {
+    // A malformed clientInfo keeps the default session id
+    json clientInfo = params.is_object() ? params.value("clientInfo", json::object()) : json::object();
+    if (clientInfo.is_object() && clientInfo.contains("name") && clientInfo["name"].is_string()) {
+      fSessionId = clientInfo["name"].get<std::string>();
+    }
+
     json result = {
         {"protocolVersion", "2024-11-05"},
-        {"capabilities", {{"tools", json::object()}}},
+        {"capabilities", {{"tools", json::object()}, {"logging", json::object()}}},
         {"serverInfo", {{"name", fServerName}, {"version", fServerVersion}}}};
 
-    sendResponse(id, result);
+    sendResponse(id, std::move(result));
+  }
+
+  void handleSetLogLevel(const McpRequestId &id, const json &params) {
+    std::string level = params.value("level", "");
+    for (int i = 0; i < static_cast<int>(std::size(kLogLevels)); ++i) {
+      if (level == kLogLevels[i]) {
+        fLogLevel = i;
+        sendResponse(id, json::object());
+        return;
+      }
+    }
+    sendError(id, -32602, "Invalid log level: " + level);
+  }
+
+  // Member of a parsed message, borrowed rather than copied; an empty
+  // object if it is missing or the message is not an object
+  static const json &member(const json &object, const McpKey &key) {
+    static const json empty = json::object();
+    if (!object.is_object()) {
+      return empty;
+    }
+    auto found = object.find(key);
+    return found != object.end() ? *found : empty;
+  }
+
+  void handleMessage(McpRequestContext &context) {
+    if (context.line.empty()) {
+      return;
+    }
+
+    // With memory budgets, a request that cannot fit is shed before it is
+    // parsed, and everything it allocates from here on (the parsed value,
+    // the tool call, the response) is charged to its own account
+    std::shared_ptr<McpMemoryGovernor::Account> account;
+    if (McpMemoryGovernor::enabled()) {
+      if (!McpMemoryGovernor::admit(context.line.size())) {
+        // Notifications are dropped without a response
+        McpRequestId id = McpRequestId::find(context.line);
+        bool global = McpMemoryGovernor::requestBudget() == 0 ||
+                      context.line.size() <= McpMemoryGovernor::requestBudget();
+        if (!id.isNull()) {
+          sendError(id, -32000, "Server memory budget exhausted", memoryBudgetData(global));
+        }
+        return;
+      }
+      account = std::make_shared<McpMemoryGovernor::Account>();
+    }
+    McpMemoryGovernor::Scope scope(account.get());
+
+    try {
+      context.request = json::parse(context.line);
+      const json &request = context.request;
+
+      // Extract fields from JSON
+      // The id is echoed from the message text; the parsed value is only
+      // needed if its key was written with escapes
+      McpRequestId id = McpRequestId::find(context.line);
+      if (id.isNull() && request.contains(mcpKey::kId)) {
+        id = McpRequestId(request[mcpKey::kId]);
+      }
+      std::string method = request.value(mcpKey::kMethod, "");
+      const json &params = member(request, mcpKey::kParams);
+
+      if (method == "initialize") {
+        handleInitialize(id, params);
+      } else if (method == "notifications/cancelled") {
+        handleCancelled(context.line);
+      } else if (method == "notifications/initialized") {
+        // nothing to do
+      } else if (method == "logging/setLevel") {
+        handleSetLogLevel(id, params);
+      } else if (method == "server/metrics") {
+        sendResponse(id, metrics());
+      } else if (method == "tools/list") {
+        handleToolsListRequest(id);
+      } else if (method == "tools/call") {
+        // Extract tool name and arguments
+        std::string toolName = params.value(mcpKey::kName, "");
+        json progressToken = member(params, mcpKey::kMeta).value(mcpKey::kProgressToken, json());
+
+        handleToolCall(id, toolName, member(params, mcpKey::kArguments), progressToken, account);
+      } else {
+        sendError(id, -32601, "Method not found: " + method);
+      }
+    } catch (const json::parse_error &e) {
+      sendError(McpRequestId(), -32700, "Parse error: " + std::string(e.what()));
+    } catch (const McpMemoryGovernor::BudgetExceeded &) {
+      // The request may have been registered as a pending call already
+      McpRequestId id = McpRequestId::find(context.line);
+      endCall(id);
+      sendError(id, -32000, "Memory budget exceeded", memoryBudgetData(account->globalBudgetExceeded()));
+    }
+  }
+
+  // Shutdown methods
+  static void onStopSignal(int) { sStopRequested = true; }
+
+  static void onUpgradeSignal(int) {
+    sUpgradeRequested = true;
+    sStopRequested = true;
+  }
+
+  /**
+   * Replace this process by a new server binary. stdin and stdout are
+   * inherited through exec, so the client never sees the pipe close. The
+   * session state and the input read but not yet processed are passed in a
+   * memory file named by MCP_HANDOFF_FD: one JSON line with the state, then
+   * the raw pending bytes. Returns only if the exec failed.
+   */
+  void execUpgrade(const std::string &pendingInput) {
+    json state = {{"sessionId", fSessionId}, {"logLevel", fLogLevel.load()}};
+    std::string stateStr = state.dump() + '\n' + pendingInput;
+
+    int fd = memfd_create("mcp-handoff", 0);
+    if (fd < 0 || ::write(fd, stateStr.data(), stateStr.size()) !=
+                      static_cast<ssize_t>(stateStr.size())) {
+      log(4, "upgrade", {{"error", "cannot create handoff state"}});
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return;
+    }
+    lseek(fd, 0, SEEK_SET);
+    setenv(kHandoffVariable, std::to_string(fd).c_str(), 1);
+
+    std::vector<char *> argv;
+    for (std::string &arg : fUpgradeCommand) {
+      argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    std::cout.flush();
+    execv(argv[0], argv.data());
+
+    // Still here: keep serving with the current binary
+    unsetenv(kHandoffVariable);
+    ::close(fd);
+    log(4, "upgrade", {{"error", "exec failed: " + std::string(strerror(errno))},
+                       {"command", fUpgradeCommand}});
+  }
+
+  // Absolute path of a program named as on a command line; the running
+  // binary's path if it cannot be found
+  static std::string resolveExecutable(const std::string &program) {
+    auto absolute = [](const std::string &path) {
+      char cwd[PATH_MAX];
+      return path[0] == '/' || getcwd(cwd, sizeof(cwd)) == nullptr ? path : std::string(cwd) + '/' + path;
+    };
+    if (program.find('/') != std::string::npos) {
+      return absolute(program);
+    }
+    const char *path = std::getenv("PATH");
+    std::string_view dirs = path != nullptr ? path : "/usr/local/bin:/usr/bin:/bin";
+    for (std::size_t start = 0; !program.empty() && start <= dirs.size();) {
+      std::size_t colon = std::min(dirs.find(':', start), dirs.size());
+      std::string dir(dirs.substr(start, colon - start));
+      std::string candidate = (dir.empty() ? "." : dir) + '/' + program;
+      if (access(candidate.c_str(), X_OK) == 0) {
+        return absolute(candidate);
+      }
+      start = colon + 1;
+    }
+    char self[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    return length > 0 ? std::string(self, length) : program;
+  }
+
+  /**
+   * Restore the state passed by a previous server binary, if any
+   * @param reader Receives the input left unprocessed by that binary
+   */
+  void restoreHandoff(McpLineReader &reader) {
+    const char *fdStr = std::getenv(kHandoffVariable);
+    if (fdStr == nullptr) {
+      return;
+    }
+    int fd = std::atoi(fdStr);
+    unsetenv(kHandoffVariable);
+
+    std::string stateStr;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+      stateStr.append(buffer, count);
+    }
+    ::close(fd);
+
+    std::size_t end = stateStr.find('\n');
+    json state = json::parse(stateStr.substr(0, end), nullptr, false);
+    if (end == std::string::npos || state.is_discarded()) {
+      return;
+    }
+    fSessionId = state.value("sessionId", fSessionId);
+    fLogLevel = state.value("logLevel", fLogLevel.load());
+    reader.unread(stateStr.substr(end + 1));
+    log(1, "upgrade", {{"message", "server binary replaced"}, {"version", fServerVersion}});
+  }
+
+  void drain() {
+    // Let queued and running calls finish within the grace period
+    if (!waitIdleFor(fDrainGracePeriod)) {
+      // Out of time: drop queued calls, ask running ones to stop, and
+      // answer every call still pending
+      fShuttingDown = true;
+      fOrdered.cancelQueued();
+      fWorkers.cancelQueued();
+      std::multimap<std::string, std::shared_ptr<std::atomic<bool>>> pending;
+      {
+        std::lock_guard<std::mutex> lock(fPendingMutex);
+        pending.swap(fPendingCalls);
+      }
+      for (const auto &call : pending) {
+        sendError(McpRequestId(call.first), -32000,
+                  "Request cancelled: server shutting down");
+      }
+    }
+
+    std::cout.flush();
+
+    if (!waitIdleFor(kCancelTimeout)) {
+      // Tools ignoring cancellation cannot be interrupted safely; every
+      // response has been written, so leave without joining them
+      std::_Exit(EXIT_SUCCESS);
+    }
   }
 
 public:
@@ -107,6 +707,88 @@ public:
     fServerVersion = version;
   }
 
+  /**
+   * @brief Set the number of threads (shards) running read-only tool calls
+   *
+   * Must be called before run().
+   *
+   * @param threads Thread count (0 selects the hardware concurrency)
+   * @param pinToCores Pin each worker thread to its own core
+   */
+  void setWorkerThreads(std::size_t threads, bool pinToCores = false) {
+    fWorkers.setThreadCount(threads, pinToCores);
+  }
+
+  /**
+   * @brief Set the number of cached results of read-only idempotent tools
+   *
+   * Must be called before run(); the capacity is split across worker shards.
+   *
+   * @param entries Maximum number of cached results (0 disables caching)
+   */
+  void setResultCacheSize(std::size_t entries) { fResultCacheCapacity = entries; }
+
+  /**
+   * @brief Limit the call rate of every tool, per session
+   * @param callsPerSecond Sustained call rate (0 disables limiting)
+   * @param burst Number of calls allowed back to back
+   */
+  void setRateLimit(double callsPerSecond, double burst) {
+    fRateLimiter.setDefaultLimit(callsPerSecond, burst);
+  }
+
+  /**
+   * @brief Limit the call rate of one tool, per session
+   * @param toolName Tool to limit (overrides the global limit)
+   * @param callsPerSecond Sustained call rate (0 disables limiting)
+   * @param burst Number of calls allowed back to back
+   */
+  void setToolRateLimit(const std::string &toolName, double callsPerSecond,
+                        double burst) {
+    fRateLimiter.setToolLimit(toolName, callsPerSecond, burst);
+  }
+
+  /**
+   * @brief Set the time given to in-flight calls when the server stops
+   * @param grace Calls still running after this delay are cancelled
+   */
+  void setDrainGracePeriod(std::chrono::milliseconds grace) {
+    fDrainGracePeriod = grace;
+  }
+
+  /**
+   * @brief Enable in-place binary upgrades triggered by SIGUSR2
+   *
+   * On SIGUSR2 the server stops reading, waits for every in-flight call,
+   * then execs the command; the new binary registers its tools and resumes
+   * the session on the same stdin/stdout.
+   *
+   * The executable is resolved to an absolute path now, searching PATH
+   * for a bare name as the shell did, since execv() searches nothing and
+   * the working directory may change. The path is kept rather than the
+   * running file, so a binary replaced under the same name is the one
+   * exec'ed.
+   *
+   * @param command Executable path followed by its arguments (typically argv)
+   */
+  void setUpgradeCommand(const std::vector<std::string> &command) {
+    fUpgradeCommand = command;
+    if (!fUpgradeCommand.empty()) {
+      fUpgradeCommand[0] = resolveExecutable(fUpgradeCommand[0]);
+    }
+  }
+
+  /**
+   * @brief Set the circuit breaker thresholds of every tool
+   * @param policy Error rate, latency and timing thresholds
+   */
+  void setCircuitBreakerPolicy(const McpCircuitBreaker::Policy &policy) {
+    fCircuitPolicy = policy;
+    for (auto &breaker : fCircuitBreakers) {
+      breaker.second->setPolicy(policy);
+    }
+  }
+
   /**
    * @brief Registers a new tool with the MCP server
    * @param tool Unique pointer to the tool to register
@@ -114,54 +796,118 @@ public:
   void registerTool(std::unique_ptr<McpTool> tool) {
     std::string name = tool->name();
     fRegisteredTools[name] = std::move(tool);
+    fCircuitBreakers[name] = std::make_unique<McpCircuitBreaker>(
+        fCircuitPolicy, [this, name](McpCircuitBreaker::State from,
+                                     McpCircuitBreaker::State to) {
+          onCircuitStateChange(name, from, to);
+        });
+  }
+
+  /**
+   * @brief Snapshot of the server metrics (also served by "server/metrics")
+   * @return JSON object with per-tool circuit breaker state and counters
+   */
+  json metrics() const {
+    json tools = json::object();
+    for (const auto &breakerPair : fCircuitBreakers) {
+      const McpCircuitBreaker &breaker = *breakerPair.second;
+      tools[breakerPair.first] = {
+          {"circuitState", McpCircuitBreaker::stateName(breaker.state())},
+          {"circuitOpenCount", breaker.openCount()},
+          {"circuitRejectedCalls", breaker.rejectedCount()}};
+    }
+    McpRequestContext::Stats contexts = McpRequestContext::stats();
+    McpHugePages::Stats hugePages = McpHugePages::stats();
+    json result = {{"tools", tools},
+                   {"requestContexts",
+                    {{"created", contexts.created}, {"reused", contexts.reused}, {"trimmed", contexts.trimmed}}},
+                   {"hugePages",
+                    {{"mode", McpHugePages::modeName(McpHugePages::mode())},
+                     {"explicitMaps", hugePages.explicitMaps},
+                     {"transparentMaps", hugePages.transparentMaps},
+                     {"fallbacks", hugePages.fallbacks},
+                     {"mappedBytes", hugePages.mappedBytes}}}};
+    if (McpMemoryGovernor::enabled()) {
+      McpMemoryGovernor::Stats memory = McpMemoryGovernor::stats();
+      result["memoryBudget"] = {{"globalBudgetBytes", memory.globalBudget},
+                                {"requestBudgetBytes", memory.requestBudget},
+                                {"liveBytes", memory.liveBytes},
+                                {"peakBytes", memory.peakBytes},
+                                {"exceededRequests", memory.exceeded},
+                                {"shedRequests", memory.shed}};
+    }
+#if defined(MCP_ALLOCATOR)
+    McpAllocator::Stats allocator = McpAllocator::stats();
+    result["allocator"] = {{"spansInUse", allocator.spansInUse},
+                           {"spansReleased", allocator.spansReleased},
+                           {"centralFreeBytes", allocator.centralFreeBytes},
+                           {"scavenges", allocator.scavenges}};
+#endif
+    return result;
   }
 
   /**
    * @brief Starts the MCP server and processes incoming requests
    *
-   * This method runs an infinite loop reading JSON-RPC requests from stdin
-   * and sending responses to stdout. The server handles:
+   * This method runs a loop reading JSON-RPC requests from stdin and
+   * sending responses to stdout. The server handles:
    * - initialize: Server capability negotiation
    * - tools/list: Returns available tools
    * - tools/call: Executes a specific tool with arguments
+   *
+   * The loop ends at end of input or on SIGTERM/SIGINT. In-flight calls then
+   * get the drain grace period to complete before being cancelled. On
+   * SIGUSR2 (see setUpgradeCommand) the server execs its new binary instead.
    */
   void run() {
+    // Stop signals stay blocked except while waiting for input, so they
+    // interrupt the wait but never a request being processed. Worker
+    // threads, started later, inherit the blocked mask.
+    sigset_t stopSignals;
+    sigset_t waitMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGTERM);
+    sigaddset(&stopSignals, SIGINT);
+    if (!fUpgradeCommand.empty()) {
+      sigaddset(&stopSignals, SIGUSR2);
+    }
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &waitMask);
+    sigdelset(&waitMask, SIGTERM);
+    sigdelset(&waitMask, SIGINT);
+    sigdelset(&waitMask, SIGUSR2);
 
-    std::string line;
+    struct sigaction action = {};
+    action.sa_handler = onStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+    if (!fUpgradeCommand.empty()) {
+      action.sa_handler = onUpgradeSignal;
+      sigaction(SIGUSR2, &action, nullptr);
+    }
 
-    while (std::getline(std::cin, line)) {
-      if (line.empty()) {
-        continue;
-      }
+    fCacheShards.assign(fWorkers.shardCount(), CacheShard());
 
-      try {
-        json request = json::parse(line);
-
-        // Extract fields from JSON
-        json id = request.value("id", json());
-        std::string method = request.value("method", "");
-
-        if (method == "initialize") {
-          handleInitialize(id);
-        } else if (method == "notifications/cancelled") {
-          // nothing to do
-        } else if (method == "notifications/initialized") {
-          // nothing to do
-        } else if (method == "tools/list") {
-          handleToolsListRequest(id);
-        } else if (method == "tools/call") {
-          // Extract tool name and arguments
-          json params = request.value("params", json::object());
-          std::string toolName = params.value("name", "");
-          json arguments = params.value("arguments", json::object());
-
-          handleToolCall(id, toolName, arguments);
-        } else {
-          sendError(id, -32601, "Method not found: " + method);
-        }
-      } catch (const json::parse_error &e) {
-        sendError(json(), -32700, "Parse error: " + std::string(e.what()));
+    McpLineReader reader(STDIN_FILENO, &sStopRequested, &waitMask);
+    restoreHandoff(reader);
+
+    while (true) {
+      // Each message gets a recycled context, trimmed when it is released
+      for (McpRequestContext::Handle context = McpRequestContext::acquire(); reader.readLine(context->line);
+           context = McpRequestContext::acquire()) {
+        handleMessage(*context);
       }
+      if (!sUpgradeRequested) {
+        break;
+      }
+      // Upgrade: finish in-flight calls, then hand over to the new binary
+      fOrdered.waitIdle();
+      fWorkers.waitIdle();
+      execUpgrade(reader.pending());
+      sUpgradeRequested = false;
+      sStopRequested = false;
     }
+
+    drain();
   }
 };
\ No newline at end of file
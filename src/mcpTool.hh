@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -8,14 +10,63 @@
 #include <string>
 #include <unordered_map>
 
-#include "json.hpp"
-
-using json = nlohmann::json;
+#include "mcpJson.hh"
 
 // ============================================================================
 // MCP Tool Interface
 // ============================================================================
 
+/**
+ * @brief Behavioral hints attached to a tool (MCP tool annotations)
+ *
+ * The defaults are the pessimistic values from the MCP specification. The
+ * server also uses them for scheduling: read-only tools run concurrently,
+ * read-only and idempotent tools have their results cached and identical
+ * calls coalesced, and all other tools run one at a time in request order.
+ */
+struct McpToolAnnotations {
+  bool readOnlyHint = false;   ///< Tool does not modify its environment
+  bool destructiveHint = true; ///< Tool may perform destructive updates
+  bool idempotentHint = false; ///< Repeated calls with same args have no more effect
+  bool openWorldHint = true;   ///< Tool interacts with external entities
+
+  /**
+   * @brief Convert to the "annotations" object published in tools/list
+   */
+  json toJson() const {
+    return {{"readOnlyHint", readOnlyHint},
+            {"destructiveHint", destructiveHint},
+            {"idempotentHint", idempotentHint},
+            {"openWorldHint", openWorldHint}};
+  }
+};
+
+/**
+ * @brief Cancellation flags visible to the tool call running on a thread
+ */
+struct McpCancellation {
+  const std::atomic<bool> *request = nullptr; ///< Set when the client cancels this call
+  const std::atomic<bool> *server = nullptr;  ///< Set when the server shuts down
+
+  bool requested() const {
+    return (request != nullptr && request->load(std::memory_order_relaxed)) ||
+           (server != nullptr && server->load(std::memory_order_relaxed));
+  }
+};
+
+/**
+ * @brief Progress reporting of the tool call running on a thread
+ *
+ * Only set when the client asked for progress notifications by passing a
+ * progressToken in the request's _meta. Each report becomes one
+ * notifications/progress message; progress values must increase.
+ */
+struct McpProgress {
+  std::function<void(double progress, const std::string &message)> report;
+
+  bool enabled() const { return static_cast<bool>(report); }
+};
+
 /**
  * @brief Abstract base class for MCP tools
  *
@@ -39,10 +90,58 @@ public:
    */
   virtual std::string describe() const = 0;
 
+  /**
+   * @brief Get the behavioral hints of this tool
+   * @return Annotations published in tools/list and used for scheduling
+   */
+  virtual McpToolAnnotations annotations() const { return {}; }
+
   /**
    * @brief Execute the tool with given arguments
    * @param arguments JSON string containing the tool's input parameters
    * @return JSON array containing MCP-structured content items
+   * @throws std::invalid_argument for errors caused by the request (bad
+   * arguments, missing files) or that say nothing of the tool's health (a
+   * resource not ready yet): they are reported like any other exception
+   * but not counted as failures by the tool's circuit breaker
    */
   virtual json call(const std::string &arguments) = 0;
+
+  /**
+   * @brief Cancellation state of the call running on the current thread
+   *
+   * Set by the server around call(). Long-running tools should poll
+   * isCancelled() and return early; their result is then discarded.
+   */
+  static McpCancellation &currentCancellation() {
+    static thread_local McpCancellation cancellation;
+    return cancellation;
+  }
+
+  /**
+   * @brief Check whether the call running on the current thread was cancelled
+   */
+  static bool isCancelled() { return currentCancellation().requested(); }
+
+  /**
+   * @brief Progress reporter of the call running on the current thread
+   *
+   * Set by the server around call(), like currentCancellation().
+   */
+  static McpProgress &currentProgress() {
+    static thread_local McpProgress progress;
+    return progress;
+  }
+
+  /**
+   * @brief Build a text content item
+   * @param text Text of the item
+   * @return {"type": "text", "text": text}, built without intermediate arrays
+   */
+  static json textItem(std::string text) {
+    json item(json::value_t::object);
+    item[mcpKey::kType] = "text";
+    item[mcpKey::kText] = std::move(text);
+    return item;
+  }
 };
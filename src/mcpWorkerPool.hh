@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+// ============================================================================
+// Worker Pool
+// ============================================================================
+
+/**
+ * @brief Sharded thread pool used by the server to run tool calls
+ *
+ * Each worker thread owns a shard: a private task queue, optionally pinned
+ * to one core. Tasks submitted to a given shard always run on its thread,
+ * one at a time, so data partitioned by shard needs no locking; the queue
+ * is the only point where threads meet.
+ *
+ * Tasks submitted without a shard go to an idle worker when there is one,
+ * and may be stolen: a worker with an empty queue takes them from the
+ * queues of busy siblings, so they never wait behind a long task while
+ * another thread is free.
+ *
+ * Threads are started on the first submitted task, so a server that never
+ * runs concurrent work never creates them.
+ */
+class McpWorkerPool {
+private:
+  struct Task {
+    std::function<void()> run;
+    bool stealable; ///< Submitted without a shard: any worker may run it
+  };
+
+  struct Shard {
+    std::mutex mutex;                         ///< Protects queue
+    std::condition_variable workAvailable;    ///< Signals queued tasks
+    std::deque<Task> queue;                   ///< Pending tasks
+    std::atomic<bool> busy{false};            ///< The thread is running a task
+  };
+
+  std::vector<std::unique_ptr<Shard>> fShards;   ///< One shard per thread
+  std::vector<std::thread> fThreads;             ///< Worker threads
+  std::once_flag fStarted;                       ///< Guards thread creation
+  std::mutex fIdleMutex;                         ///< Used with fIdle
+  std::condition_variable fIdle;                 ///< Signals an empty pool
+  std::atomic<std::size_t> fOutstanding{0};      ///< Queued plus running tasks
+  std::atomic<std::size_t> fNextShard{0};        ///< Round-robin cursor
+  std::atomic<std::size_t> fStealable{0};        ///< Stealable tasks queued in any shard
+  std::size_t fThreadCount = 0;                  ///< Threads to start
+  bool fPinThreads = false;                      ///< Pin thread i to core i
+  std::atomic<bool> fStopping{false};            ///< Set by the destructor
+
+  void start() {
+    for (std::size_t i = 0; i < fThreadCount; ++i) {
+      fThreads.emplace_back([this, i] { workerLoop(i); });
+      if (fPinThreads) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(i % CPU_SETSIZE, &cpus);
+        pthread_setaffinity_np(fThreads.back().native_handle(), sizeof(cpus), &cpus);
+      }
+    }
+  }
+
+  void taskDone(std::size_t count) {
+    if (fOutstanding.fetch_sub(count) == count) {
+      std::lock_guard<std::mutex> lock(fIdleMutex);
+      fIdle.notify_all();
+    }
+  }
+
+  // Take the oldest stealable task of another shard (empty if there is none)
+  std::function<void()> steal(std::size_t thief) {
+    for (std::size_t i = 1; i < fThreadCount; ++i) {
+      Shard &victim = *fShards[(thief + i) % fThreadCount];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      auto found = std::find_if(victim.queue.begin(), victim.queue.end(),
+                                [](const Task &task) { return task.stealable; });
+      if (found != victim.queue.end()) {
+        std::function<void()> run = std::move(found->run);
+        victim.queue.erase(found);
+        --fStealable;
+        return run;
+      }
+    }
+    return {};
+  }
+
+  // Wake a worker waiting for work, so it steals a task queued behind a busy one
+  void wakeIdleWorker(std::size_t except) {
+    for (std::size_t i = 0; i < fThreadCount; ++i) {
+      Shard &shard = *fShards[i];
+      if (i != except && !shard.busy) {
+        { std::lock_guard<std::mutex> lock(shard.mutex); }
+        shard.workAvailable.notify_one();
+        return;
+      }
+    }
+  }
+
+  void workerLoop(std::size_t index) {
+    Shard &shard = *fShards[index];
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.workAvailable.wait(lock, [&] { return fStopping || !shard.queue.empty() || fStealable > 0; });
+        if (!shard.queue.empty()) {
+          if (shard.queue.front().stealable) {
+            --fStealable;
+          }
+          task = std::move(shard.queue.front().run);
+          shard.queue.pop_front();
+        } else if (fStopping) {
+          return;
+        }
+        // Set before the queue is unlocked, so submit() sees it
+        shard.busy = true;
+      }
+      if (!task) {
+        task = steal(index);
+        if (!task) {
+          // Taken by another worker meanwhile
+          shard.busy = false;
+          std::this_thread::yield();
+          continue;
+        }
+      }
+      task();
+      shard.busy = false;
+      taskDone(1);
+    }
+  }
+
+  void push(std::size_t index, std::function<void()> task, bool stealable) {
+    std::call_once(fStarted, [this] { start(); });
+    ++fOutstanding;
+    Shard &target = *fShards[index];
+    {
+      std::lock_guard<std::mutex> lock(target.mutex);
+      target.queue.push_back({std::move(task), stealable});
+      if (stealable) {
+        ++fStealable;
+      }
+    }
+    target.workAvailable.notify_one();
+    if (stealable && target.busy) {
+      wakeIdleWorker(index);
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor
+   * @param threads Number of worker threads (0 selects the hardware concurrency)
+   */
+  explicit McpWorkerPool(std::size_t threads = 0) { setThreadCount(threads); }
+
+  ~McpWorkerPool() {
+    for (auto &shard : fShards) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      fStopping = true;
+      shard->workAvailable.notify_all();
+    }
+    for (auto &thread : fThreads) {
+      thread.join();
+    }
+  }
+
+  McpWorkerPool(const McpWorkerPool &) = delete;
+  McpWorkerPool &operator=(const McpWorkerPool &) = delete;
+
+  /**
+   * @brief Set the number of worker threads (before the first task)
+   * @param threads Number of threads (0 selects the hardware concurrency)
+   * @param pinToCores Pin each thread to its own core
+   */
+  void setThreadCount(std::size_t threads, bool pinToCores = false) {
+    if (threads == 0) {
+      threads = std::max(2u, std::thread::hardware_concurrency());
+    }
+    fThreadCount = threads;
+    fPinThreads = pinToCores;
+    fShards.clear();
+    for (std::size_t i = 0; i < threads; ++i) {
+      fShards.push_back(std::make_unique<Shard>());
+    }
+  }
+
+  /**
+   * @brief Number of shards (one per worker thread)
+   */
+  std::size_t shardCount() const { return fThreadCount; }
+
+  /**
+   * @brief Queue a task on the shard of the given index
+   * @param shard Shard index (taken modulo shardCount())
+   * @param task Task to run; it must not throw
+   */
+  void submitTo(std::size_t shard, std::function<void()> task) {
+    push(shard % fThreadCount, std::move(task), false);
+  }
+
+  /**
+   * @brief Queue a task on an idle worker, or the next shard round-robin;
+   * any worker that runs out of work may steal it
+   * @param task Task to run; it must not throw
+   */
+  void submit(std::function<void()> task) {
+    std::size_t first = fNextShard.fetch_add(1, std::memory_order_relaxed);
+    std::size_t index = first % fThreadCount;
+    for (std::size_t i = 0; i < fThreadCount; ++i) {
+      std::size_t candidate = (first + i) % fThreadCount;
+      if (!fShards[candidate]->busy) {
+        index = candidate;
+        break;
+      }
+    }
+    push(index, std::move(task), true);
+  }
+
+  /**
+   * @brief Tell whether every submitted task has completed
+   */
+  bool idle() const { return fOutstanding == 0; }
+
+  /**
+   * @brief Block until every submitted task has completed
+   */
+  void waitIdle() {
+    std::unique_lock<std::mutex> lock(fIdleMutex);
+    fIdle.wait(lock, [this] { return fOutstanding == 0; });
+  }
+
+  /**
+   * @brief Block until every submitted task has completed, or a timeout
+   * @param timeout Maximum time to wait
+   * @return true if the pool is idle
+   */
+  bool waitIdleFor(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(fIdleMutex);
+    return fIdle.wait_for(lock, timeout, [this] { return fOutstanding == 0; });
+  }
+
+  /**
+   * @brief Drop the tasks that have not started yet
+   * @return Number of dropped tasks
+   */
+  std::size_t cancelQueued() {
+    std::size_t count = 0;
+    for (auto &shard : fShards) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      for (const Task &task : shard->queue) {
+        fStealable -= task.stealable ? 1 : 0;
+      }
+      count += shard->queue.size();
+      shard->queue.clear();
+    }
+    if (count > 0) {
+      taskDone(count);
+    }
+    return count;
+  }
+};
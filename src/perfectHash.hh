@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+// ============================================================================
+// Compile-time Perfect Hash Table
+// ============================================================================
+
+/**
+ * @brief FNV-1a hash of a string, perturbed by a seed
+ * @param key String to hash
+ * @param seed Seed selected by the table builder to avoid collisions
+ * @return 32-bit hash value
+ */
+constexpr uint32_t perfectHashFnv1a(std::string_view key, uint32_t seed) {
+  uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+  for (char c : key) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 16777619u;
+  }
+  // Final avalanche so that the seed reaches the low bits used as slot index
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  return h;
+}
+
+/**
+ * @brief Immutable string-keyed table with a collision-free hash
+ *
+ * The seed and slot layout are computed by the compiler, so the table lives
+ * in read-only data and a lookup costs one hash and one string compare.
+ * Keys must be distinct; a duplicate key makes the build fail.
+ *
+ * @tparam Value Mapped type (must be a literal type)
+ * @tparam N Number of entries
+ */
+template <typename Value, std::size_t N> class PerfectHashTable {
+public:
+  using Entry = std::pair<std::string_view, Value>;
+
+  /**
+   * @brief Build the table at compile time
+   * @param entries Key/value pairs to store
+   */
+  constexpr explicit PerfectHashTable(const std::array<Entry, N> &entries)
+      : fSeed(findSeed(entries)), fKeys(), fValues(), fUsed() {
+    for (const Entry &entry : entries) {
+      std::size_t slot = perfectHashFnv1a(entry.first, fSeed) & kMask;
+      fKeys[slot] = entry.first;
+      fValues[slot] = entry.second;
+      fUsed[slot] = true;
+    }
+  }
+
+  /**
+   * @brief Find the value associated with a key
+   * @param key Key to look up
+   * @return Pointer to the value, or nullptr when the key is unknown
+   */
+  constexpr const Value *find(std::string_view key) const {
+    std::size_t slot = perfectHashFnv1a(key, fSeed) & kMask;
+    if (fUsed[slot] && fKeys[slot] == key) {
+      return &fValues[slot];
+    }
+    return nullptr;
+  }
+
+  /**
+   * @brief Visit every stored entry (in slot order)
+   * @param visitor Callable taking (std::string_view key, const Value &value)
+   */
+  template <typename Visitor> void forEach(Visitor &&visitor) const {
+    for (std::size_t i = 0; i < kSlots; ++i) {
+      if (fUsed[i]) {
+        visitor(fKeys[i], fValues[i]);
+      }
+    }
+  }
+
+  static constexpr std::size_t size() { return N; }
+
+private:
+  static constexpr std::size_t slotCount() {
+    std::size_t slots = 1;
+    while (slots < 2 * N) {
+      slots <<= 1;
+    }
+    return slots;
+  }
+
+  static constexpr std::size_t kSlots = slotCount();
+  static constexpr std::size_t kMask = kSlots - 1;
+
+  static constexpr uint32_t findSeed(const std::array<Entry, N> &entries) {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+      std::array<bool, kSlots> taken{};
+      bool collision = false;
+      for (const Entry &entry : entries) {
+        std::size_t slot = perfectHashFnv1a(entry.first, seed) & kMask;
+        if (taken[slot]) {
+          collision = true;
+          break;
+        }
+        taken[slot] = true;
+      }
+      if (!collision) {
+        return seed;
+      }
+    }
+    throw "PerfectHashTable: no collision-free seed (duplicate keys?)";
+  }
+
+  uint32_t fSeed;                               ///< Hash seed found at compile time
+  std::array<std::string_view, kSlots> fKeys;   ///< Keys indexed by hash
+  std::array<Value, kSlots> fValues;            ///< Values indexed by hash
+  std::array<bool, kSlots> fUsed;               ///< Occupied slots
+};
+
+/**
+ * @brief Helper deducing the table size from an entry list
+ */
+template <typename Value, std::size_t N>
+constexpr PerfectHashTable<Value, N>
+makePerfectHashTable(const std::array<std::pair<std::string_view, Value>, N> &entries) {
+  return PerfectHashTable<Value, N>(entries);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+// ============================================================================
+// Sandbox Root
+// ============================================================================
+
+/**
+ * @brief Directory that confines the paths accepted by file system tools
+ *
+ * Paths given by clients are interpreted relative to the root, and must
+ * still lie inside it once symbolic links and ".." are resolved.
+ */
+class SandboxRoot {
+private:
+  std::string fRoot; ///< Canonical absolute path of the root
+
+public:
+  /**
+   * @brief Constructor
+   * @param root Directory exposed to the tools
+   */
+  explicit SandboxRoot(const std::string &root) {
+    char resolved[PATH_MAX];
+    if (realpath(root.c_str(), resolved) == nullptr) {
+      throw std::runtime_error("Invalid sandbox root: " + root);
+    }
+    fRoot = resolved;
+  }
+
+  const std::string &path() const { return fRoot; }
+
+  /**
+   * @brief Resolve a client path to an absolute path inside the root
+   * @param relative Path relative to the root ("" or "." for the root itself)
+   * @return Canonical absolute path
+   * @throws std::invalid_argument if the path does not exist or escapes the root
+   */
+  std::string resolve(const std::string &relative) const {
+    // The root "/" is its own prefix
+    std::string prefix = fRoot == "/" ? fRoot : fRoot + "/";
+    std::string joined = prefix + relative;
+    char resolved[PATH_MAX];
+    if (realpath(joined.c_str(), resolved) == nullptr) {
+      throw std::invalid_argument("No such file or directory: " + relative);
+    }
+    std::string path = resolved;
+    if (path != fRoot && path.compare(0, prefix.size(), prefix) != 0) {
+      throw std::invalid_argument("Path outside of the tool root: " + relative);
+    }
+    return path;
+  }
+
+  /**
+   * @brief Express an absolute path inside the root relative to it
+   * @param absolute Absolute path under the root
+   * @return Relative path ("." for the root itself)
+   */
+  std::string relative(const std::string &absolute) const {
+    if (absolute.size() <= fRoot.size()) {
+      return ".";
+    }
+    return absolute.substr(fRoot == "/" ? 1 : fRoot.size() + 1);
+  }
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "directoryWalker.hh"
+#include "fileWatcher.hh"
+#include "fullTextIndex.hh"
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+#include "sandboxRoot.hh"
+
+/**
+ * @brief Built-in tool answering ranked full-text queries over a directory
+ *
+ * The directory is indexed in the background when the tool is created: a
+ * snapshot file, if given and valid, is loaded first and only the files
+ * changed since are re-indexed; otherwise the whole tree is indexed by the
+ * parallel walker threads, each filling its own batch. An inotify watcher,
+ * started before the scan, keeps the index up to date afterwards. Hidden
+ * files and directories (name starting with '.') are not indexed.
+ *
+ * Queries issued during the initial scan are answered from the part of the
+ * tree indexed so far. The snapshot is saved after the scan and when the
+ * tool is destroyed.
+ */
+class SearchTool : public McpTool {
+private:
+  static constexpr std::size_t kBatchSize = 512; ///< Documents per merged batch
+
+  SandboxRoot fRoot;                     ///< Indexed directory
+  std::string fSnapshot;                 ///< Snapshot file (empty: none)
+  FullTextIndex fIndex;                  ///< The index
+  std::atomic<bool> fReady{false};       ///< Initial scan complete
+  std::atomic<bool> fStopping{false};    ///< Set by the destructor
+  std::unique_ptr<FileWatcher> fWatcher; ///< Incremental updates
+  std::thread fBuilder;                  ///< Initial scan
+
+  static bool isHidden(const std::string &relative) {
+    return relative[0] == '.' || relative.find("/.") != std::string::npos;
+  }
+
+  // Index every file of the tree; with 'reconcile', skip the files already
+  // indexed at their current version and drop the ones that disappeared
+  void scan(bool reconcile) {
+    std::mutex batchesMutex;
+    std::map<std::thread::id, FullTextIndex::Batch> batches;
+    std::vector<std::string> seen;
+
+    DirectoryWalker walker([this] { return fStopping.load(); });
+    walker.walk(fRoot.path(), [&](const std::string &path, unsigned char type) {
+      if (type != DT_REG) {
+        return true;
+      }
+      std::string relative = fRoot.relative(path);
+      if (isHidden(relative)) {
+        return true;
+      }
+      FullTextIndex::Batch *batch;
+      {
+        std::lock_guard<std::mutex> lock(batchesMutex);
+        batch = &batches[std::this_thread::get_id()];
+        if (reconcile) {
+          seen.push_back(relative);
+        }
+      }
+      if (reconcile) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 &&
+            fIndex.isCurrent(relative, int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+                             st.st_size)) {
+          return true;
+        }
+      }
+      if (batch->addFile(path, relative) && batch->size() >= kBatchSize) {
+        fIndex.merge(*batch);
+      }
+      return true;
+    });
+    for (auto &entry : batches) {
+      fIndex.merge(entry.second);
+    }
+    if (reconcile && !fStopping) {
+      fIndex.retainOnly(std::unordered_set<std::string>(seen.begin(), seen.end()));
+    }
+  }
+
+  void build() {
+    // Watch first, so that changes made during the scan are not missed
+    try {
+      fWatcher = std::make_unique<FileWatcher>(
+          fRoot.path(), [this](const std::string &path, FileWatcher::Event event) {
+            onChange(path, event);
+          });
+    } catch (const std::exception &) {
+      // No inotify: the index is only built once
+    }
+    bool loaded = !fSnapshot.empty() && fIndex.load(fSnapshot, fRoot.path());
+    scan(loaded);
+    if (fStopping) {
+      return;
+    }
+    fReady = true;
+    saveSnapshot();
+  }
+
+  void onChange(const std::string &path, FileWatcher::Event event) {
+    if (event == FileWatcher::Event::Added) {
+      return; // its files are reported one by one
+    }
+    if (event == FileWatcher::Event::Overflow) {
+      scan(true);
+    } else {
+      std::string relative = fRoot.relative(path);
+      if (isHidden(relative)) {
+        return;
+      }
+      FullTextIndex::Batch batch;
+      if (event == FileWatcher::Event::Changed && batch.addFile(path, relative)) {
+        fIndex.merge(batch);
+      } else {
+        fIndex.remove(relative);
+      }
+    }
+    if (fIndex.needsCompaction()) {
+      fIndex.compact();
+    }
+  }
+
+  void saveSnapshot() {
+    if (!fSnapshot.empty() && fIndex.dirty()) {
+      fIndex.save(fSnapshot, fRoot.path());
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor; starts indexing in the background
+   * @param root Directory to index
+   * @param snapshot Snapshot file to load and save (empty: keep the index in memory only)
+   */
+  SearchTool(const std::string &root, const std::string &snapshot)
+      : fRoot(root), fSnapshot(snapshot) {
+    fBuilder = std::thread([this] { build(); });
+  }
+
+  ~SearchTool() override {
+    fStopping = true;
+    fBuilder.join();
+    fWatcher.reset();
+    if (fReady) {
+      saveSnapshot();
+    }
+  }
+
+  std::string name() const override { return "SearchTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Ranked full-text search over the indexed directory: "
+                        "returns the files containing every query word, best matches first"},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"query", {{"type", "string"}, {"description", "Words to search for"}}},
+            {"path", {{"type", "string"}, {"description", "Only return files below this directory, relative to the tool root"}}},
+            {"maxResults", {{"type", "integer"}, {"description", "Maximum number of files (default: 20)"}}}}},
+          {"required", json::array({"query"})}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    json arguments = json::parse(args);
+    std::string query = arguments.value("query", "");
+    if (query.empty()) {
+      throw std::invalid_argument("Missing 'query'");
+    }
+    std::size_t maxResults = std::max<int64_t>(1, arguments.value("maxResults", int64_t(20)));
+    std::string prefix;
+    if (arguments.contains("path")) {
+      prefix = fRoot.relative(fRoot.resolve(arguments.value("path", ".")));
+      if (prefix == ".") {
+        prefix.clear();
+      }
+    }
+
+    FullTextIndex::Result result = fIndex.query(query, maxResults, prefix);
+
+    json content = json::array();
+    for (const auto &[path, score] : result.hits) {
+      char formatted[32];
+      std::snprintf(formatted, sizeof(formatted), "%.3f", score);
+      content.push_back(textItem(path + " (score " + formatted + ")"));
+    }
+    if (result.hits.empty()) {
+      content.push_back(textItem("No matches"));
+    } else if (result.matches > result.hits.size()) {
+      content.push_back(textItem(std::to_string(result.matches) + " matching files, showing the best " +
+                                 std::to_string(result.hits.size())));
+    }
+    if (!fReady) {
+      content.push_back(textItem("Indexing in progress (" + std::to_string(fIndex.documentCount()) +
+                                 " files so far): results may be incomplete"));
+    }
+    return content;
+  }
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MCP_VECTOR_KERNELS_X86 1
+#endif
+
+// ============================================================================
+// Vector Distance Kernels
+// ============================================================================
+
+/**
+ * @brief Dot product and squared L2 distance of float vectors
+ *
+ * Each kernel exists in a portable version and, on x86, in AVX2+FMA and
+ * AVX-512 versions compiled through target attributes, so the binary does
+ * not need to be built with -mavx2. selectKernels() picks the widest
+ * version the running CPU supports.
+ */
+namespace vectorKernels {
+
+/// Kernel signature: (a, b, dimension) -> value
+using Kernel = float (*)(const float *, const float *, std::size_t);
+
+/// Kernels selected for the running CPU
+struct Kernels {
+  Kernel dot;        ///< Sum of a[i] * b[i]
+  Kernel l2;         ///< Sum of (a[i] - b[i])^2
+  const char *name;  ///< Instruction set used
+};
+
+inline float dotScalar(const float *a, const float *b, std::size_t n) {
+  // Four accumulators let the compiler vectorize and pipeline the loop
+  float sum[4] = {0, 0, 0, 0};
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (std::size_t j = 0; j < 4; ++j) {
+      sum[j] += a[i + j] * b[i + j];
+    }
+  }
+  for (; i < n; ++i) {
+    sum[0] += a[i] * b[i];
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+inline float l2Scalar(const float *a, const float *b, std::size_t n) {
+  float sum[4] = {0, 0, 0, 0};
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (std::size_t j = 0; j < 4; ++j) {
+      float d = a[i + j] - b[i + j];
+      sum[j] += d * d;
+    }
+  }
+  for (; i < n; ++i) {
+    float d = a[i] - b[i];
+    sum[0] += d * d;
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+#if defined(MCP_VECTOR_KERNELS_X86)
+
+__attribute__((target("avx2,fma"))) inline float horizontalSum256(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) inline float dotAvx2(const float *a, const float *b,
+                                                          std::size_t n) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+  }
+  float sum = horizontalSum256(_mm256_add_ps(sum0, sum1));
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2,fma"))) inline float l2Avx2(const float *a, const float *b,
+                                                         std::size_t n) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+    sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    sum0 = _mm256_fmadd_ps(d, d, sum0);
+  }
+  float sum = horizontalSum256(_mm256_add_ps(sum0, sum1));
+  for (; i < n; ++i) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+__attribute__((target("avx512f"))) inline float horizontalSum512(__m512 v) {
+  alignas(64) float lanes[16];
+  _mm512_store_ps(lanes, v);
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+         ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) +
+         ((lanes[8] + lanes[9]) + (lanes[10] + lanes[11])) +
+         ((lanes[12] + lanes[13]) + (lanes[14] + lanes[15]));
+}
+
+__attribute__((target("avx512f"))) inline float dotAvx512(const float *a, const float *b,
+                                                          std::size_t n) {
+  __m512 sum = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    sum = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum);
+  }
+  if (i < n) {
+    // Masked loads handle the tail without reading past the vectors
+    __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+    sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), sum);
+  }
+  return horizontalSum512(sum);
+}
+
+__attribute__((target("avx512f"))) inline float l2Avx512(const float *a, const float *b,
+                                                         std::size_t n) {
+  __m512 sum = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    sum = _mm512_fmadd_ps(d, d, sum);
+  }
+  if (i < n) {
+    __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+    sum = _mm512_fmadd_ps(d, d, sum);
+  }
+  return horizontalSum512(sum);
+}
+
+#endif
+
+/**
+ * @brief Pick the kernels for the running CPU
+ */
+inline Kernels selectKernels() {
+#if defined(MCP_VECTOR_KERNELS_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return {dotAvx512, l2Avx512, "avx512f"};
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return {dotAvx2, l2Avx2, "avx2"};
+  }
+#endif
+  return {dotScalar, l2Scalar, "scalar"};
+}
+
+} // namespace vectorKernels
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hnswIndex.hh"
+#include "mcpJson.hh"
+#include "mcpTool.hh"
+
+/**
+ * @brief Built-in tool answering nearest-neighbor queries over local embeddings
+ *
+ * The embeddings are read from a .fvecs file (each vector stored as an int32
+ * dimension followed by the floats), memory-mapped and used in place. An
+ * HNSW graph is built in the background by all cores, or loaded from a
+ * graph file written by a previous run for the same vectors. Queries only
+ * read the finished graph, so the server runs them concurrently.
+ */
+class VectorSearchTool : public McpTool {
+private:
+  void *fMapping = MAP_FAILED;          ///< Mapped .fvecs file
+  std::size_t fMappingSize = 0;
+  std::vector<std::string> fLabels;     ///< Optional label of each vector
+  std::string fGraphPath;               ///< Graph file (empty: none)
+  uint64_t fTag = 0;                    ///< Identifies the vector file version
+  std::unique_ptr<HnswIndex> fIndex;
+  std::atomic<bool> fReady{false};      ///< Graph built or loaded
+  std::atomic<bool> fStopping{false};   ///< Set by the destructor
+  std::thread fBuilder;
+
+  static HnswIndex::Metric parseMetric(const std::string &metric) {
+    if (metric == "l2") {
+      return HnswIndex::Metric::L2;
+    }
+    if (metric == "ip") {
+      return HnswIndex::Metric::InnerProduct;
+    }
+    if (metric == "cosine" || metric.empty()) {
+      return HnswIndex::Metric::Cosine;
+    }
+    throw std::invalid_argument("Unknown vector metric: " + metric + " (expected cosine, l2 or ip)");
+  }
+
+  void build() {
+    if (!fGraphPath.empty() && fIndex->load(fGraphPath, fTag)) {
+      fReady = true;
+      return;
+    }
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (fIndex->build(threads, [this] { return fStopping.load(); })) {
+      fReady = true;
+      if (!fGraphPath.empty()) {
+        fIndex->save(fGraphPath, fTag);
+      }
+    }
+  }
+
+  std::string label(uint32_t id) const {
+    return id < fLabels.size() ? fLabels[id] : "#" + std::to_string(id);
+  }
+
+public:
+  /**
+   * @brief Constructor; maps the vectors and starts building the graph
+   * @param vectors .fvecs file
+   * @param metric "cosine" (default), "l2" or "ip" (inner product)
+   * @param labels Text file with one label per vector (empty: rows are named #index)
+   * @param graph Graph file to load, or to write once built (empty: none)
+   * @throws std::runtime_error if the vector file is unusable
+   */
+  VectorSearchTool(const std::string &vectors, const std::string &metric,
+                   const std::string &labels, const std::string &graph)
+      : fGraphPath(graph) {
+    HnswIndex::Metric distance = parseMetric(metric);
+    int fd = open(vectors.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < 4) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("Cannot read vector file: " + vectors);
+    }
+    fMappingSize = st.st_size;
+    fMapping = mmap(nullptr, fMappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (fMapping == MAP_FAILED) {
+      throw std::runtime_error("Cannot map vector file: " + vectors);
+    }
+    int32_t dim;
+    std::memcpy(&dim, fMapping, sizeof(dim));
+    std::size_t rowBytes = (std::size_t(std::max(dim, 0)) + 1) * sizeof(float);
+    if (dim <= 0 || fMappingSize % rowBytes != 0) {
+      munmap(fMapping, fMappingSize);
+      throw std::runtime_error("Not a .fvecs file: " + vectors);
+    }
+    fTag = uint64_t(st.st_size) ^ (uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+
+    const float *first = static_cast<const float *>(fMapping) + 1;
+    fIndex = std::make_unique<HnswIndex>(first, fMappingSize / rowBytes, dim, dim + 1, distance);
+
+    if (!labels.empty()) {
+      std::ifstream input(labels);
+      for (std::string line; std::getline(input, line);) {
+        fLabels.push_back(line);
+      }
+    }
+    fBuilder = std::thread([this] { build(); });
+  }
+
+  ~VectorSearchTool() override {
+    fStopping = true;
+    fBuilder.join();
+    fIndex.reset();
+    munmap(fMapping, fMappingSize);
+  }
+
+  std::string name() const override { return "VectorSearchTool"; }
+
+  std::string describe() const override {
+    json description = {
+        {"name", name()},
+        {"description", "Find the nearest neighbors of a vector among the " +
+                            std::to_string(fIndex->size()) + " local embeddings of dimension " +
+                            std::to_string(fIndex->dimension())},
+        {"inputSchema",
+         {{"type", "object"},
+          {"properties",
+           {{"vector", {{"type", "array"}, {"items", {{"type", "number"}}}, {"description", "Query vector"}}},
+            {"row", {{"type", "integer"}, {"description", "Use the stored vector of this index as the query, instead of 'vector'"}}},
+            {"k", {{"type", "integer"}, {"description", "Number of neighbors (default: 10)"}}},
+            {"ef", {{"type", "integer"}, {"description", "Search beam width, higher is more accurate and slower (default: 128)"}}}}}}}};
+
+    return description.dump();
+  }
+
+  McpToolAnnotations annotations() const override {
+    McpToolAnnotations hints;
+    hints.readOnlyHint = true;
+    hints.destructiveHint = false;
+    hints.idempotentHint = true;
+    hints.openWorldHint = false;
+    return hints;
+  }
+
+  json call(const std::string &args) override {
+    if (!fReady) {
+      // Not a failure of the tool: must not open its circuit breaker
+      throw std::invalid_argument("Index is being built: " + std::to_string(fIndex->inserted()) +
+                               " of " + std::to_string(fIndex->size()) + " vectors inserted");
+    }
+    json arguments = json::parse(args);
+    std::size_t k = std::clamp<int64_t>(arguments.value("k", int64_t(10)), 1, 1000);
+    std::size_t ef = std::clamp<int64_t>(arguments.value("ef", int64_t(128)), 1, 10000);
+
+    std::vector<float> query;
+    int64_t exclude = -1;
+    if (arguments.contains("row")) {
+      exclude = arguments["row"].get<int64_t>();
+      if (exclude < 0 || std::size_t(exclude) >= fIndex->size()) {
+        throw std::invalid_argument("Row out of range: " + std::to_string(exclude));
+      }
+      const float *row = static_cast<const float *>(fMapping) + 1 + exclude * (fIndex->dimension() + 1);
+      query.assign(row, row + fIndex->dimension());
+    } else {
+      query = arguments.value("vector", std::vector<float>());
+      if (query.size() != fIndex->dimension()) {
+        throw std::invalid_argument("Expected a vector of dimension " +
+                                    std::to_string(fIndex->dimension()) + ", got " +
+                                    std::to_string(query.size()));
+      }
+    }
+
+    json content = json::array();
+    for (const HnswIndex::Neighbor &neighbor : fIndex->search(query.data(), k, ef, exclude)) {
+      char formatted[32];
+      std::snprintf(formatted, sizeof(formatted), "%.6g", neighbor.distance);
+      content.push_back(textItem(label(neighbor.id) + " (row " + std::to_string(neighbor.id) +
+                                 ", distance " + formatted + ")"));
+    }
+    if (content.empty()) {
+      content.push_back(textItem("No vectors"));
+    }
+    return content;
+  }
+};